@@ -0,0 +1,337 @@
+#include "checkpoint.h"
+#include "memstats.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    uint32_t tick;              // jogada em que o checkpoint foi tirado
+    unsigned int rng_state;
+    uint32_t n_cells;           // delta: células alteradas
+    uint32_t* cell_index;       // delta: índice de cada célula alterada (NULL na base)
+    unsigned char* cells;       // base: todas as células guardadas (por tiles), delta: n_cells células
+    uint32_t n_agents;          // delta: agentes alterados
+    uint32_t* agent_index;      // delta: índice de cada agente alterado (NULL na base)
+    checkpoint_agent_t* agents; // base: todos os agentes, delta: n_agents agentes
+} checkpoint_t;
+
+// Anel de checkpoints, o primeiro (head) é sempre a base
+static checkpoint_t ring[CHECKPOINT_SLOTS];
+static int head = 0;
+static int count = 0;
+
+static int interval = CHECKPOINT_INTERVAL;
+static uint32_t tick = 0;
+
+// Sombra: estado do último checkpoint, comparada com o tabuleiro para obter os deltas
+static size_t total_cells = 0;
+static int total_agents = 0;
+static unsigned char* shadow_cells = NULL;
+static checkpoint_agent_t* shadow_agents = NULL;
+
+// Buffers temporários onde os deltas são montados antes de serem copiados para o anel
+static uint32_t* scratch_index = NULL;
+static unsigned char* scratch_cells = NULL;
+static size_t scratch_capacity = 0;
+
+static size_t ring_bytes = 0;
+
+// Helper: checkpoint na posição 'k' a contar do mais antigo
+static checkpoint_t* slot(int k) {
+    return &ring[(head + k) % CHECKPOINT_SLOTS];
+}
+
+// Helper: malloc que conta os bytes do anel
+static void* ring_alloc(size_t size) {
+    void* ptr = mem_malloc(MEM_BACKUPS, size > 0 ? size : 1);
+    if (ptr) ring_bytes += size;
+    return ptr;
+}
+
+// Helper: liberta a memória de um checkpoint ('cells_size' bytes de células)
+static void free_slot(checkpoint_t* checkpoint, size_t cells_size) {
+    ring_bytes -= cells_size + (size_t)checkpoint->n_agents * sizeof(checkpoint_agent_t);
+    if (checkpoint->cell_index) ring_bytes -= (size_t)checkpoint->n_cells * sizeof(uint32_t);
+    if (checkpoint->agent_index) ring_bytes -= (size_t)checkpoint->n_agents * sizeof(uint32_t);
+    mem_free(MEM_BACKUPS, checkpoint->cell_index);
+    mem_free(MEM_BACKUPS, checkpoint->cells);
+    mem_free(MEM_BACKUPS, checkpoint->agent_index);
+    mem_free(MEM_BACKUPS, checkpoint->agents);
+    memset(checkpoint, 0, sizeof(*checkpoint));
+}
+
+// Helper: bytes de células de um checkpoint (a base tem o plano completo)
+static size_t cells_size(checkpoint_t* checkpoint) {
+    return checkpoint->cell_index ? checkpoint->n_cells : total_cells;
+}
+
+// Helper: lê o estado mutável do agente 'i' (pacmans primeiro, depois fantasmas)
+static void read_agent(board_t* board, int i, checkpoint_agent_t* agent) {
+    memset(agent, 0, sizeof(*agent));
+    if (i < board->n_pacmans) {
+        pacman_t* pac = &board->pacmans[i];
+        agent->pos_x = pac->pos_x;
+        agent->pos_y = pac->pos_y;
+        agent->state = pac->alive;
+        agent->points = pac->points;
+        agent->lives = pac->lives;
+        agent->waiting = pac->waiting;
+        agent->current_move = pac->current_move;
+        if (pac->n_moves > 0)
+            agent->turns_left = pac->moves[pac->current_move % pac->n_moves].turns_left;
+    } else {
+        int g = i - board->n_pacmans;
+        ghost_t* ghost = &board->ghosts[g];
+        agent->pos_x = ghost->pos_x;
+        agent->pos_y = ghost->pos_y;
+        agent->state = ghost->charged;
+        agent->waiting = board->ghost_waiting[g];
+        agent->current_move = ghost->current_move;
+        if (ghost->n_moves > 0)
+            agent->turns_left = ghost->moves[ghost->current_move % ghost->n_moves].turns_left;
+    }
+}
+
+// Helper: repõe os cursores de um script, só o comando atual pode estar a meio
+static void restore_script(command_t* moves, int n_moves, int current_move, int turns_left) {
+    if (n_moves == 0) return;
+    for (int m = 0; m < n_moves; m++)
+        moves[m].turns_left = moves[m].turns;
+    moves[current_move % n_moves].turns_left = turns_left;
+}
+
+// Helper: escreve o estado de um agente no tabuleiro
+static void write_agent(board_t* board, int i, const checkpoint_agent_t* agent) {
+    if (i < board->n_pacmans) {
+        pacman_t* pac = &board->pacmans[i];
+        pac->pos_x = agent->pos_x;
+        pac->pos_y = agent->pos_y;
+        pac->alive = agent->state;
+        pac->points = agent->points;
+        pac->lives = agent->lives;
+        pac->waiting = agent->waiting;
+        pac->current_move = agent->current_move;
+        restore_script(pac->moves, pac->n_moves, pac->current_move, agent->turns_left);
+    } else {
+        int g = i - board->n_pacmans;
+        ghost_t* ghost = &board->ghosts[g];
+        ghost->pos_x = agent->pos_x;
+        ghost->pos_y = agent->pos_y;
+        ghost->charged = agent->state;
+        board->ghost_waiting[g] = agent->waiting;
+        ghost->current_move = agent->current_move;
+        restore_script(ghost->moves, ghost->n_moves, ghost->current_move, agent->turns_left);
+    }
+}
+
+// Helper: aplica um delta a um plano completo de células e agentes
+static void apply_delta(checkpoint_t* delta, unsigned char* cells, checkpoint_agent_t* agents) {
+    for (uint32_t i = 0; i < delta->n_cells; i++)
+        cells[delta->cell_index[i]] = delta->cells[i];
+    for (uint32_t i = 0; i < delta->n_agents; i++)
+        agents[delta->agent_index[i]] = delta->agents[i];
+}
+
+// Helper: garante espaço nos buffers temporários para 'needed' células
+static int grow_scratch(size_t needed) {
+    if (needed <= scratch_capacity) return 0;
+    size_t capacity = scratch_capacity ? scratch_capacity * 2 : 1024;
+    while (capacity < needed) capacity *= 2;
+    uint32_t* index = mem_realloc(MEM_BACKUPS, scratch_index, capacity * sizeof(uint32_t));
+    if (!index) return -1;
+    scratch_index = index;
+    unsigned char* cells = mem_realloc(MEM_BACKUPS, scratch_cells, capacity);
+    if (!cells) return -1;
+    scratch_cells = cells;
+    scratch_capacity = capacity;
+    return 0;
+}
+
+// Helper: guarda uma base completa (a sombra já tem o estado do tabuleiro)
+static int take_base(board_t* board) {
+    checkpoint_t* base = slot(0);
+    base->tick = tick;
+    base->rng_state = board->rng_state;
+    base->cells = ring_alloc(total_cells);
+    base->agents = ring_alloc((size_t)total_agents * sizeof(checkpoint_agent_t));
+    if (!base->cells || !base->agents) {
+        free_slot(base, total_cells);
+        return -1;
+    }
+    memcpy(base->cells, shadow_cells, total_cells);
+    memcpy(base->agents, shadow_agents, (size_t)total_agents * sizeof(checkpoint_agent_t));
+    base->n_agents = total_agents;
+    count = 1;
+    return 0;
+}
+
+// Helper: junta o delta seguinte à base e liberta-o, abrindo espaço no anel
+static void fold_base() {
+    checkpoint_t* base = slot(0);
+    checkpoint_t* next = slot(1);
+    apply_delta(next, base->cells, base->agents);
+    base->tick = next->tick;
+    base->rng_state = next->rng_state;
+    free_slot(next, next->n_cells);
+
+    // A base passa para a posição do delta
+    *next = *base;
+    memset(base, 0, sizeof(*base));
+    head = (head + 1) % CHECKPOINT_SLOTS;
+    count--;
+}
+
+// Helper: guarda as células e agentes que mudaram desde o último checkpoint
+static int take_delta(board_t* board) {
+    if (count == CHECKPOINT_SLOTS)
+        fold_base();
+    sync_ghosts(board);
+
+    // Células alteradas
+    uint32_t n_cells = 0;
+    for (size_t i = 0; i < total_cells; i++) {
+        unsigned char packed = pack_cell(&board->board[i]);
+        if (packed == shadow_cells[i]) continue;
+        if (grow_scratch(n_cells + 1) != 0) return -1;
+        scratch_index[n_cells] = i;
+        scratch_cells[n_cells] = packed;
+        n_cells++;
+        shadow_cells[i] = packed;
+    }
+
+    checkpoint_t* delta = slot(count);
+    delta->tick = tick;
+    delta->rng_state = board->rng_state;
+    delta->n_cells = n_cells;
+    delta->cell_index = ring_alloc(n_cells * sizeof(uint32_t));
+    delta->cells = ring_alloc(n_cells);
+
+    // Agentes alterados: contados primeiro para alocar o delta à medida
+    uint32_t n_agents = 0;
+    for (int i = 0; i < total_agents; i++) {
+        checkpoint_agent_t agent;
+        read_agent(board, i, &agent);
+        if (memcmp(&agent, &shadow_agents[i], sizeof(agent)) != 0) n_agents++;
+    }
+    delta->n_agents = n_agents;
+    delta->agent_index = ring_alloc(n_agents * sizeof(uint32_t));
+    delta->agents = ring_alloc(n_agents * sizeof(checkpoint_agent_t));
+    if (!delta->cell_index || !delta->cells || !delta->agent_index || !delta->agents) {
+        free_slot(delta, n_cells);
+        return -1;
+    }
+
+    memcpy(delta->cell_index, scratch_index, n_cells * sizeof(uint32_t));
+    memcpy(delta->cells, scratch_cells, n_cells);
+    n_agents = 0;
+    for (int i = 0; i < total_agents; i++) {
+        checkpoint_agent_t agent;
+        read_agent(board, i, &agent);
+        if (memcmp(&agent, &shadow_agents[i], sizeof(agent)) == 0) continue;
+        delta->agent_index[n_agents] = i;
+        delta->agents[n_agents++] = agent;
+        shadow_agents[i] = agent;
+    }
+    count++;
+
+    debug("CHECKPOINT %u: %u cells, %u agents (ring %d, %zu bytes)\n",
+          tick, n_cells, n_agents, count, checkpoint_memory());
+    return 0;
+}
+
+void checkpoint_set_interval(int ticks) {
+    interval = ticks;
+}
+
+int checkpoint_reset(board_t* board) {
+    checkpoint_free();
+    if (interval <= 0) return 0;
+    if (board->stream) {
+        // Um mundo gerado por tiles não cabe numa base completa
+        debug("CHECKPOINT desligado: mundo de %d x %d gerado por tiles\n", board->width, board->height);
+        return 0;
+    }
+
+    // As células são percorridas pela ordem em que estão guardadas, incluindo as que enchem os tiles da margem
+    total_cells = board_storage_cells(board->width, board->height);
+    total_agents = board->n_pacmans + board->n_ghosts;
+    shadow_cells = mem_malloc(MEM_BACKUPS, total_cells > 0 ? total_cells : 1);
+    shadow_agents = mem_malloc(MEM_BACKUPS, (total_agents > 0 ? total_agents : 1) * sizeof(checkpoint_agent_t));
+    if (!shadow_cells || !shadow_agents) {
+        checkpoint_free();
+        return -1;
+    }
+
+    sync_ghosts(board);
+    for (size_t i = 0; i < total_cells; i++)
+        shadow_cells[i] = pack_cell(&board->board[i]);
+    for (int i = 0; i < total_agents; i++)
+        read_agent(board, i, &shadow_agents[i]);
+
+    if (take_base(board) != 0) {
+        checkpoint_free();
+        return -1;
+    }
+    return 0;
+}
+
+void checkpoint_tick(board_t* board) {
+    if (count == 0) return;
+    tick++;
+    if (tick % interval == 0 && take_delta(board) != 0)
+        debug("Error: Could not take checkpoint at play %u\n", tick);
+}
+
+int checkpoint_rewind(board_t* board) {
+    if (count == 0) return -1;
+
+    // Se acabámos de voltar a um checkpoint, recuamos para o anterior
+    int k = count - 1;
+    if (slot(k)->tick >= tick) k--;
+    if (k < 0) return -1;
+
+    // Reconstrói o checkpoint k na sombra: base seguida dos deltas até k
+    checkpoint_t* base = slot(0);
+    memcpy(shadow_cells, base->cells, total_cells);
+    memcpy(shadow_agents, base->agents, (size_t)total_agents * sizeof(checkpoint_agent_t));
+    for (int j = 1; j <= k; j++)
+        apply_delta(slot(j), shadow_cells, shadow_agents);
+
+    // Os checkpoints mais novos deixam de fazer sentido
+    for (int j = k + 1; j < count; j++)
+        free_slot(slot(j), cells_size(slot(j)));
+    count = k + 1;
+
+    for (size_t i = 0; i < total_cells; i++)
+        unpack_cell(shadow_cells[i], &board->board[i]);
+    for (int i = 0; i < total_agents; i++)
+        write_agent(board, i, &shadow_agents[i]);
+    board->rng_state = slot(k)->rng_state;
+    reschedule_ghosts(board); // as contagens dos fantasmas foram reescritas
+
+    debug("REWIND to play %u (from %u)\n", slot(k)->tick, tick);
+    tick = slot(k)->tick;
+    return 0;
+}
+
+size_t checkpoint_memory() {
+    size_t shadow = shadow_cells ? total_cells + (size_t)total_agents * sizeof(checkpoint_agent_t) : 0;
+    return ring_bytes + shadow;
+}
+
+void checkpoint_free() {
+    for (int k = 0; k < count; k++)
+        free_slot(slot(k), cells_size(slot(k)));
+    head = 0;
+    count = 0;
+    tick = 0;
+    ring_bytes = 0;
+    mem_free(MEM_BACKUPS, shadow_cells);
+    mem_free(MEM_BACKUPS, shadow_agents);
+    shadow_cells = NULL;
+    shadow_agents = NULL;
+    mem_free(MEM_BACKUPS, scratch_index);
+    mem_free(MEM_BACKUPS, scratch_cells);
+    scratch_index = NULL;
+    scratch_cells = NULL;
+    scratch_capacity = 0;
+}
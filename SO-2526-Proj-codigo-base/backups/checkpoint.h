@@ -0,0 +1,51 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "board.h"
+#include <stdint.h>
+#include <stddef.h>
+
+#define CHECKPOINT_SLOTS 32     // checkpoints guardados no anel
+#define CHECKPOINT_INTERVAL 10  // jogadas entre checkpoints (por omissão)
+
+/*
+ * Anel de checkpoints em memória:
+ *   o checkpoint mais antigo é uma base completa (células empacotadas e todos os agentes);
+ *   cada um dos seguintes guarda só as células e os agentes que mudaram desde o anterior.
+ * Quando o anel enche, o delta a seguir à base é aplicado à base e libertado, por isso
+ * só existem sempre dois planos completos (a base e a sombra usada para comparar).
+ */
+
+/*Estado mutável de um agente. Os restantes campos (passo, scripts, posição inicial)
+não mudam durante o nível. Dos scripts só o comando atual pode ter turns_left != turns*/
+typedef struct {
+    int32_t pos_x, pos_y;
+    int32_t state;          // alive nos pacmans, charged nos fantasmas
+    int32_t points, lives;  // só pacmans
+    int32_t waiting;
+    int32_t current_move;
+    int32_t turns_left;     // cursor do comando atual
+} checkpoint_agent_t;
+
+/*Define o número de jogadas entre checkpoints (0 desliga os checkpoints)*/
+void checkpoint_set_interval(int ticks);
+
+/*Descarta os checkpoints e guarda uma base do tabuleiro atual,
+chamado no início de cada nível e depois de restaurar um save
+Retorna 0 em caso de sucesso, -1 em caso de erro*/
+int checkpoint_reset(board_t* board);
+
+/*Conta uma jogada e guarda um checkpoint a cada intervalo*/
+void checkpoint_tick(board_t* board);
+
+/*Volta ao checkpoint mais recente anterior à jogada atual e descarta os mais novos
+Retorna 0 em caso de sucesso, -1 se não houver checkpoint para onde voltar*/
+int checkpoint_rewind(board_t* board);
+
+/*Bytes ocupados pelo anel (base, sombra e deltas)*/
+size_t checkpoint_memory();
+
+/*Liberta todos os checkpoints*/
+void checkpoint_free();
+
+#endif
@@ -1,18 +1,286 @@
 #include "game_backup.h"
 #include "board.h"
+#include "memstats.h"
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/wait.h>
 #include <stdio.h>
+#include <time.h>
 
 // Variáveis globais
-board_t backup;
 bool backup_exists = false;
 pid_t backup_pid = -1;
 
+// Quando o quicksave em curso (backup_pid) foi começado
+static double backup_start_ms = 0;
+
+// Autosave em curso (-1 se nenhum) e quando foi começado
+static pid_t autosave_pid = -1;
+static double autosave_start_ms = 0;
+static autosave_stats_t autosave_counters;
+
+// Buffer de I/O dos saves: poucas chamadas write()/read() mesmo em tabuleiros enormes.
+// É estático para que o processo filho do save_game não precise de malloc.
+#define IO_BUFFER_SIZE (1 << 20)
+static unsigned char io_buffer[IO_BUFFER_SIZE];
+static size_t io_used = 0;   // bytes no buffer (escrita) ou bytes já consumidos (leitura)
+static size_t io_filled = 0; // bytes lidos para o buffer (leitura)
+
+// Helper: escreve o buffer no ficheiro
+static int flush_buffer(int fd) {
+    size_t done = 0;
+    while (done < io_used) {
+        ssize_t n = write(fd, io_buffer + done, io_used - done);
+        if (n < 0) return -1;
+        done += n;
+    }
+    io_used = 0;
+    return 0;
+}
+
+// Helper: acrescenta 'size' bytes ao buffer de escrita
+static int buffered_write(int fd, const void* data, size_t size) {
+    const unsigned char* bytes = data;
+    while (size > 0) {
+        size_t chunk = IO_BUFFER_SIZE - io_used;
+        if (chunk > size) chunk = size;
+        memcpy(io_buffer + io_used, bytes, chunk);
+        io_used += chunk;
+        bytes += chunk;
+        size -= chunk;
+        if (io_used == IO_BUFFER_SIZE && flush_buffer(fd) != 0) return -1;
+    }
+    return 0;
+}
+
+// Helper: lê 'size' bytes do ficheiro através do buffer de leitura
+static int buffered_read(int fd, void* data, size_t size) {
+    unsigned char* bytes = data;
+    while (size > 0) {
+        if (io_used == io_filled) {
+            ssize_t n = read(fd, io_buffer, IO_BUFFER_SIZE);
+            if (n <= 0) return -1;
+            io_filled = n;
+            io_used = 0;
+        }
+        size_t chunk = io_filled - io_used;
+        if (chunk > size) chunk = size;
+        memcpy(bytes, io_buffer + io_used, chunk);
+        io_used += chunk;
+        bytes += chunk;
+        size -= chunk;
+    }
+    return 0;
+}
+
+// Campos de cada registo em int32: o save não depende do layout das estruturas
+#define PACMAN_FIELDS 11
+#define GHOST_FIELDS 7
+#define COMMAND_FIELDS 3
+
+// Helper: escreve os 'MAX_MOVES' comandos de um script
+static int write_moves(int fd, const command_t* moves) {
+    int32_t fields[MAX_MOVES * COMMAND_FIELDS];
+    for (int m = 0; m < MAX_MOVES; m++) {
+        fields[m * COMMAND_FIELDS] = moves[m].command;
+        fields[m * COMMAND_FIELDS + 1] = moves[m].turns;
+        fields[m * COMMAND_FIELDS + 2] = moves[m].turns_left;
+    }
+    return buffered_write(fd, fields, sizeof(fields));
+}
+
+// Helper: lê os 'MAX_MOVES' comandos de um script
+static int read_moves(int fd, command_t* moves) {
+    int32_t fields[MAX_MOVES * COMMAND_FIELDS];
+    if (buffered_read(fd, fields, sizeof(fields)) != 0) return -1;
+    for (int m = 0; m < MAX_MOVES; m++) {
+        moves[m].command = (char)fields[m * COMMAND_FIELDS];
+        moves[m].turns = fields[m * COMMAND_FIELDS + 1];
+        moves[m].turns_left = fields[m * COMMAND_FIELDS + 2];
+    }
+    return 0;
+}
+
+// Helper: a posição está dentro do tabuleiro
+static bool inside(const board_t* board, int x, int y) {
+    return x >= 0 && x < board->width && y >= 0 && y < board->height;
+}
+
+int save_state_to_file(const char* filename, board_t* board) {
+    if (board->stream) return -1; // save_game e autosave_start não chegam a fazer fork() para estes
+    sync_ghosts(board); // as contagens dos fantasmas vivem na roda de agendamento
+    // Escreve num ficheiro temporário e só depois substitui o save anterior
+    char tmp_name[MAX_FILENAME + 8];
+    snprintf(tmp_name, sizeof(tmp_name), "%s.tmp", filename);
+    int fd = open(tmp_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return -1;
+
+    save_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SAVE_MAGIC, 4);
+    header.version = SAVE_VERSION;
+    header.level_index = board->level_index;
+    memcpy(header.level_name, board->level_name, sizeof(header.level_name));
+    header.width = board->width;
+    header.height = board->height;
+    header.tempo = board->tempo;
+    header.n_pacmans = board->n_pacmans;
+    header.n_ghosts = board->n_ghosts;
+    header.rng_state = board->rng_state;
+
+    io_used = 0;
+    int error = buffered_write(fd, &header, sizeof(header));
+    error |= buffered_write(fd, board->pacman_files, (size_t)board->n_pacmans * sizeof(board->pacman_files[0]));
+    error |= buffered_write(fd, board->ghosts_files, (size_t)board->n_ghosts * sizeof(*board->ghosts_files));
+
+    // Células empacotadas diretamente no buffer, linha a linha (o ficheiro não depende dos tiles)
+    for (int y = 0; y < board->height && !error; y++) {
+        for (int x = 0; x < board->width && !error; x++) {
+            io_buffer[io_used++] = pack_cell(&board->board[board_index(board, x, y)]);
+            if (io_used == IO_BUFFER_SIZE) error |= flush_buffer(fd);
+        }
+    }
+
+    for (int i = 0; i < board->n_pacmans && !error; i++) {
+        pacman_t* pac = &board->pacmans[i];
+        int32_t fields[PACMAN_FIELDS] = {pac->pos_x, pac->pos_y, pac->alive, pac->points, pac->passo,
+                                         pac->current_move, pac->n_moves, pac->waiting, pac->lives,
+                                         pac->start_x, pac->start_y};
+        error |= buffered_write(fd, fields, sizeof(fields));
+        error |= write_moves(fd, pac->moves);
+    }
+    for (int i = 0; i < board->n_ghosts && !error; i++) {
+        ghost_t* ghost = &board->ghosts[i];
+        int32_t fields[GHOST_FIELDS] = {ghost->pos_x, ghost->pos_y, ghost->passo, ghost->n_moves,
+                                        ghost->current_move, ghost->charged, board->ghost_waiting[i]};
+        error |= buffered_write(fd, fields, sizeof(fields));
+    }
+    for (int i = 0; i < board->n_ghosts && !error; i++)
+        error |= write_moves(fd, board->ghosts[i].moves);
+    error |= flush_buffer(fd);
+
+    if (close(fd) != 0 || error) {
+        unlink(tmp_name);
+        return -1;
+    }
+    return rename(tmp_name, filename);
+}
+
+int load_state_from_file(const char* filename, board_t* board) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        debug("Error: Could not open save file %s\n", filename);
+        return -1;
+    }
+
+    io_used = io_filled = 0;
+    save_header_t header;
+    if (buffered_read(fd, &header, sizeof(header)) != 0 || memcmp(header.magic, SAVE_MAGIC, 4) != 0
+        || header.version != SAVE_VERSION || header.width <= 0 || header.height <= 0
+        || (int64_t)header.width * header.height > SAVE_MAX_CELLS
+        || header.n_pacmans <= 0 || header.n_pacmans > MAX_PACMANS
+        || header.n_ghosts < 0 || header.n_ghosts > header.width * header.height) {
+        debug("Error: %s is not a valid save file\n", filename);
+        close(fd);
+        return -1;
+    }
+
+    memset(board, 0, sizeof(*board));
+    board->level_index = header.level_index;
+    memcpy(board->level_name, header.level_name, sizeof(board->level_name));
+    board->level_name[sizeof(board->level_name) - 1] = '\0';
+    board->width = header.width;
+    board->height = header.height;
+    board->tempo = header.tempo;
+    board->n_pacmans = header.n_pacmans;
+    board->rng_state = header.rng_state;
+
+    board_alloc_cells(board);
+    board->pacmans = mem_calloc(MEM_AGENTS, board->n_pacmans, sizeof(pacman_t));
+    board->ghosts_files = mem_calloc(MEM_LEVEL, header.n_ghosts > 0 ? header.n_ghosts : 1, sizeof(*board->ghosts_files));
+    int error = !board->board || !board->pacmans || !board->ghosts_files
+                || allocate_ghosts(board, header.n_ghosts) != 0;
+
+    if (!error) {
+        error |= buffered_read(fd, board->pacman_files, (size_t)board->n_pacmans * sizeof(board->pacman_files[0]));
+        error |= buffered_read(fd, board->ghosts_files, (size_t)board->n_ghosts * sizeof(*board->ghosts_files));
+        for (int i = 0; i < board->n_pacmans; i++)
+            board->pacman_files[i][sizeof(board->pacman_files[i]) - 1] = '\0';
+        for (int i = 0; i < board->n_ghosts; i++)
+            board->ghosts_files[i][sizeof(*board->ghosts_files) - 1] = '\0';
+    }
+
+    // Células empacotadas lidas diretamente do buffer
+    for (int y = 0; y < board->height && !error; y++) {
+        for (int x = 0; x < board->width && !error; x++) {
+            board_pos_t* pos = &board->board[board_index(board, x, y)];
+            if (io_used == io_filled) {
+                unsigned char packed;
+                error |= buffered_read(fd, &packed, 1);
+                unpack_cell(packed, pos);
+            } else {
+                unpack_cell(io_buffer[io_used++], pos);
+            }
+        }
+    }
+
+    // Agentes: um valor fora do tabuleiro ou do script é um save estragado, não um jogo
+    int invalid = 0;
+    for (int i = 0; i < board->n_pacmans && !error; i++) {
+        int32_t fields[PACMAN_FIELDS];
+        error |= buffered_read(fd, fields, sizeof(fields));
+        pacman_t* pac = &board->pacmans[i];
+        pac->pos_x = fields[0];
+        pac->pos_y = fields[1];
+        pac->alive = fields[2];
+        pac->points = fields[3];
+        pac->passo = fields[4];
+        pac->current_move = fields[5];
+        pac->n_moves = fields[6]; // 0 se for controlado pelo utilizador
+        pac->waiting = fields[7];
+        pac->lives = fields[8];
+        pac->start_x = fields[9];
+        pac->start_y = fields[10];
+        error |= read_moves(fd, pac->moves);
+        invalid |= !inside(board, pac->pos_x, pac->pos_y) || !inside(board, pac->start_x, pac->start_y)
+                   || pac->n_moves < 0 || pac->n_moves > MAX_MOVES || pac->current_move < 0;
+    }
+    for (int i = 0; i < board->n_ghosts && !error; i++) {
+        int32_t fields[GHOST_FIELDS];
+        error |= buffered_read(fd, fields, sizeof(fields));
+        ghost_t* ghost = &board->ghosts[i];
+        ghost->pos_x = fields[0];
+        ghost->pos_y = fields[1];
+        ghost->passo = fields[2];
+        ghost->n_moves = fields[3];
+        ghost->current_move = fields[4];
+        ghost->charged = fields[5];
+        board->ghost_waiting[i] = fields[6];
+        invalid |= !inside(board, ghost->pos_x, ghost->pos_y) || ghost->n_moves <= 0 || ghost->n_moves > MAX_MOVES
+                   || ghost->current_move < 0;
+    }
+    for (int i = 0; i < board->n_ghosts && !error; i++)
+        error |= read_moves(fd, board->ghosts[i].moves);
+
+    close(fd);
+    if (error || invalid) {
+        debug("Error: save file %s is %s\n", filename, error ? "truncated" : "not valid");
+        unload_level(board);
+        return -1;
+    }
+    return 0;
+}
+
 void save_game(board_t *game_board) {
     if (backup_exists) return; // já existe backup
+    if (game_board->stream) {
+        debug("Error: a world generated by tiles can not be saved\n");
+        return;
+    }
 
+    double start = now_ms();
     pid_t pid = fork();
     if (pid < 0) {
         perror("fork");
@@ -20,27 +288,116 @@ void save_game(board_t *game_board) {
     }
 
     if (pid == 0) { // processo filho
-        // cria backup
-        copy_board_state(&backup, game_board);
-        backup_exists = true;
-        exit(0); // filho termina
-    } else { // processo pai espera que o filho termine
+        // escreve o estado completo em disco: sem malloc nem FILE do stdio (nem debug()), só
+        // snprintf e sync_ghosts na memória copiada e open/write/rename no ficheiro
+        _exit(save_state_to_file(QUICKSAVE_FILE, game_board) == 0 ? 0 : 1);
+    } else { // processo pai continua a jogar; o filho é recolhido mais tarde (reap_backup)
         backup_pid = pid;
-        int status;
-        waitpid(pid, &status, 0);
+        backup_exists = true; // até o filho dizer o contrário
+        backup_start_ms = start;
+        debug("SAVE %s started (fork stall %.3f ms)\n", QUICKSAVE_FILE, now_ms() - start);
+    }
+}
+
+// Helper: recolhe o filho do quicksave, à espera dele se 'wait' (antes de ler o save), senão só se já acabou
+static void reap_backup(bool wait) {
+    if (backup_pid <= 0) return;
+    int status;
+    pid_t pid = waitpid(backup_pid, &status, wait ? 0 : WNOHANG);
+    if (pid == 0) return; // ainda a escrever
+    backup_exists = pid == backup_pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    debug("SAVE %s %s, reaped after %.2f ms\n", QUICKSAVE_FILE, backup_exists ? "done" : "failed",
+          now_ms() - backup_start_ms);
+    backup_pid = -1;
+}
+
+int autosave_start(board_t* board) {
+    autosave_poll();
+    if (autosave_pid > 0) {
+        autosave_counters.skipped++;
+        return -1;
+    }
+    if (board->stream) return -1; // mundos gerados por tiles não são guardados
+
+    double start = now_ms();
+    pid_t pid = fork();
+    if (pid < 0) {
+        debug("Error: Could not fork the autosave\n");
+        return -1;
+    }
+    if (pid == 0) {
+        // Filho: o mesmo caminho do quicksave (ficheiro temporário e rename), sem malloc nem FILE do stdio
+        _exit(save_state_to_file(AUTOSAVE_FILE, board) == 0 ? 0 : 1);
+    }
+
+    // Pai: a paragem é só o fork(), a escrita fica com o filho
+    double stall = now_ms() - start;
+    autosave_pid = pid;
+    autosave_start_ms = start;
+    autosave_counters.started++;
+    autosave_counters.stall_ms += stall;
+    if (stall > autosave_counters.stall_max_ms) autosave_counters.stall_max_ms = stall;
+    debug("AUTOSAVE %d started (fork stall %.3f ms)\n", (int)pid, stall);
+    return 0;
+}
+
+// Helper: regista o fim do autosave em curso com o estado devolvido por waitpid
+static void autosave_reaped(int status) {
+    bool ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    double elapsed = now_ms() - autosave_start_ms;
+    if (ok) autosave_counters.done++;
+    else autosave_counters.failed++;
+    autosave_counters.write_ms += elapsed;
+    debug("AUTOSAVE %d %s, reaped after %.2f ms\n", (int)autosave_pid, ok ? "done" : "failed", elapsed);
+    autosave_pid = -1;
+}
+
+void autosave_poll(void) {
+    reap_backup(false);
+    if (autosave_pid <= 0) return;
+    int status;
+    pid_t pid = waitpid(autosave_pid, &status, WNOHANG);
+    if (pid == autosave_pid) {
+        autosave_reaped(status);
+    } else if (pid < 0) {
+        autosave_pid = -1; // já não existe
     }
 }
 
-void restore_game(void) {
-    if (!backup_exists) return;
-    // restaura estado do backup
-    restore_board_state(&backup, &backup); // usa backup como fonte
+void autosave_finish(void) {
+    reap_backup(true);
+    if (autosave_pid <= 0) return;
+    int status;
+    if (waitpid(autosave_pid, &status, 0) == autosave_pid)
+        autosave_reaped(status);
+    autosave_pid = -1;
+}
+
+autosave_stats_t autosave_stats(void) {
+    return autosave_counters;
+}
+
+int restore_game(board_t *game_board) {
+    reap_backup(true); // o save pode ainda estar a ser escrito
+    if (!backup_exists) return -1;
+
+    // restaura estado do backup em disco
+    double start = now_ms();
+    board_t restored;
+    if (load_state_from_file(QUICKSAVE_FILE, &restored) != 0)
+        return -1;
+
+    unload_level(game_board);
+    *game_board = restored;
+    debug("LOAD %s (%.2f ms)\n", QUICKSAVE_FILE, now_ms() - start);
+
     free_backup_memory(); // limpa para permitir novo save
+    return 0;
 }
 
 void free_backup_memory(void) {
+    reap_backup(true);
     if (backup_exists) {
-        free_board_backup(&backup);
         backup_exists = false;
         backup_pid = -1;
     }
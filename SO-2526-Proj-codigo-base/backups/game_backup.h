@@ -3,16 +3,85 @@
 
 #include "board.h"
 #include <stdbool.h>
+#include <stdint.h>
 #include <sys/types.h>
 
-// Funções para backup
+// Ficheiro onde o 'G' (quicksave) guarda o jogo
+#define QUICKSAVE_FILE "quicksave.pms"
+
+// Ficheiro do autosave periódico (-A), no mesmo formato do quicksave
+#define AUTOSAVE_FILE "autosave.pms"
+
+/*
+ * Formato binário do save (ordem de bytes do host):
+ *   save_header_t
+ *   n_pacmans nomes de ficheiros .p (256 bytes cada), n_ghosts nomes .m
+ *   width*height células empacotadas (pack_cell)
+ *   n_pacmans x (pos_x, pos_y, alive, points, passo, current_move, n_moves, waiting, lives,
+ *                start_x, start_y) em int32, cada um seguido do seu script
+ *   n_ghosts x (pos_x, pos_y, passo, n_moves, current_move, charged, waiting) em int32
+ *   n_ghosts scripts
+ * Um script são MAX_MOVES x (command, turns, turns_left) em int32, com o cursor turns_left
+ * de cada comando. load_state_from_file recusa agentes fora do tabuleiro, scripts com mais
+ * de MAX_MOVES comandos (ou nenhum, nos fantasmas) e tabuleiros com mais de SAVE_MAX_CELLS.
+ */
+#define SAVE_MAGIC "PMSV"
+#define SAVE_VERSION 2
+#define SAVE_MAX_CELLS (1L << 28)
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    int32_t level_index;        // nível no level_manager_t
+    char level_name[256];
+    int32_t width, height;
+    int32_t tempo;
+    int32_t n_pacmans, n_ghosts;
+    uint32_t rng_state;         // estado do gerador aleatório (movimentos 'R')
+} save_header_t;
+
+// Funções para backup: save_game não espera pelo filho que escreve o save, restore_game espera
 void save_game(board_t *game_board);
-void restore_game(void);
+int restore_game(board_t *game_board);
 void free_backup_memory(void);
 
+/*Escreve o estado completo do jogo em 'filename'
+Retorna 0 em caso de sucesso, -1 em caso de erro*/
+int save_state_to_file(const char* filename, board_t* board);
+
+/*Lê um estado escrito por save_state_to_file para 'board' (que não deve estar carregado)
+Retorna 0 em caso de sucesso, -1 em caso de erro*/
+int load_state_from_file(const char* filename, board_t* board);
+
+/*
+ * Autosave sem pausas: o jogo faz fork() e o filho, com uma cópia copy-on-write do
+ * estado, escreve-o com save_state_to_file e termina, enquanto o pai continua a jogar.
+ * O pai só paga o fork() (a paragem) e recolhe os filhos com waitpid(WNOHANG).
+ */
+typedef struct {
+    unsigned long started;      // filhos criados
+    unsigned long done, failed; // filhos recolhidos, com e sem sucesso
+    unsigned long skipped;      // pedidos com o autosave anterior ainda a ser escrito
+    double stall_ms, stall_max_ms; // paragem do jogo em cada fork(): total e pior caso
+    double write_ms;            // tempo total até os filhos serem recolhidos
+} autosave_stats_t;
+
+/*Começa um autosave de 'board' em AUTOSAVE_FILE sem esperar por ele; é saltado
+se o anterior ainda não acabou
+Retorna 0 se o filho foi criado, -1 se foi saltado ou em caso de erro*/
+int autosave_start(board_t* board);
+
+/*Recolhe o autosave e o quicksave em curso se já tiverem acabado, sem esperar*/
+void autosave_poll(void);
+
+/*Espera pelo autosave e pelo quicksave em curso (saída do jogo)*/
+void autosave_finish(void);
+
+/*Contadores dos autosaves até agora*/
+autosave_stats_t autosave_stats(void);
+
 // Variáveis globais do backup
 extern bool backup_exists;
-extern board_t backup;
 extern pid_t backup_pid;
 
 #endif
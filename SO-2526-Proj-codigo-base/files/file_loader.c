@@ -1,4 +1,5 @@
 #include "file_loader.h"
+#include "memstats.h"
 #include <dirent.h>
 #include <string.h>
 #include <stdlib.h>
@@ -6,6 +7,27 @@
 #include <fcntl.h>
 #include <ctype.h>
 #include <stdio.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <sys/stat.h>
+
+static int loader_threads = LOADER_MAX_THREADS;
+
+// Behavior file read by the loader threads
+typedef struct {
+    const char* name;       // file name inside the level directory
+    command_t* moves;       // MAX_MOVES entries of the agent
+    int n_moves;            // read_behavior_file result
+    int passo, pos_x, pos_y, lives;
+} behavior_job_t;
+
+typedef struct {
+    const char* directory;
+    behavior_job_t* jobs;
+    int n_jobs;
+    atomic_int next;        // next job to take
+} behavior_batch_t;
 
 // Helper function to check if a string ends with a given suffix
 int ends_with(const char* str, const char* suffix) {
@@ -16,6 +38,18 @@ int ends_with(const char* str, const char* suffix) {
 }
 
 int init_level_manager(level_manager_t* manager, const char* directory) {
+    // A single level file: the level manager holds it alone, its directory has the behavior files
+    struct stat st;
+    if (stat(directory, &st) == 0 && S_ISREG(st.st_mode) && ends_with(directory, ".lvl")) {
+        const char* slash = strrchr(directory, '/');
+        snprintf(manager->directory, MAX_FILENAME, "%.*s", slash ? (int)(slash - directory) : 1, slash ? directory : ".");
+        snprintf(manager->level_files[0], MAX_FILENAME, "%s", slash ? slash + 1 : directory);
+        manager->n_levels = 1;
+        manager->current_level = 0;
+        manager->single_file = 1;
+        return 0;
+    }
+
     DIR* dir = opendir(directory);
     if (!dir) {
         debug("Error: Could not open directory %s\n", directory);
@@ -25,6 +59,7 @@ int init_level_manager(level_manager_t* manager, const char* directory) {
     strncpy(manager->directory, directory, MAX_FILENAME - 1);
     manager->n_levels = 0;
     manager->current_level = 0;
+    manager->single_file = 0;
 
     struct dirent* entry;
     while ((entry = readdir(dir)) != NULL && manager->n_levels < MAX_LEVELS) {
@@ -48,6 +83,23 @@ int init_level_manager(level_manager_t* manager, const char* directory) {
     return 0;
 }
 
+int rescan_levels(level_manager_t* manager) {
+    if (manager->single_file) return 0;
+    level_manager_t scanned;
+    if (init_level_manager(&scanned, manager->directory) != 0)
+        return -1;
+
+    // The current level keeps its place by name, a removed one leaves its index to the file after it
+    scanned.current_level = manager->current_level < scanned.n_levels ? manager->current_level : scanned.n_levels - 1;
+    for (int i = 0; i < scanned.n_levels; i++) {
+        if (manager->current_level < manager->n_levels &&
+            strcmp(scanned.level_files[i], manager->level_files[manager->current_level]) == 0)
+            scanned.current_level = i;
+    }
+    *manager = scanned;
+    return 0;
+}
+
 int next_level(level_manager_t* manager) {
     manager->current_level++;
     if (manager->current_level >= manager->n_levels) {
@@ -87,27 +139,109 @@ int read_word(int fd, char* buffer, int max_size) {
     return i;
 }
 
-int read_behavior_file(const char* filepath, command_t* moves, int* passo, int* pos_x, int* pos_y) {
+// Helper function to check that an agent read from a behavior file starts on the board
+static int inside_board(const board_t* board, int x, int y) {
+    return x >= 0 && x < board->width && y >= 0 && y < board->height;
+}
 
+// Helper function to set a cell of the board from its character in the level file
+static void set_cell(board_t* board, int row, int col, char c) {
+    board_pos_t* pos = &board->board[board_index(board, col, row)];
+    if (c == 'X') {
+        pos->content = 'W';
+        pos->has_dot = 0;
+    } else if (c == 'o') {
+        pos->content = ' ';
+        pos->has_dot = 1;
+    } else if (c == '@') {
+        pos->content = ' ';
+        pos->has_portal = 1;
+        pos->has_dot = 0;
+    }
+}
+
+// Helper function to read a word from the text of a behavior file, same rules as read_word
+static int next_word(const char** cursor, const char* end, char* buffer, int max_size) {
+    const char* c = *cursor;
+    int i = 0;
+
+    // Skip whitespace and comments
+    while (c < end) {
+        if (*c == '#') {
+            while (c < end && *c != '\n') c++;
+            continue;
+        }
+        if (!isspace((unsigned char)*c)) break;
+        c++;
+    }
+
+    // Read word
+    while (c < end && !isspace((unsigned char)*c) && i < max_size - 1)
+        buffer[i++] = *c++;
+
+    buffer[i] = '\0';
+    *cursor = c;
+    return i;
+}
+
+// Helper function to read a whole file with as few read() calls as its size allows
+// Returns a '\0' terminated buffer to free, NULL on error
+static char* read_whole_file(const char* filepath, size_t* size) {
     int fd = open(filepath, O_RDONLY);
-    if (fd < 0) {
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    size_t capacity = (fstat(fd, &st) == 0 && st.st_size > 0) ? (size_t)st.st_size + 1 : 4096;
+    char* text = mem_malloc(MEM_LEVEL, capacity);
+    size_t used = 0;
+    ssize_t n = 0;
+    while (text && (n = read(fd, text + used, capacity - 1 - used)) > 0) {
+        used += n;
+        if (used == capacity - 1) { // the file grew since fstat
+            capacity *= 2;
+            char* bigger = mem_realloc(MEM_LEVEL, text, capacity);
+            if (!bigger) mem_free(MEM_LEVEL, text);
+            text = bigger;
+        }
+    }
+    close(fd);
+    if (!text || n < 0) {
+        mem_free(MEM_LEVEL, text);
+        return NULL;
+    }
+    text[used] = '\0';
+    *size = used;
+    return text;
+}
+
+int read_behavior_file(const char* filepath, command_t* moves, int* passo, int* pos_x, int* pos_y, int* lives) {
+
+    size_t size;
+    char* text = read_whole_file(filepath, &size);
+    if (!text) {
         debug("Error: Could not open behavior file %s\n", filepath);
         return -1;
     }
+    const char* cursor = text;
+    const char* end = text + size;
 
     char word[256];
     int n_moves = 0;
     *passo = 0;
+    if (lives) *lives = 1;
 
-    while (read_word(fd, word, sizeof(word)) > 0) {
+    while (next_word(&cursor, end, word, sizeof(word)) > 0) {
         if (strcmp(word, "PASSO") == 0) {
-            read_word(fd, word, sizeof(word));
+            next_word(&cursor, end, word, sizeof(word));
             *passo = atoi(word);
         } else if (strcmp(word, "POS") == 0) {
-            read_word(fd, word, sizeof(word));
+            next_word(&cursor, end, word, sizeof(word));
             *pos_y = atoi(word);
-            read_word(fd, word, sizeof(word));
+            next_word(&cursor, end, word, sizeof(word));
             *pos_x = atoi(word);
+        } else if (strcmp(word, "VIDAS") == 0) {
+            next_word(&cursor, end, word, sizeof(word));
+            if (lives) *lives = atoi(word);
         } else if (strlen(word) == 1 && n_moves < MAX_MOVES) {
             // Single character command
             char cmd = word[0];
@@ -118,7 +252,7 @@ int read_behavior_file(const char* filepath, command_t* moves, int* passo, int*
                 n_moves++;
             } else if (cmd == 'T') {
                 // T command needs a number
-                read_word(fd, word, sizeof(word));
+                next_word(&cursor, end, word, sizeof(word));
                 int turns = atoi(word);
                 moves[n_moves].command = 'T';
                 moves[n_moves].turns = turns;
@@ -128,11 +262,111 @@ int read_behavior_file(const char* filepath, command_t* moves, int* passo, int*
         }
     }
 
-    close(fd);
+    mem_free(MEM_LEVEL, text);
     return n_moves;
 }
 
-int load_level_from_file(board_t* board, level_manager_t* manager, int accumulated_points) {
+// Helper function run by every loader thread: takes the next file until there are none left
+static void* read_behaviors(void* arg) {
+    behavior_batch_t* batch = arg;
+    int i;
+    while ((i = atomic_fetch_add(&batch->next, 1)) < batch->n_jobs) {
+        behavior_job_t* job = &batch->jobs[i];
+        char path[MAX_FILENAME * 2];
+        snprintf(path, sizeof(path), "%s/%s", batch->directory, job->name);
+        job->n_moves = read_behavior_file(path, job->moves, &job->passo, &job->pos_x, &job->pos_y, &job->lives);
+    }
+    return NULL;
+}
+
+// Helper function to read every behavior file of the level, in parallel when there are many
+// Files are independent and each job writes only to its own agent, the board is not touched
+static void load_behaviors(const char* directory, behavior_job_t* jobs, int n_jobs) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    behavior_batch_t batch = {directory, jobs, n_jobs, 0};
+    int n_threads = n_jobs / LOADER_MIN_FILES_PER_THREAD;
+    if (n_threads > loader_threads) n_threads = loader_threads;
+    if (n_threads < 1) n_threads = 1;
+
+    // Threads that cannot be started just leave more files to the others
+    pthread_t threads[LOADER_MAX_THREADS];
+    int started = 0;
+    while (started < n_threads - 1 && pthread_create(&threads[started], NULL, read_behaviors, &batch) == 0)
+        started++;
+    read_behaviors(&batch);
+    for (int t = 0; t < started; t++)
+        pthread_join(threads[t], NULL);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    debug("BEHAVIORS %d files in %.1f ms (%d threads)\n", n_jobs,
+          (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1e6, started + 1);
+}
+
+// Helper function to give a new script to an agent: the cursor stays on its command when the
+// script still has it, the 'T' counters start again and the countdown never exceeds the new PASSO
+static void rescript(command_t* moves, int* n_moves, int* current_move, int* waiting,
+                     const command_t* new_moves, int new_n_moves, int passo) {
+    int current = *n_moves > 0 ? *current_move % *n_moves : 0;
+    memcpy(moves, new_moves, MAX_MOVES * sizeof(command_t));
+    *n_moves = new_n_moves;
+    *current_move = current < new_n_moves ? current : 0;
+    if (*waiting > passo) *waiting = passo;
+}
+
+int reload_behavior_file(board_t* board, const level_manager_t* manager, const char* name) {
+    char path[MAX_FILENAME * 2];
+    snprintf(path, sizeof(path), "%s/%s", manager->directory, name);
+    command_t moves[MAX_MOVES];
+    memset(moves, 0, sizeof(moves));
+    int passo, pos_x = -1, pos_y = -1, lives;
+    int n_moves = read_behavior_file(path, moves, &passo, &pos_x, &pos_y, &lives);
+    if (n_moves < 0) return -1;
+
+    int changed = 0;
+    // A level without pacman files has a single pacman controlled by the user
+    for (int p = 0; p < board->n_pacmans && board->pacman_files[0][0] != '\0'; p++) {
+        if (strcmp(board->pacman_files[p], name) != 0) continue;
+        pacman_t* pac = &board->pacmans[p];
+        rescript(pac->moves, &pac->n_moves, &pac->current_move, &pac->waiting, moves, n_moves, passo);
+        pac->passo = passo;
+        if (pos_x >= 0 && pos_x < board->width && pos_y >= 0 && pos_y < board->height) {
+            board_touch(board, pos_x, pos_y);
+            if (board->board[board_index(board, pos_x, pos_y)].content != 'W') {
+                pac->start_x = pos_x;
+                pac->start_y = pos_y;
+            }
+        }
+        changed++;
+    }
+
+    int ghosts_changed = 0;
+    for (int i = 0; i < board->n_ghosts; i++) {
+        if (strcmp(board->ghosts_files[i], name) != 0) continue;
+        if (n_moves == 0) {
+            debug("Error: %s has no moves, the ghosts keep their old script\n", name);
+            return -1;
+        }
+        if (ghosts_changed == 0) sync_ghosts(board); // the wheel holds the countdowns and the 'T' cursors
+        ghost_t* ghost = &board->ghosts[i];
+        rescript(ghost->moves, &ghost->n_moves, &ghost->current_move, &board->ghost_waiting[i], moves, n_moves, passo);
+        ghost->passo = passo;
+        ghosts_changed++;
+    }
+    if (ghosts_changed > 0)
+        rescript_ghosts(board);
+
+    debug("RELOAD %s: %d agents\n", name, changed + ghosts_changed);
+    return changed + ghosts_changed;
+}
+
+void loader_set_threads(int n_threads) {
+    if (n_threads < 1) n_threads = 1;
+    loader_threads = n_threads > LOADER_MAX_THREADS ? LOADER_MAX_THREADS : n_threads;
+}
+
+int load_level_from_file(board_t* board, level_manager_t* manager, const int* accumulated_points) {
     if (manager->current_level >= manager->n_levels) {
         return -1;
     }
@@ -148,34 +382,56 @@ int load_level_from_file(board_t* board, level_manager_t* manager, int accumulat
     }
 
     strncpy(board->level_name, manager->level_files[manager->current_level], 255);
+    board->level_index = manager->current_level;
     
     char word[256];
-    board->pacman_file[0] = '\0';
+    board->n_pacmans = 0;
     board->n_ghosts = 0;
+    board->ghosts_files = NULL;
+    int ghosts_capacity = 0;
+    int streamed = 0;
+    unsigned int world_seed = 0;
     
     // Read level parameters
-    while (read_word(fd, word, sizeof(word)) > 0) {
+    int has_word = read_word(fd, word, sizeof(word)) > 0;
+    while (has_word) {
         if (strcmp(word, "DIM") == 0) {
             read_word(fd, word, sizeof(word));
             board->height = atoi(word);
             read_word(fd, word, sizeof(word));
             board->width = atoi(word);
+        } else if (strcmp(word, "MUNDO") == 0) {
+            // Generated world, streamed one tile at a time: no board matrix follows
+            read_word(fd, word, sizeof(word));
+            world_seed = (unsigned int)strtoul(word, NULL, 10);
+            streamed = 1;
         } else if (strcmp(word, "TEMPO") == 0) {
             read_word(fd, word, sizeof(word));
             board->tempo = atoi(word);
         } else if (strcmp(word, "PAC") == 0) {
-            read_word(fd, board->pacman_file, sizeof(board->pacman_file));
+            // Read pacman filenames until we hit a non-filename, which is handled as the next word
+            while ((has_word = read_word(fd, word, sizeof(word)) > 0) && ends_with(word, ".p")) {
+                if (board->n_pacmans < MAX_PACMANS) {
+                    strncpy(board->pacman_files[board->n_pacmans], word, 255);
+                    board->n_pacmans++;
+                }
+            }
+            continue;
         } else if (strcmp(word, "MON") == 0) {
-            // Read monster filenames until we hit a non-filename
-            while (read_word(fd, word, sizeof(word)) > 0) {
-                if (ends_with(word, ".m")) {
-                    strncpy(board->ghosts_files[board->n_ghosts], word, 255);
-                    board->n_ghosts++;
-                } else {
-                    // We've hit the board matrix, break and handle it
-                    break;
+            // Read monster filenames until we hit a non-filename, which is handled as the next word
+            while ((has_word = read_word(fd, word, sizeof(word)) > 0) && ends_with(word, ".m")) {
+                if (board->n_ghosts == ghosts_capacity) {
+                    ghosts_capacity = ghosts_capacity ? ghosts_capacity * 2 : 16;
+                    board->ghosts_files = mem_realloc(MEM_LEVEL, board->ghosts_files, ghosts_capacity * sizeof(*board->ghosts_files));
+                    if (!board->ghosts_files) {
+                        close(fd);
+                        return -1;
+                    }
                 }
+                snprintf(board->ghosts_files[board->n_ghosts], sizeof(*board->ghosts_files), "%s", word);
+                board->n_ghosts++;
             }
+            continue;
         }
         
         // Check if we've started reading the board matrix
@@ -183,13 +439,30 @@ int load_level_from_file(board_t* board, level_manager_t* manager, int accumulat
             // This is the first line of the board
             break;
         }
+        has_word = read_word(fd, word, sizeof(word)) > 0;
+    }
+
+    // Without pacman files there is a single pacman controlled by the user
+    int manual_pacman = (board->n_pacmans == 0);
+    if (manual_pacman) {
+        board->n_pacmans = 1;
+        board->pacman_files[0][0] = '\0';
+    }
+
+    // A level cut short by an editor or a copy may lack its dimensions
+    if (board->width <= 0 || board->height <= 0) {
+        debug("Error: %s has no valid dimensions (%d x %d)\n", filepath, board->width, board->height);
+        close(fd);
+        return -1;
     }
 
     // Allocate board memory
-    board->n_pacmans = 1;
-    board->board = calloc(board->width * board->height, sizeof(board_pos_t));
-    board->pacmans = calloc(board->n_pacmans, sizeof(pacman_t));
-    board->ghosts = calloc(board->n_ghosts, sizeof(ghost_t));
+    int mapped = streamed ? board_stream_cells(board, world_seed) : board_alloc_cells(board);
+    board->pacmans = mem_calloc(MEM_AGENTS, board->n_pacmans, sizeof(pacman_t));
+    if (mapped != 0 || !board->pacmans || allocate_ghosts(board, board->n_ghosts) != 0) {
+        close(fd);
+        return -1;
+    }
 
     // Read board matrix
     int row = 0;
@@ -197,18 +470,8 @@ int load_level_from_file(board_t* board, level_manager_t* manager, int accumulat
     int col = 0;
     
     // Process the first word we already read
-    for (int i = 0; word[i] != '\0' && col < board->width; i++) {
-        if (word[i] == 'X') {
-            board->board[row * board->width + col].content = 'W';
-            board->board[row * board->width + col].has_dot = 0;
-        } else if (word[i] == 'o') {
-            board->board[row * board->width + col].content = ' ';
-            board->board[row * board->width + col].has_dot = 1;
-        } else if (word[i] == '@') {
-            board->board[row * board->width + col].content = ' ';
-            board->board[row * board->width + col].has_portal = 1;
-            board->board[row * board->width + col].has_dot = 0;
-        }
+    for (int i = 0; !streamed && word[i] != '\0' && col < board->width; i++) {
+        set_cell(board, row, col, word[i]);
         col++;
     }
     if (col >= board->width) {
@@ -217,19 +480,9 @@ int load_level_from_file(board_t* board, level_manager_t* manager, int accumulat
     }
 
     // Continue reading the rest of the board
-    while (read(fd, &c, 1) == 1 && row < board->height) {
+    while (!streamed && row < board->height && read(fd, &c, 1) == 1) {
         if (c == 'X' || c == 'o' || c == '@') {
-            if (c == 'X') {
-                board->board[row * board->width + col].content = 'W';
-                board->board[row * board->width + col].has_dot = 0;
-            } else if (c == 'o') {
-                board->board[row * board->width + col].content = ' ';
-                board->board[row * board->width + col].has_dot = 1;
-            } else if (c == '@') {
-                board->board[row * board->width + col].content = ' ';
-                board->board[row * board->width + col].has_portal = 1;
-                board->board[row * board->width + col].has_dot = 0;
-            }
+            set_cell(board, row, col, c);
             col++;
             if (col >= board->width) {
                 row++;
@@ -239,49 +492,80 @@ int load_level_from_file(board_t* board, level_manager_t* manager, int accumulat
     }
 
     close(fd);
+    if (!streamed && row < board->height) {
+        debug("Error: %s has %d of its %d rows\n", filepath, row, board->height);
+        return -1;
+    }
 
-    // Load pacman behavior
-    if (strlen(board->pacman_file) > 0) {
-        char pacman_path[MAX_FILENAME * 2];
-        snprintf(pacman_path, sizeof(pacman_path), "%s/%s", manager->directory, board->pacman_file);
-        
-        int pos_x, pos_y;
-        board->pacmans[0].n_moves = read_behavior_file(pacman_path, board->pacmans[0].moves, 
-                                                       &board->pacmans[0].passo, &pos_x, &pos_y);
-        board->pacmans[0].pos_x = pos_x;
-        board->pacmans[0].pos_y = pos_y;
-        board->pacmans[0].current_move = 0;
-        board->pacmans[0].waiting = board->pacmans[0].passo;
-        board->pacmans[0].alive = 1;
-        board->pacmans[0].points = accumulated_points;
-        board->board[pos_y * board->width + pos_x].content = 'P';
-    } else {
-        // Manual control - place at (1,1) by default
-        board->pacmans[0].n_moves = 0;
-        board->pacmans[0].passo = 0;
-        board->pacmans[0].pos_x = 1;
-        board->pacmans[0].pos_y = 1;
-        board->pacmans[0].current_move = 0;
-        board->pacmans[0].waiting = 0;
-        board->pacmans[0].alive = 1;
-        board->pacmans[0].points = accumulated_points;
-        board->board[1 * board->width + 1].content = 'P';
-    }
-
-    // Load ghost behaviors
+    // Read every behavior file first, pacmans then ghosts, the agents are placed afterwards in order
+    int n_pacman_files = manual_pacman ? 0 : board->n_pacmans;
+    int n_jobs = n_pacman_files + board->n_ghosts;
+    behavior_job_t* jobs = mem_calloc(MEM_LEVEL, n_jobs > 0 ? n_jobs : 1, sizeof(behavior_job_t));
+    if (!jobs) return -1;
+    for (int i = 0; i < n_pacman_files; i++) {
+        jobs[i].name = board->pacman_files[i];
+        jobs[i].moves = board->pacmans[i].moves;
+    }
     for (int i = 0; i < board->n_ghosts; i++) {
-        char ghost_path[MAX_FILENAME * 2];
-        snprintf(ghost_path, sizeof(ghost_path), "%s/%s", manager->directory, board->ghosts_files[i]);
-        int pos_x, pos_y;
-        board->ghosts[i].n_moves = read_behavior_file(ghost_path, board->ghosts[i].moves, 
-                                                      &board->ghosts[i].passo, &pos_x, &pos_y);
-        board->ghosts[i].pos_x = pos_x;
-        board->ghosts[i].pos_y = pos_y;
-        board->ghosts[i].current_move = 0;
-        board->ghosts[i].waiting = board->ghosts[i].passo;
-        board->ghosts[i].charged = 0;
-        board->board[pos_y * board->width + pos_x].content = 'M';
+        jobs[n_pacman_files + i].name = board->ghosts_files[i];
+        jobs[n_pacman_files + i].moves = board->ghosts[i].moves;
+    }
+    load_behaviors(manager->directory, jobs, n_jobs);
+
+    // Place the pacmans
+    for (int i = 0; i < board->n_pacmans; i++) {
+        pacman_t* pac = &board->pacmans[i];
+        if (!manual_pacman) {
+            behavior_job_t* job = &jobs[i];
+            pac->n_moves = job->n_moves;
+            pac->passo = job->passo;
+            pac->lives = job->lives;
+            pac->pos_x = job->pos_x;
+            pac->pos_y = job->pos_y;
+            pac->waiting = pac->passo;
+        } else {
+            // Manual control - place at (1,1) by default
+            pac->n_moves = 0;
+            pac->passo = 0;
+            pac->pos_x = 1;
+            pac->pos_y = 1;
+            pac->waiting = 0;
+            pac->lives = 1;
+        }
+        if (!inside_board(board, pac->pos_x, pac->pos_y)) {
+            debug("Error: Pacman %d of %s starts at (%d, %d), outside the board\n", i, filepath, pac->pos_x, pac->pos_y);
+            mem_free(MEM_LEVEL, jobs);
+            return -1;
+        }
+        pac->start_x = pac->pos_x;
+        pac->start_y = pac->pos_y;
+        pac->current_move = 0;
+        pac->alive = 1;
+        pac->points = accumulated_points[i];
+        board_touch(board, pac->pos_x, pac->pos_y);
+        board->board[board_index(board, pac->pos_x, pac->pos_y)].content = 'P';
+    }
+
+    // Place the ghosts
+    for (int i = 0; i < board->n_ghosts; i++) {
+        behavior_job_t* job = &jobs[n_pacman_files + i];
+        ghost_t* ghost = &board->ghosts[i];
+        ghost->n_moves = job->n_moves;
+        ghost->passo = job->passo;
+        ghost->pos_x = job->pos_x;
+        ghost->pos_y = job->pos_y;
+        if (!inside_board(board, ghost->pos_x, ghost->pos_y)) {
+            debug("Error: Ghost %d of %s starts at (%d, %d), outside the board\n", i, filepath, ghost->pos_x, ghost->pos_y);
+            mem_free(MEM_LEVEL, jobs);
+            return -1;
+        }
+        ghost->current_move = 0;
+        board->ghost_waiting[i] = ghost->passo;
+        ghost->charged = 0;
+        board_touch(board, ghost->pos_x, ghost->pos_y);
+        board->board[board_index(board, ghost->pos_x, ghost->pos_y)].content = 'M';
     }
+    mem_free(MEM_LEVEL, jobs);
 
     debug("Loaded level: %s (dimensions: %dx%d, tempo: %d)\n", 
           board->level_name, board->width, board->height, board->tempo);
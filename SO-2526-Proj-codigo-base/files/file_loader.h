@@ -3,25 +3,33 @@
 
 #include "board.h"
 
+// Behavior files of a level are read by up to LOADER_MAX_THREADS threads,
+// one more thread for every LOADER_MIN_FILES_PER_THREAD files
+#define LOADER_MAX_THREADS 8
+#define LOADER_MIN_FILES_PER_THREAD 64
+
 // Structure to keep track of available level files
 typedef struct {
     char directory[MAX_FILENAME];
     char level_files[MAX_LEVELS][MAX_FILENAME];
     int n_levels;
     int current_level;
+    int single_file;        // made from one .lvl file, not from a directory
 } level_manager_t;
 
 /*
- * Initializes the level manager by scanning the directory for .lvl files
+ * Initializes the level manager by scanning the directory for .lvl files,
+ * or with the single level of a .lvl file
  * Returns 0 on success, -1 on error
  */
 int init_level_manager(level_manager_t* manager, const char* directory);
 
 /*
  * Loads the current level into the board structure
+ * accumulated_points holds the points each pacman (MAX_PACMANS entries) carries from the previous levels
  * Returns 0 on success, -1 on error
  */
-int load_level_from_file(board_t* board, level_manager_t* manager, int accumulated_points);
+int load_level_from_file(board_t* board, level_manager_t* manager, const int* accumulated_points);
 
 /*
  * Advances to the next level
@@ -30,9 +38,36 @@ int load_level_from_file(board_t* board, level_manager_t* manager, int accumulat
 int next_level(level_manager_t* manager);
 
 /*
- * Reads a behavior file (.p or .m) and populates the moves array
+ * Scans the directory again after .lvl files were added or removed (hot reload),
+ * the current level keeps its place by name. Does nothing for a single level file
+ * Returns 0 on success, -1 on error (the level manager is left as it was)
+ */
+int rescan_levels(level_manager_t* manager);
+
+/*
+ * Reads the behavior file 'name' of the level directory again and gives the new script
+ * to every agent of the board that uses it (hot reload). Agents keep their position,
+ * points and lives, and their cursor when it is still inside the new script; a pacman
+ * respawns at the new POS. The ghosts' wheel and timelines are rebuilt on the next play
+ * Returns the number of agents changed, -1 on error (the agents are left as they were)
+ */
+int reload_behavior_file(board_t* board, const level_manager_t* manager, const char* name);
+
+/*
+ * Reads a behavior file (.p or .m), in one go, and populates the moves array
+ * lives (VIDAS command, 1 by default) is only read for pacmans and can be NULL
  * Returns the number of moves read, -1 on error
  */
-int read_behavior_file(const char* filepath, command_t* moves, int* passo, int* pos_x, int* pos_y);
+int read_behavior_file(const char* filepath, command_t* moves, int* passo, int* pos_x, int* pos_y, int* lives);
+
+/*
+ * Returns 1 if 'str' ends with 'suffix', 0 otherwise
+ */
+int ends_with(const char* str, const char* suffix);
+
+/*
+ * Limits the threads that read the behavior files of a level (LOADER_MAX_THREADS by default), for benchmarks
+ */
+void loader_set_threads(int n_threads);
 
 #endif
\ No newline at end of file
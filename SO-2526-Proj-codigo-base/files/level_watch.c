@@ -0,0 +1,73 @@
+#include "level_watch.h"
+#include "file_loader.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+
+static int watch_fd = -1;
+
+int level_watch_open(const char* directory) {
+    level_watch_close();
+    watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watch_fd < 0) {
+        debug("Error: Could not start inotify\n");
+        return -1;
+    }
+    // Editors that save through a temporary file rename it over the old one: IN_MOVED_TO
+    if (inotify_add_watch(watch_fd, directory, IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE) < 0) {
+        debug("Error: Could not watch %s\n", directory);
+        level_watch_close();
+        return -1;
+    }
+    debug("WATCH %s\n", directory);
+    return 0;
+}
+
+int level_watch_poll(char names[][MAX_FILENAME]) {
+    if (watch_fd < 0) return 0;
+
+    int n_names = 0;
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t n;
+    while ((n = read(watch_fd, buffer, sizeof(buffer))) > 0) {
+        for (char* at = buffer; at < buffer + n; at += sizeof(struct inotify_event) + ((struct inotify_event*)at)->len) {
+            struct inotify_event* event = (struct inotify_event*)at;
+            if (event->len == 0) continue;
+            if (!ends_with(event->name, ".lvl") && !ends_with(event->name, ".p") && !ends_with(event->name, ".m"))
+                continue;
+
+            // A file saved several times since the last call is reloaded once
+            int seen = 0;
+            for (int i = 0; i < n_names && !seen; i++)
+                seen = strcmp(names[i], event->name) == 0;
+            if (!seen && n_names < LEVEL_WATCH_MAX_NAMES)
+                snprintf(names[n_names++], MAX_FILENAME, "%s", event->name);
+        }
+    }
+    return n_names;
+}
+
+void level_watch_close(void) {
+    if (watch_fd >= 0) close(watch_fd);
+    watch_fd = -1;
+}
+
+#else
+
+int level_watch_open(const char* directory) {
+    (void)directory;
+    return -1;
+}
+
+int level_watch_poll(char names[][MAX_FILENAME]) {
+    (void)names;
+    return 0;
+}
+
+void level_watch_close(void) {
+}
+
+#endif
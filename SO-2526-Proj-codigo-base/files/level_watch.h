@@ -0,0 +1,28 @@
+#ifndef LEVEL_WATCH_H
+#define LEVEL_WATCH_H
+
+#include "board.h"
+
+// Most file names returned by one level_watch_poll call
+#define LEVEL_WATCH_MAX_NAMES 64
+
+/*
+ * Starts watching the level directory (inotify, Linux only) for .lvl, .p and .m files
+ * written, created, removed or renamed, so they can be reloaded while the game runs
+ * Returns 0 on success, -1 on error or where inotify does not exist
+ */
+int level_watch_open(const char* directory);
+
+/*
+ * Names of the level files changed since the last call, each once, without waiting:
+ * up to LEVEL_WATCH_MAX_NAMES names are written to 'names'
+ * Returns the number of names, 0 when nothing changed or nothing is watched
+ */
+int level_watch_poll(char names[][MAX_FILENAME]);
+
+/*
+ * Stops watching
+ */
+void level_watch_close(void);
+
+#endif
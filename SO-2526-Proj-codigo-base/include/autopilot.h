@@ -0,0 +1,42 @@
+#ifndef AUTOPILOT_H
+#define AUTOPILOT_H
+
+#include "board.h"
+
+/*
+Autopilot for the pacmans without a script (-a): every play it picks the command
+of the pacmans controlled by the user.
+The ghosts are played ahead of the game on a copy of the board without pacmans,
+one play per play of the game, so where every ghost will be in each of the next
+plays is known (for scripts and for 'R' moves, which follow the game's generator).
+The route is searched over (cell, play) states inside a window around the pacman,
+one play after the other, split by rows between threads, and walked back to
+keep only the states from which the pacman still lives to the end of the
+horizon: the first dot (or the portal, once no dot can be reached) among them is
+the goal; when there is none the route ends where the walking distance to the
+goals is the smallest.
+The forecast and the route are kept between plays and only made again when the
+game did not go as forecast or the route ran out. The horizon shrinks when a
+search takes more than half of the level's TEMPO and grows back when it is fast;
+with TEMPO 0 the whole horizon is always searched.
+*/
+#define AUTOPILOT_MAX_HORIZON 64    // plays searched (and forecast) ahead
+#define AUTOPILOT_MIN_HORIZON 8
+#define AUTOPILOT_FORECAST_CELLS (1 << 20) // ghost positions kept for the whole horizon
+#define AUTOPILOT_MAX_CELLS (1L << 22)     // larger boards are not copied, no autopilot there
+#define AUTOPILOT_MAX_THREADS 8
+#define AUTOPILOT_MIN_PARALLEL_CELLS 4096 // smaller layers are searched by the calling thread
+
+/*Prepares the autopilot for the board of a new level, or of a restored game
+Returns 0 on success, -1 when the autopilot cannot play this board (streamed or
+too large worlds, no memory): the pacmans are then controlled by the keys*/
+int autopilot_reset(board_t* board);
+
+/*Command ('W', 'A', 'S', 'D' or 'T' to stay) of the pacmans without a script
+for the next play, for the board given to autopilot_reset*/
+char autopilot_next(board_t* board);
+
+/*Writes the counters of the level to the debug file and frees everything*/
+void autopilot_free();
+
+#endif
@@ -4,7 +4,7 @@
 #define MAX_MOVES 20
 #define MAX_LEVELS 20
 #define MAX_FILENAME 256
-#define MAX_GHOSTS 25
+#define MAX_PACMANS 16
 
 
 typedef enum {
@@ -30,56 +30,191 @@ typedef struct {
     int current_move;
     int n_moves; // number of predefined moves, 0 if controlled by user, >0 if readed from level file
     int waiting;
+    int lives; // deaths left before the pacman is out of the game
+    int start_x, start_y; // where the pacman respawns after losing a life
 } pacman_t;
 
+/*Hot state of a ghost, read when it acts. The countdown between moves lives in
+board_t.ghost_waiting and the script in board_t.ghost_moves so iterating
+many ghosts only pulls the data that is actually used into the cache.
+The other fields stay together on purpose: the countdown was the only field every
+ghost touched on every play (and the timing wheel now skips even that), while a
+ghost that acts reads its position, passo, cursor, charged flag and script pointer
+all at once. One 32-byte record is half a cache line per acting ghost, where
+separate arrays would cost a line per field*/
 typedef struct {
     int pos_x, pos_y; //current position
     int passo; // number of plays to wait between each move
-    command_t moves[MAX_MOVES];
     int n_moves; // number of predefined moves from level file
     int current_move;
-    int waiting;
     int charged;
+    command_t* moves; // MAX_MOVES entries inside board_t.ghost_moves
 } ghost_t;
 
+/*Timing wheel of the ghosts: each ghost is kept in the slot of the play where it
+acts next, so a play only touches the ghosts that are due instead of counting down
+every ghost. A 'T n' wait is skipped in one step, the ghost is only touched again
+when the wait ends. While the wheel is built, ghost_waiting and the turns_left of a
+running 'T' are stale: sync_ghosts writes them back.
+Ghosts with plain scripts follow precomputed timelines (timeline.h) and are only
+on the wheel for the plays in which they move*/
+#define WHEEL_SLOTS 256
+
+struct ghost_timeline;
+
+typedef struct {
+    long now;                 // plays done by move_ghosts
+    int built;                // 0 until the wheel is built from the ghosts' state
+    int heads[WHEEL_SLOTS];   // first ghost of each slot, -1 if empty
+    int* next;                // next ghost in the same slot
+    long* due;                // play in which each ghost acts next
+    unsigned char* in_wait;   // the ghost is in a 'T' that ends at 'due'
+    int* acting;              // scratch: ghosts acting in the current play
+    unsigned char* marked;    // scratch: all zero between plays
+    struct ghost_timeline* lines; // timelines of the ghosts, NULL if none
+    int lines_built;          // timelines are precomputed once per level
+} ghost_wheel_t;
+
 typedef struct {
-    char content;   // stuff like 'P' for pacman 'M' for monster/ghost and 'W' for wall
-    int has_dot;    // whether there is a dot in this position or not
-    int has_portal; // whether there is a portal in this position or not
+    char content;               // stuff like 'P' for pacman 'M' for monster/ghost and 'W' for wall
+    unsigned char has_dot;      // whether there is a dot in this position or not
+    unsigned char has_portal;   // whether there is a portal in this position or not
 } board_pos_t;
 
+/*Cells are stored in square tiles of TILE_SIDE x TILE_SIDE cells, the tiles one
+after the other in row-major order and the cells of a tile in row-major order too,
+so the cells around an agent share a few pages and a tile of 3-byte cells is
+exactly 3 pages. Cells are always found with board_index()*/
+#define TILE_SHIFT 6
+#define TILE_SIDE (1 << TILE_SHIFT)
+#define TILE_CELLS (TILE_SIDE * TILE_SIDE)
+
+/*Streamed worlds keep their cells in a sparse temporary file: a tile is generated
+the first time it is used and dropped from memory after STREAM_IDLE_PLAYS plays
+without use, so only the region around the agents is resident*/
+#define STREAM_IDLE_PLAYS 256
+#define STREAM_EVICT_INTERVAL 64   // plays between passes over the resident tiles
+struct board_stream;
+
 
 typedef struct {
     int width, height;      // dimensions of the board
-    board_pos_t* board;     // actual board, a row-major matrix
+    board_pos_t* board;     // actual board, in tiles (see board_index)
+    int tiles_x;            // tiles in a row of tiles
+    struct board_stream* stream; // streamed world, NULL when every tile is filled at load
     int n_pacmans;          // number of pacmans in the board
-    pacman_t* pacmans;      // array containing every pacman in the board to iterate through when processing (Just 1)
+    pacman_t* pacmans;      // array containing every pacman in the board to iterate through when processing
     int n_ghosts;           // number of ghosts in the board
     ghost_t* ghosts;        // array containing every ghost in the board to iterate through when processing
+    int* ghost_waiting;     // plays each ghost waits before its next move, counted down in one batch per play
+    command_t* ghost_moves; // scripts of every ghost (cold data), MAX_MOVES per ghost
+    ghost_wheel_t* wheel;   // when each ghost acts next
     char level_name[256];   //name for the level file to keep track of which will be the next
-    char pacman_file[256];  // file with pacman movements
-    char ghosts_files[MAX_GHOSTS][256]; // files with monster movements
+    char pacman_files[MAX_PACMANS][256]; // files with pacman movements (none for a single manual pacman)
+    char (*ghosts_files)[256]; // files with monster movements, n_ghosts entries
     int tempo;              // Duration of each play
+    int level_index;        // position of this level in the level directory
+    unsigned int rng_state; // state of the generator behind 'R' moves (rand_r), saved with the game
+    int best_points;        // best points recorded for this level (see scores.h), 0 if none
 } board_t;
 
+/*Position of the cell (x, y) in board->board*/
+static inline long board_index(const board_t* board, int x, int y) {
+    long tile = (long)(y >> TILE_SHIFT) * board->tiles_x + (x >> TILE_SHIFT);
+    return (tile << (2 * TILE_SHIFT)) | ((y & (TILE_SIDE - 1)) << TILE_SHIFT) | (x & (TILE_SIDE - 1));
+}
+
+/*Number of cells stored for a board of width x height (whole tiles)*/
+long board_storage_cells(int width, int height);
+
+/*Maps zeroed cells for a board of board->width x board->height
+Returns 0 on success, -1 on error*/
+int board_alloc_cells(board_t* board);
+
+/*Maps the cells of a streamed world of board->width x board->height, generated
+from 'seed' one tile at a time: walls around the world and scattered inside,
+dots everywhere else and the portal next to the bottom right corner
+Returns 0 on success, -1 on error*/
+int board_stream_cells(board_t* board, unsigned int seed);
+
+/*Unmaps the cells of a board*/
+void board_free_cells(board_t* board);
+
+/*Gives back the memory of n_tiles tiles from first_tile: anonymous cells read as
+zeroes afterwards, the cells of a streamed world are read back from its file*/
+void board_drop_tiles(board_t* board, long first_tile, long n_tiles);
+
+/*Generates the tile of (x, y) of a streamed world if it is new and marks it as used*/
+void stream_touch(board_t* board, int x, int y);
+
+/*Must be called before cells of a streamed world are read or written from outside
+board.c, does nothing on other boards*/
+static inline void board_touch(board_t* board, int x, int y) {
+    if (board->stream) stream_touch(board, x, y);
+}
+
+/*Tiles of a streamed world: generated so far and resident now*/
+void stream_stats(board_t* board, long* generated, long* resident);
+
 /*Makes the current thread sleep for 'int milliseconds' miliseconds*/
 void sleep_ms(int milliseconds);
 
+/*Monotonic clock in milliseconds, for measuring durations*/
+double now_ms(void);
+
 /*Processes a command for Pacman or Ghost(Monster)
 *_index - corresponding index in board's pacman_t/ghost_t array
 command - command to be processed*/
 int move_pacman(board_t* board, int pacman_index, command_t* command);
 int move_ghost(board_t* board, int ghost_index, command_t* command);
 
+/*Moves every pacman for one play, as if they all moved at the same time:
+moves are decided from the same board, two pacmans never end in the same cell
+(the lowest index wins) and pacmans never swap places.
+Pacmans controlled by the user (n_moves == 0) play 'input', which can be NULL.
+Returns REACHED_PORTAL if a pacman reached the portal, DEAD_PACMAN if no pacman
+is alive or has lives left, VALID_MOVE otherwise*/
+int move_pacmans(board_t* board, command_t* input);
+
+/*Same as move_pacmans with a command for each pacman controlled by the user:
+pacman p plays inputs[p] (n_pacmans entries), a '\0' command keeps it in place*/
+int move_pacmans_each(board_t* board, command_t* inputs);
+
+/*Moves every ghost for one play, in index order.
+Only the ghosts due in this play on the timing wheel are visited, the wheel is
+built from ghost_waiting and the scripts on the first call.
+On streamed worlds, the tiles left idle are evicted every STREAM_EVICT_INTERVAL plays*/
+void move_ghosts(board_t* board);
+
+/*Writes the countdown (ghost_waiting) and the cursor of a running 'T' of every
+ghost from the timing wheel, before they are read (saves, checkpoints)*/
+void sync_ghosts(board_t* board);
+
+/*Drops the timing wheel after the ghosts' countdowns or scripts were written from
+outside (rewinds), the next move_ghosts builds it again*/
+void reschedule_ghosts(board_t* board);
+
+/*Drops the timing wheel and the timelines after the scripts of the ghosts were
+replaced (hot reload), the next move_ghosts builds both again from the current
+state. sync_ghosts must be called before the scripts are written*/
+void rescript_ghosts(board_t* board);
+
 /*Process the death of a Pacman*/
 void kill_pacman(board_t* board, int pacman_index);
 
 /*Adds a pacman to the board*/
 int load_pacman(board_t* board, int points);
 
+/*Returns the sum of the points of every pacman*/
+int total_points(const board_t* board);
+
 /*Adds a ghost(monster) to the board*/
 int load_ghost(board_t* board);
 
+/*Allocates n_ghosts ghosts with their countdowns and script storage
+Returns 0 on success, -1 on error*/
+int allocate_ghosts(board_t* board, int n_ghosts);
+
 /*Loads a level into board*/
 int load_level(board_t* board, int accumulated_points);
 
@@ -100,11 +235,10 @@ void debug(const char * format, ...);
 /*Writes the board and its contents to the open debug file*/
 void print_board(board_t* board);
 
-
-// Funções de backup
-void copy_board_state(board_t *dst, board_t *src);
-void restore_board_state(board_t *dst, board_t *src);
-void free_board_backup(board_t *board);
+/*Packs a board position into one byte (content code, dot and portal bits)
+and back, used by the binary board formats*/
+unsigned char pack_cell(const board_pos_t* pos);
+void unpack_cell(unsigned char packed, board_pos_t* pos);
 
 
 
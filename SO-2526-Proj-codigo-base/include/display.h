@@ -2,22 +2,57 @@
 #define DISPLAY_H
 
 #include "board.h"
-#include <ncurses.h>
 
 
 #define DRAW_GAME_OVER 0
 #define DRAW_WIN 1
 #define DRAW_MENU 2
 
+/*Attributes of a drawn character*/
+#define ATTR_BOLD 1
+#define ATTR_DIM 2
+
 
 /*
-Potential Structures for ncurses
+A display backend only knows how to put characters on the screen and read keys,
+the layout of the board is drawn by display.c on top of it.
+put_char/put_text/size are NULL for backends that draw nothing
 */
+typedef struct {
+    const char* name;
+    int (*init)();
+    void (*clear)();
+    void (*put_char)(int row, int col, char c, int colour_i, int attrs);
+    void (*put_text)(int row, int col, int colour_i, const char* text);
+    void (*refresh)();
+    void (*size)(int* rows, int* cols);     // current size of the terminal
+    int (*read_key)();      // never blocks, -1 when no key is waiting
+    void (*cleanup)();
+} display_backend_t;
+
+/*Backends: ncurses (default), raw ANSI escape codes with frame diffing, and null*/
+extern const display_backend_t ncurses_backend;
+extern const display_backend_t ansi_backend;
+extern const display_backend_t null_backend;
+
+/*Frames drawn since terminal_init and the time spent drawing them*/
+typedef struct {
+    unsigned long frames;
+    double draw_ms;
+} display_stats_t;
 
-/*Initialize everything ncurses requires*/
+/*Chooses the backend by name, before terminal_init
+Returns 0 on success, -1 if there is no backend with that name*/
+int display_select(const char* name);
+
+/*Returns the name of the selected backend*/
+const char* display_name();
+
+/*Initialize everything the backend requires*/
 int terminal_init();
 
-/*Draw the board on the screen*/
+/*Draw the board on the screen. Boards larger than the terminal are drawn through
+a viewport centered on the first pacman alive, only the visible cells are visited*/
 void draw_board(board_t* board, int mode);
 
 /*Add a specific character with colour i into position (pos_x,pos_y) of the creen
@@ -32,12 +67,16 @@ Pre loaded colours:
 */
 void draw(char c, int colour_i, int pos_x, int pos_y);
 
-/*Call ncurses refresh() to update the screen*/
+/*Send the drawn frame to the screen*/
 void refresh_screen();
 
-/*Ncurses will be reading the player's inputs*/
+/*Reads the player's inputs without blocking, '\0' when there is no key*/
 char get_input();
 
+/*Returns the frame counters of the selected backend*/
+display_stats_t display_stats();
+
+/*Restores the terminal, the frame counters are written to the debug file*/
 void terminal_cleanup();
 
 #endif
@@ -0,0 +1,60 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdio.h>
+
+/*
+Key to screen latency: every key taken from get_input is stamped, the stamp goes
+with the first frame published after it (a frame dropped by the renderer hands its
+stamp to the one that replaced it) and the render thread closes the sample once
+refresh_screen returns. Each sample is split into the time spent playing the key
+(until renderer_publish), waiting for the render thread, in draw_board and in
+refresh_screen. The key stamp is only touched by the simulation thread and the
+samples only by the render thread.
+*/
+
+/*Log-linear buckets: 8 per power of two, any value is within 12.5% of its bucket*/
+#define LATENCY_SUB_BITS 3
+#define LATENCY_BUCKETS 256
+
+typedef struct {
+    unsigned long counts[LATENCY_BUCKETS];
+    unsigned long n;
+    double sum_us, max_us;
+} latency_histogram_t;
+
+/*Adds a value in microseconds to the histogram*/
+void latency_histogram_add(latency_histogram_t* histogram, double us);
+
+/*Value under which 'fraction' (0 to 1) of the values fall, in microseconds*/
+double latency_histogram_percentile(const latency_histogram_t* histogram, double fraction);
+
+/*Writes the percentiles and one line per non empty power of two, with a bar*/
+void latency_histogram_print(const latency_histogram_t* histogram, FILE* out, const char* title);
+
+/*Writes every sample to 'path' as it is taken, one line each (microseconds):
+total, play, queue, draw, refresh
+Returns 0 on success, -1 on error*/
+int latency_open(const char* path);
+
+/*Monotonic clock in microseconds*/
+double latency_now_us(void);
+
+/*A key was accepted: stamped now, unless an older key has not reached a frame yet*/
+void latency_key(void);
+
+/*Stamp of the oldest key not yet in a frame, 0 if none; the key counts as in a frame from now on*/
+double latency_take_key(void);
+
+/*Closes a sample (render thread): when the key was stamped, when its frame was
+published, when drawing started, when draw_board and refresh_screen returned*/
+void latency_frame(double key_us, double published_us, double draw_us, double drawn_us, double shown_us);
+
+/*Writes the histogram of the whole latency and the mean of each stage, nothing
+when no key was measured. Call once the render thread has stopped*/
+void latency_report(FILE* out);
+
+/*Closes the file of latency_open*/
+void latency_close(void);
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef MEMSTATS_H
+#define MEMSTATS_H
+
+#include <stddef.h>
+
+/*
+Allocation accounting: the heap blocks and mappings of the game are counted by the
+subsystem they belong to, so memory that is never given back (a leak across levels,
+a buffer that only grows) shows up in the counters of its owner.
+A block is counted by its usable size (malloc_usable_size), so a block can be freed
+with mem_free whichever function allocated it. What a block belongs to does not
+depend on who allocates it: the pacmans of a level are MEM_AGENTS whether they come
+from the loader or from a save. Counters are atomic, any thread can allocate.
+*/
+
+typedef enum {
+    MEM_LEVEL,      // cells, file names and the loader's buffers
+    MEM_AGENTS,     // pacmans, ghosts, their scripts, the timing wheel and timelines
+    MEM_BACKUPS,    // checkpoints and saves
+    MEM_LOGGING,    // trace and debug output
+    MEM_AUTOPILOT,  // forecasts and search windows of the autopilot
+    MEM_DISPLAY,    // frames of the render thread and the ansi backend
+    MEM_SCORES,     // index of the score log
+    MEM_OBSERVATIONS, // games of the library and their observation planes
+    MEM_SUBSYSTEMS
+} mem_subsystem_t;
+
+typedef struct {
+    long bytes;     // live bytes (heap blocks and mappings)
+    long peak;      // most live bytes at any time
+    long allocs;    // blocks and mappings handed out
+    long frees;     // blocks and mappings given back
+} mem_stats_t;
+
+/*malloc, calloc and realloc counted for 'subsystem'. mem_realloc takes NULL like
+realloc, the block must already be counted for 'subsystem'*/
+void* mem_malloc(mem_subsystem_t subsystem, size_t size);
+void* mem_calloc(mem_subsystem_t subsystem, size_t n, size_t size);
+void* mem_realloc(mem_subsystem_t subsystem, void* ptr, size_t size);
+
+/*free counted for 'subsystem', takes NULL*/
+void mem_free(mem_subsystem_t subsystem, void* ptr);
+
+/*Counts 'bytes' mapped (positive) or unmapped (negative) with mmap for 'subsystem'*/
+void mem_mapped(mem_subsystem_t subsystem, long bytes);
+
+/*Counters of one subsystem*/
+mem_stats_t mem_stats(mem_subsystem_t subsystem);
+
+/*Short name of a subsystem ("level", "agents", ...)*/
+const char* mem_subsystem_name(mem_subsystem_t subsystem);
+
+/*Resident memory of the process (/proc/self/statm), 0 if unknown*/
+long mem_resident_bytes(void);
+
+/*Bytes in use in the allocator's heap (mallinfo2 on glibc), -1 if unknown*/
+long mem_heap_bytes(void);
+
+/*Writes "name live/peak KB" for every subsystem to 'out' (at most 'size' bytes)*/
+void mem_format(char* out, size_t size);
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef PACMANIST_H
+#define PACMANIST_H
+
+/*
+libpacmanist: the game engine without a terminal, for programs that play many
+games (training, evaluation). A game plays the levels of a directory, or a single
+.lvl file, one step at a time; the caller gives a key for each pacman and reads the
+points collected, the lives lost and whether the game is over.
+The board is observed through planes of bytes, one byte per cell in row-major order
+(y * width + x), kept in one contiguous buffer owned by the game: the buffer is
+updated in place by every step (only the cells the agents left and entered), so it
+is read without copies.
+Built as bin/libpacmanist.a, linked with -lpthread.
+*/
+
+typedef struct pm_game pm_game_t;
+
+// Planes of the observation, each width * height bytes, in this order
+#define PM_PLANE_WALLS 0    // 1 on walls
+#define PM_PLANE_DOTS 1     // 1 on dots not yet eaten
+#define PM_PLANE_PORTAL 2   // 1 on the portal
+#define PM_PLANE_PACMANS 3  // index + 1 of the living pacman on the cell, 0 if none
+#define PM_PLANE_GHOSTS 4   // 1 on a ghost, 2 on a charged ghost
+#define PM_PLANES 5
+
+// Game states
+#define PM_PLAYING 0
+#define PM_WON 1            // the portal of the last level was reached
+#define PM_LOST 2           // no pacman alive or with lives left
+
+typedef struct {
+    int reward;             // points collected by every pacman in the step
+    int lives_lost;         // lives lost by every pacman in the step
+    int done;               // PM_PLAYING, PM_WON or PM_LOST
+    int level_changed;      // the next level was loaded: the observation may have a new size and address
+} pm_step_t;
+
+/*Creates a game on the first level of 'path' (a level directory or a .lvl file),
+'R' moves start from 'seed'. Streamed worlds (MUNDO) cannot be played.
+Returns NULL on error*/
+pm_game_t* pm_create(const char* path, unsigned int seed);
+
+/*Starts the game again from the first level, 'R' moves from 'seed'
+Returns 0 on success, -1 on error*/
+int pm_reset(pm_game_t* game, unsigned int seed);
+
+/*Plays one step: actions[p] ('W', 'A', 'S', 'D' or 'T') is the key of pacman p
+when it has no behavior file, anything else keeps it in place; scripted pacmans
+follow their files. actions has pm_pacmans() entries, or is NULL.
+Returns 0 on success, -1 when the game is already over or the next level could not
+be loaded (the game is then lost and every plane of the observation is zero)*/
+int pm_step(pm_game_t* game, const char* actions, pm_step_t* step);
+
+/*Number of pacmans of the current level*/
+int pm_pacmans(const pm_game_t* game);
+
+/*The observation: PM_PLANES planes of width * height bytes. The pointer stays valid
+until a step that changes level, pm_reset or pm_free*/
+const unsigned char* pm_observation(const pm_game_t* game, int* width, int* height);
+
+/*Frees a game*/
+void pm_free(pm_game_t* game);
+
+#endif
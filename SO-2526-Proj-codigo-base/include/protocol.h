@@ -0,0 +1,51 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Game server protocol over a UNIX domain stream socket (host byte order):
+ *   client -> server: one byte per key (W/A/S/D, Q to leave)
+ *   server -> client: messages of uint8 type + uint32 payload length + payload
+ *     'L' level:  char level_name[256], sent before the keyframe of each level
+ *     'F' frame:  int32 session state (SESSION_*) + one trace record ('K' or 'D', see trace.h)
+ * A client that falls more than 1 MB of unsent messages behind is disconnected.
+ */
+#define PROTO_MSG_LEVEL 'L'
+#define PROTO_MSG_FRAME 'F'
+#define PROTO_HEADER_SIZE 5
+#define PROTO_DEFAULT_SOCKET "/tmp/pacmanist.sock"
+
+/*Growable byte buffer for messages waiting to be sent or parsed*/
+typedef struct {
+    unsigned char* data;
+    size_t size;        // bytes stored
+    size_t start;       // bytes already consumed (sent or parsed)
+    size_t capacity;
+} proto_buffer_t;
+
+/*Appends a message header for a payload of 'length' bytes
+Returns 0 on success, -1 on error*/
+int proto_put_header(proto_buffer_t* buffer, char type, uint32_t length);
+
+/*Appends raw bytes
+Returns 0 on success, -1 on error*/
+int proto_put(proto_buffer_t* buffer, const void* bytes, size_t size);
+
+/*Writes as much of the buffer as the non-blocking socket takes
+Returns 1 when everything was sent, 0 if bytes are left, -1 on error*/
+int proto_flush(int fd, proto_buffer_t* buffer);
+
+/*Reads everything available from a non-blocking socket into the buffer
+Returns 1 while the socket is open, 0 when the peer closed it, -1 on error*/
+int proto_receive(int fd, proto_buffer_t* buffer);
+
+/*Takes the next complete message of the buffer
+Returns 1 with its type, payload and length, 0 if no complete message is buffered*/
+int proto_next(proto_buffer_t* buffer, char* type, const unsigned char** payload, uint32_t* length);
+
+/*Frees the buffer*/
+void proto_free(proto_buffer_t* buffer);
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef REFERENCE_H
+#define REFERENCE_H
+
+#include "board.h"
+
+/*
+Reference engine: the rules of board.c written the plain way, with one row-major
+array of cells and every ghost counting its own passo down every play. There is
+no timing wheel, no timelines, no tiles and no sorting, so what it does can be
+checked against the rules by reading it. It is only used by the differential
+harness (tools/difftest.c), which plays the same game on both engines and compares
+them after every play: changes to board.c must keep both engines in step, and
+changes to the rules must be made in both.
+
+It is an independent rewrite, not the original board.c kept aside: by the time it
+was written board.c already had rules the original did not (simultaneous pacman
+moves, lives, respawns), so an agreement between the two is evidence only for the
+rules written here, with the rest of the game left out:
+ - passo: an agent waits passo plays before each action
+ - W/A/S/D moves, 'R' drawn with rand_r from the board's generator like board.c,
+   'T n' holds the script for n actions, 'C' charges the ghost's next move
+ - walls stop agents, portals are entered through walls and end the level
+ - dots give a point, a ghost entering a pacman's cell kills the first living
+   pacman there by index, a pacman entering a ghost's cell dies
+ - a charged ghost runs until a wall, a ghost, the edge or the first pacman it kills
+ - pacmans plan from the same board: lowest index wins a cell, no swaps, nobody
+   enters the cell of a pacman that stays
+ - a dead pacman with lives left respawns at its start cell when it is empty
+ - ghosts act in index order, after the pacmans of the same play
+Input, drawing, levels, saves and scores are not modelled.
+*/
+
+typedef struct {
+    int pos_x, pos_y;
+    int passo;
+    int waiting;        // plays left before the next command
+    int n_moves;
+    int current_move;
+    int charged;
+    command_t moves[MAX_MOVES];
+} ref_ghost_t;
+
+typedef struct {
+    int width, height;
+    board_pos_t* cells;     // row-major, cells[y * width + x]
+    int n_pacmans;
+    pacman_t* pacmans;
+    int n_ghosts;
+    ref_ghost_t* ghosts;
+    unsigned int rng_state; // 'R' moves, same generator and draws as the game
+} ref_board_t;
+
+/*Copies the state of a board (cells, agents, generator) into a new reference board
+Returns 0 on success, -1 on error*/
+int ref_from_board(ref_board_t* ref, board_t* board);
+
+/*Frees a board made by ref_from_board*/
+void ref_free(ref_board_t* ref);
+
+/*Same contract as move_pacmans and move_ghosts (board.h)*/
+int ref_move_pacmans(ref_board_t* ref, command_t* input);
+void ref_move_ghosts(ref_board_t* ref);
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include "board.h"
+
+/*Boards with more tiles than this only have the tiles around the followed pacman
+copied into the frames, enough for any terminal the viewport can fill*/
+#define RENDER_WINDOW_TILES_X 9
+#define RENDER_WINDOW_TILES_Y 7
+
+/*Immutable copy of the board handed from the simulation to the render thread*/
+typedef struct {
+    board_t board;          // private copy of the board, pacmans and ghosts
+    int mode;               // DRAW_* mode to draw the frame with
+    int window_x0, window_y0, window_x1, window_y1; // tiles [x0, x1) x [y0, y1) copied into the cells
+    int pacmans_capacity;   // allocated pacman_t entries
+    int ghosts_capacity;    // allocated ghost_t entries
+    double key_us;          // stamp of the oldest key this frame shows (latency.h), 0 if none
+    double published_us;    // when renderer_publish handed it over
+} frame_t;
+
+/*Frame counters, reported to the debug file by renderer_stop*/
+typedef struct {
+    unsigned long published;  // frames handed over by the simulation
+    unsigned long drawn;      // frames drawn by the render thread
+    unsigned long dropped;    // frames replaced before the render thread could draw them
+} render_stats_t;
+
+/*Starts the render thread, the terminal must already be initialized
+Returns 0 on success, -1 on error*/
+int renderer_start();
+
+/*Copies the board into the free buffer and makes it the newest frame.
+Never waits for the render thread: an undrawn frame is dropped instead*/
+void renderer_publish(board_t* board, int mode);
+
+/*Reads a key (same keys as get_input) if there is one, '\0' otherwise
+A key is stamped for the latency (latency.h) until a frame shows it*/
+char renderer_poll_input();
+
+/*Waits for a key (same keys as get_input) without blocking the render thread*/
+char renderer_get_input();
+
+/*Draws the last pending frame, stops the render thread and frees the buffers*/
+void renderer_stop();
+
+/*Returns a copy of the current frame counters*/
+render_stats_t renderer_stats();
+
+#endif
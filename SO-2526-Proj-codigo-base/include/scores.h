@@ -0,0 +1,79 @@
+#ifndef SCORES_H
+#define SCORES_H
+
+#include <stdint.h>
+
+/*
+High scores of every game and every server session, kept in an append-only log:
+fixed size records added with one write() on a descriptor opened with O_APPEND,
+so any number of processes append at the same time without locks and a record
+is never split. The log is the only truth, records are never rewritten.
+An index ('log'.idx) keeps the SCORES_TOP best points of every level and of whole
+games, sorted by level name, and how far into the log it was built. It is brought
+up to date by folding only the records appended since, read through mmap, under
+flock on the log, and replaced with a rename so readers never see half of it.
+Queries are answered from the index in memory (a binary search by level name).
+*/
+
+#define SCORES_FILE "scores.pms"
+#define SCORES_TOP 10           // best points kept for each level
+#define SCORES_NAME 104         // level names are cut to SCORES_NAME - 1 characters
+
+#define SCORE_RECORD_MAGIC "PMSR"
+typedef struct {
+    char magic[4];
+    int32_t points;             // points of the level, or of the whole game
+    int64_t time;               // seconds since the epoch
+    int32_t pid;
+    int32_t reserved;
+    char level[SCORES_NAME];    // level file name, "" for a whole game
+} score_record_t;
+
+#define SCORE_INDEX_MAGIC "PMSI"
+#define SCORE_INDEX_VERSION 1
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint64_t log_offset;        // bytes of the log folded into the index
+    int32_t n_levels;
+    int32_t top;                // SCORES_TOP when written
+} score_index_header_t;
+
+typedef struct {
+    char level[SCORES_NAME];    // "" for whole games, sorted first
+    int32_t count;              // records of this level
+    int32_t top[SCORES_TOP];    // best points, highest first, count of them are valid
+} score_entry_t;
+
+/*Opens, creating them when needed, the log 'path' and its index, and loads the
+index brought up to date with the records appended since it was written
+Returns 0 on success, -1 on error*/
+int scores_open(const char* path);
+
+/*Appends the points of a level ('level' its file name) or of a whole game ('level'
+NULL), then folds the log into the index in memory
+Returns 0 on success, -1 on error or when no log is open*/
+int scores_add(const char* level, int points);
+
+/*Folds the records appended by every process since the last call into the index in
+memory, costs one fstat when nothing was appended*/
+void scores_refresh(void);
+
+/*Best points of 'level' (NULL for whole games), 0 if none*/
+int scores_best(const char* level);
+
+/*Writes up to 'k' best points of 'level' (NULL for whole games), highest first, and
+the number of records in 'count' (can be NULL)
+Returns the number of points written*/
+int scores_top(const char* level, int* points, int k, int* count);
+
+/*Number of levels in the index, not counting whole games*/
+int scores_levels(void);
+
+/*Entry 'i' of the index (0 is whole games, then levels by name), NULL past the end*/
+const score_entry_t* scores_entry(int i);
+
+/*Writes the index back and closes the log*/
+void scores_close(void);
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include "board.h"
+#include "file_loader.h"
+
+#define SESSION_PLAYING 0
+#define SESSION_WON 1
+#define SESSION_OVER 2
+
+/*One game with no terminal attached: the levels of a directory played in
+order, driven by keys handed in by the caller (used by the game server)*/
+typedef struct {
+    board_t board;
+    level_manager_t levels;
+    int accumulated_points[MAX_PACMANS];
+    int state;              // SESSION_PLAYING, SESSION_WON or SESSION_OVER
+    int manual;             // some pacman of the current level is controlled by keys
+    int level_changed;      // a new level was loaded by the last step
+    int record_scores;      // levels and games played go to the score log (see scores.h)
+    int level_start_points; // points of every pacman when the current level started
+} session_t;
+
+/*Loads the first level of 'directory', random moves start from 'seed'
+Returns 0 on success, -1 on error*/
+int session_start(session_t* session, const char* directory, unsigned int seed);
+
+/*Plays one step as game.c does: 'key' moves the manual pacmans ('\0' when the
+level has none), then every ghost moves. 'Q' ends the game.
+Returns 1 if a play happened, 0 if the key was ignored*/
+int session_step(session_t* session, char key);
+
+/*Plays one step with a key for each pacman: keys[p] ('W', 'A', 'S', 'D' or 'T')
+moves pacman p when it is controlled by keys, anything else keeps it in place
+(used by the library, pacmanist.h). keys can be NULL.
+Returns 1 if a play happened, 0 if the game is over*/
+int session_step_each(session_t* session, const char* keys);
+
+/*From now on the points of each level and of the whole game are added to the
+score log opened with scores_open when they end, and board.best_points shows the
+best of the current level*/
+void session_record_scores(session_t* session);
+
+/*Unloads the current level*/
+void session_end(session_t* session);
+
+#endif
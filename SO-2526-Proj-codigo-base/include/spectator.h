@@ -0,0 +1,61 @@
+#ifndef SPECTATOR_H
+#define SPECTATOR_H
+
+#include "board.h"
+#include <stdatomic.h>
+#include <stddef.h>
+
+#define SPECTATOR_DEFAULT_NAME "/pacmanist"
+
+/*Agent entry published to the spectators
+For pacmans 'state' is the alive flag, for ghosts it is the charged flag*/
+typedef struct {
+    int pos_x, pos_y;
+    int state;
+    int points;
+    int lives;
+} spectator_agent_t;
+
+/*Header at the start of the shared memory segment.
+The header is followed by width*height board_pos_t cells, then n_pacmans
+and n_ghosts spectator_agent_t entries.*/
+typedef struct {
+    atomic_uint seq;        // seqlock sequence number, odd while the game is writing
+    atomic_int closed;      // set when the game process exits
+    int width, height;
+    int n_pacmans;
+    int n_ghosts;
+    int mode;               // DRAW_* mode of the last published frame
+    int tick;               // number of frames published so far
+    char level_name[256];
+} spectator_header_t;
+
+/*Creates the shared memory segment 'name' where the board is published
+Returns 0 on success, -1 on error*/
+int spectator_open(const char* name);
+
+/*Copies the board, the agents and the points into the shared memory segment.
+Never blocks: spectators retry their reads while a publish is in progress*/
+void spectator_publish(board_t* board, int mode);
+
+/*Marks the segment as closed and removes it*/
+void spectator_close();
+
+/*Spectator side: maps the segment 'name' read-only
+Returns 0 on success, -1 on error*/
+int spectator_attach(const char* name);
+
+/*Spectator side: takes a consistent copy of the last published frame into 'board'
+(board memory is (re)allocated as needed and released with spectator_free_board)
+'tick' holds the last frame seen by the caller and is updated on a new frame
+Returns 1 if a new frame was copied, 0 if nothing changed, -1 if the game has closed the segment
+or a whole frame could not be copied (out of memory, segment smaller than its header says)*/
+int spectator_read(board_t* board, int* mode, int* tick);
+
+/*Spectator side: frees the memory allocated by spectator_read*/
+void spectator_free_board(board_t* board);
+
+/*Spectator side: unmaps the segment*/
+void spectator_detach();
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include "board.h"
+
+/*
+Trajectories of the ghosts with plain W/A/S/D/T scripts, simulated once per level
+against the walls only. Every act of a ghost (a move, a move into a wall or one turn
+of a 'T') takes passo + 1 plays, so while nothing gets in its way the position of
+such a ghost only depends on how many acts it did since the start of its script.
+Only the acts that change the position are kept, as events, over the period after
+which the ghost is back at its origin with the script at the start.
+A ghost follows its timeline while the cells it moves to are free, falls back to
+live simulation when they are not, and joins it again when it is back at the origin
+at the start of its script.
+*/
+#define TIMELINE_MAX_CYCLES 8   // passes of the script tried to get back to the origin
+#define TIMELINE_MAX_THREADS 8
+#define TIMELINE_MIN_PARALLEL 1024 // fewer ghosts are precomputed by the calling thread
+
+typedef struct {
+    int step;           // act, counted from the start of the period, that moves the ghost
+    int pos_x, pos_y;   // position after the move
+} timeline_event_t;
+
+typedef struct ghost_timeline {
+    // Precomputed, 'events' is NULL when the ghost has no timeline
+    int origin_x, origin_y; // position at the start of the script
+    int cycle_steps;        // acts in one pass of the script ('T n' counts n)
+    int period_steps;       // acts until the ghost is back at the origin
+    int n_events;
+    timeline_event_t* events;
+
+    // Ghost following the timeline
+    int following;
+    int event;              // next event
+    long start;             // play of the first act after joining
+    long laps;              // periods done since joining
+    int base_move;          // current_move when joining
+} ghost_timeline_t;
+
+/*Precomputes the timelines of every ghost of the board, in parallel for many ghosts
+Returns n_ghosts timelines, NULL on error or when timelines are turned off*/
+ghost_timeline_t* timeline_build(board_t* board);
+
+/*Frees the timelines of n ghosts*/
+void timeline_free(ghost_timeline_t* lines, int n);
+
+/*Script cursor of a ghost after 'steps' acts from the start of its script:
+the number of moves to add to current_move and the turns left of the command reached*/
+void timeline_cursor(const ghost_t* ghost, const ghost_timeline_t* line, long steps, int* moves, int* turns_left);
+
+/*Turns timelines on or off (on by default), for benchmarks*/
+void timeline_enable(int enabled);
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "board.h"
+#include <stdio.h>
+#include <stdint.h>
+
+/*
+ * Binary board trace (host byte order):
+ *   file header: "PMTR" + uint32 version
+ *   'K' keyframe: uint32 tick, int32 width, height, n_pacmans, n_ghosts,
+ *                 width*height packed cells (pack_cell), then every agent
+ *   'D' delta:    uint32 tick, uint32 n_cells, uint32 n_agents,
+ *                 n_cells x (uint32 index, uint8 packed cell),
+ *                 n_agents x (uint32 agent index, agent)
+ * Agents are the pacmans followed by the ghosts.
+ */
+#define TRACE_MAGIC "PMTR"
+#define TRACE_VERSION 2
+#define TRACE_KEYFRAME_INTERVAL 1000 // ticks between forced keyframes
+
+/*Agent as stored in the trace
+For pacmans 'state' is the alive flag, for ghosts it is the charged flag*/
+typedef struct {
+    int32_t pos_x, pos_y;
+    int32_t state;
+    int32_t points;
+    int32_t lives;
+} trace_agent_t;
+
+/*Board rebuilt from a trace*/
+typedef struct {
+    uint32_t tick;
+    int width, height;
+    int n_pacmans, n_ghosts;
+    unsigned char* cells;     // packed cells, width*height
+    trace_agent_t* agents;    // n_pacmans + n_ghosts
+} trace_state_t;
+
+/*In-memory encoder: keeps its own copy of the last board it encoded, so any
+number of independent streams (the trace file, network sessions) can be encoded*/
+typedef struct {
+    trace_state_t last;       // board as of the last record encoded
+    uint32_t tick;            // tick of the next record
+    uint32_t last_keyframe;   // tick of the last keyframe
+    unsigned char* data;      // the last encoded record
+    size_t size;              // bytes in data
+    size_t capacity;          // allocated bytes in data
+} trace_encoder_t;
+
+/*Encodes a keyframe of the board into encoder->data*/
+void trace_encode_keyframe(trace_encoder_t* encoder, board_t* board);
+
+/*Encodes the cells and agents that changed since the last record into encoder->data,
+or a keyframe when the board changed shape or the keyframe interval elapsed*/
+void trace_encode_record(trace_encoder_t* encoder, board_t* board);
+
+/*Frees the memory of an encoder, the next record it encodes is a keyframe*/
+void trace_encoder_free(trace_encoder_t* encoder);
+
+/*Opens 'filename' for writing the trace
+Returns 0 on success, -1 on error*/
+int trace_open(const char* filename);
+
+/*Writes a keyframe of the board, called when a level starts*/
+void trace_begin_level(board_t* board);
+
+/*Writes the cells and agents that changed since the last call*/
+void trace_record(board_t* board);
+
+/*Flushes and closes the trace*/
+void trace_close();
+
+/*Decoder side: checks the header of an open trace file
+Returns 0 on success, -1 if it is not a trace*/
+int trace_read_header(FILE* file);
+
+/*Decoder side: applies the next record of the trace to 'state'
+Returns 1 if a record was applied, 0 at the end of the trace, -1 on a corrupted record*/
+int trace_read_record(FILE* file, trace_state_t* state);
+
+/*Decoder side: frees the memory of a trace state*/
+void trace_free_state(trace_state_t* state);
+
+#endif
@@ -0,0 +1,725 @@
+#include "autopilot.h"
+#include "memstats.h"
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Flags of a cell of the search window
+#define CELL_BLOCKED 1  // wall, outside the board, another pacman, or the portal while dots are left
+#define CELL_GOAL 2     // a dot, or the portal once no dot can be reached
+
+#define REACHED_VIABLE 0x80 // added to the command of a reached cell
+
+typedef struct {
+    int x, y;
+} forecast_cell_t;
+
+// Cells with a ghost after one play: the ghosts in index order, then the cells crossed by charged moves.
+// The same cells are sorted by tile, so a search only visits the tiles under its window
+typedef struct {
+    forecast_cell_t* cells;
+    forecast_cell_t* by_tile;   // cells of tile i in [tile_start[i], tile_start[i + 1])
+    int* tile_start;            // n_tiles + 1 entries
+    int n_cells;
+    int capacity;
+} forecast_slot_t;
+
+// Forecast of the ghosts: 'shadow' is played ahead of the game, one play per play of the game
+static board_t shadow;              // walls and ghosts of the game, without pacmans
+static bool forecast_ready = false;
+static forecast_slot_t slots[AUTOPILOT_MAX_HORIZON + 1]; // ring of horizon_max + 1 plays
+static int first_slot;              // slot of the play forecast_now
+static long forecast_now;           // play of the game (wheel->now) in the first slot
+static unsigned long forecast_generation; // changes every time the forecast is made again
+static unsigned char* was_charged;  // scratch: ghosts charged before a play of the copy
+static int horizon_max;             // plays forecast
+static int horizon;                 // plays searched, adapted to the time budget
+static long n_tiles;                // tiles of the board
+
+// Route: route_commands[i] is played in play route_now + i and leaves the pacman on route_cells[i]
+static char route_commands[AUTOPILOT_MAX_HORIZON];
+static forecast_cell_t route_cells[AUTOPILOT_MAX_HORIZON];
+static forecast_cell_t route_from;  // cell of the pacman when the route was searched
+static int route_length;
+static long route_now;
+static bool route_to_goal;          // the route ends on a goal, not only closer to one
+static unsigned long route_generation;
+
+// Walking distance from every cell to the nearest goal, ignoring the ghosts
+static int* togo = NULL;
+static long togo_size;
+static int* togo_queue = NULL;
+static int togo_points = -1;        // total points when it was made, it is made again when they change
+static bool portal_mode = false;    // no dot can be reached: the portal is the goal
+
+// Search window: side x side cells around the pacman, one layer of cells per play
+static struct {
+    int h;                  // plays searched
+    int side;               // 2 * h + 3: the reachable cells and a border never reached
+    long size;              // side * side
+    int x0, y0;             // board position of the first cell of the window
+    int t;                  // layer being searched
+    int last;               // last layer with a cell reached
+    int cleared_side;       // side of the window when the layers were last cleared
+    unsigned char can_move[AUTOPILOT_MAX_HORIZON + 2]; // the pacman can move in that play (passo)
+    unsigned char* flags;   // CELL_* of every cell
+    unsigned char* danger;  // h + 1 layers: 1 where a ghost is after that play
+    unsigned char* reached; // h + 1 layers: command that reaches the cell in that play, 0 if none,
+                            // with REACHED_VIABLE once the pacman is known to survive from there
+} window;
+
+// Threads sharing the layers of a search
+static pthread_t workers[AUTOPILOT_MAX_THREADS];
+static int n_workers = 0;           // threads started besides the one playing the game
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_start = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pool_done = PTHREAD_COND_INITIALIZER;
+static void (*pool_job)(int share, int shares);
+static unsigned long pool_round = 0;
+static int pool_pending = 0;
+static bool pool_quit = false;
+static struct {
+    int share;              // shares are numbered from 1, the calling thread takes share 0
+    unsigned long round;    // pool_round when the thread was started: it runs every later round
+} worker_args[AUTOPILOT_MAX_THREADS];
+static int share_count[AUTOPILOT_MAX_THREADS];
+static int share_goal[AUTOPILOT_MAX_THREADS];
+
+// Counters of the level, written to the debug file by the next reset or by autopilot_free
+static struct {
+    char level_name[256];
+    unsigned long plays, searches, kept, forecasts, fields;
+    double search_ms, max_search_ms;
+} stats;
+
+static void* pool_worker(void* arg) {
+    int w = (int)(long)arg;
+    int share = worker_args[w].share;
+    pthread_mutex_lock(&pool_mutex);
+    // Not the round of whenever this thread first gets the mutex: pool_run may have started one by then
+    unsigned long seen = worker_args[w].round;
+    while (true) {
+        while (pool_round == seen && !pool_quit)
+            pthread_cond_wait(&pool_start, &pool_mutex);
+        if (pool_quit) break;
+        seen = pool_round;
+        pthread_mutex_unlock(&pool_mutex);
+
+        pool_job(share, n_workers + 1);
+
+        pthread_mutex_lock(&pool_mutex);
+        if (--pool_pending == 0)
+            pthread_cond_signal(&pool_done);
+    }
+    pthread_mutex_unlock(&pool_mutex);
+    return NULL;
+}
+
+// Helper private function to start the threads of the searches, once
+static void pool_start_workers() {
+    if (n_workers > 0) return;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int wanted = cpus < 1 ? 0 : (cpus > AUTOPILOT_MAX_THREADS ? AUTOPILOT_MAX_THREADS : (int)cpus) - 1;
+    pthread_mutex_lock(&pool_mutex);
+    pool_quit = false;
+    unsigned long round = pool_round;
+    pthread_mutex_unlock(&pool_mutex);
+    for (int w = 0; w < wanted; w++) {
+        worker_args[w].share = w + 1;
+        worker_args[w].round = round;
+        if (pthread_create(&workers[w], NULL, pool_worker, (void*)(long)w) != 0)
+            break; // fewer threads, the shares are split between the ones started
+        n_workers++;
+    }
+}
+
+// Helper private function to run job(share, shares) on every thread and wait for all of them
+// When 'parallel' is false, or there are no threads, the calling thread does it all
+static void pool_run(void (*job)(int share, int shares), bool parallel) {
+    if (!parallel || n_workers == 0) {
+        job(0, 1);
+        return;
+    }
+    pthread_mutex_lock(&pool_mutex);
+    pool_job = job;
+    pool_pending = n_workers;
+    pool_round++;
+    pthread_cond_broadcast(&pool_start);
+    pthread_mutex_unlock(&pool_mutex);
+
+    job(0, n_workers + 1);
+
+    pthread_mutex_lock(&pool_mutex);
+    while (pool_pending > 0)
+        pthread_cond_wait(&pool_done, &pool_mutex);
+    pthread_mutex_unlock(&pool_mutex);
+}
+
+static void pool_stop() {
+    pthread_mutex_lock(&pool_mutex);
+    pool_quit = true;
+    pthread_cond_broadcast(&pool_start);
+    pthread_mutex_unlock(&pool_mutex);
+    for (int w = 0; w < n_workers; w++)
+        pthread_join(workers[w], NULL);
+    n_workers = 0;
+}
+
+// Helper private function to append a cell to a forecast slot
+static int add_cell(forecast_slot_t* slot, int x, int y) {
+    if (slot->n_cells == slot->capacity) {
+        int capacity = slot->capacity * 2 + 16;
+        forecast_cell_t* cells = mem_realloc(MEM_AUTOPILOT, slot->cells, capacity * sizeof(forecast_cell_t));
+        if (cells) slot->cells = cells;
+        forecast_cell_t* by_tile = mem_realloc(MEM_AUTOPILOT, slot->by_tile, capacity * sizeof(forecast_cell_t));
+        if (by_tile) slot->by_tile = by_tile;
+        if (!cells || !by_tile) return -1;
+        slot->capacity = capacity;
+    }
+    slot->cells[slot->n_cells++] = (forecast_cell_t){x, y};
+    return 0;
+}
+
+// Helper private function to record where the ghosts of the copy are
+// 'before' is the slot of the previous play (NULL for the first slot), to add the cells crossed by charged moves
+static int record_slot(forecast_slot_t* slot, const forecast_slot_t* before) {
+    slot->n_cells = 0;
+    for (int i = 0; i < shadow.n_ghosts; i++) {
+        if (add_cell(slot, shadow.ghosts[i].pos_x, shadow.ghosts[i].pos_y) != 0) return -1;
+    }
+
+    // A charged move kills a pacman anywhere on its way, not only where it stops
+    for (int i = 0; before && i < shadow.n_ghosts; i++) {
+        ghost_t* ghost = &shadow.ghosts[i];
+        if (!was_charged[i] || ghost->charged) continue;
+        forecast_cell_t from = before->cells[i];
+        int dx = (ghost->pos_x > from.x) - (ghost->pos_x < from.x);
+        int dy = (ghost->pos_y > from.y) - (ghost->pos_y < from.y);
+        if (dx != 0 && dy != 0) continue;
+        for (int x = from.x + dx, y = from.y + dy; (x != ghost->pos_x || y != ghost->pos_y); x += dx, y += dy) {
+            if (add_cell(slot, x, y) != 0) return -1;
+        }
+    }
+
+    // Counting sort by tile
+    if (!slot->tile_start && !(slot->tile_start = mem_malloc(MEM_AUTOPILOT, (n_tiles + 1) * sizeof(int)))) return -1;
+    memset(slot->tile_start, 0, (n_tiles + 1) * sizeof(int));
+    for (int c = 0; c < slot->n_cells; c++)
+        slot->tile_start[board_index(&shadow, slot->cells[c].x, slot->cells[c].y) / TILE_CELLS + 1]++;
+    for (long i = 0; i < n_tiles; i++)
+        slot->tile_start[i + 1] += slot->tile_start[i];
+    for (int c = 0; c < slot->n_cells; c++) {
+        long tile = board_index(&shadow, slot->cells[c].x, slot->cells[c].y) / TILE_CELLS;
+        slot->by_tile[slot->tile_start[tile]++] = slot->cells[c];
+    }
+    for (long i = n_tiles; i > 0; i--) // every start was moved on to the next tile's
+        slot->tile_start[i] = slot->tile_start[i - 1];
+    slot->tile_start[0] = 0;
+    return 0;
+}
+
+// Helper private function to play the copy for one play and record it
+static int forecast_step(forecast_slot_t* slot, const forecast_slot_t* before) {
+    for (int i = 0; i < shadow.n_ghosts; i++)
+        was_charged[i] = (unsigned char)shadow.ghosts[i].charged;
+    move_ghosts(&shadow);
+    return record_slot(slot, before);
+}
+
+static void free_shadow() {
+    if (shadow.board) unload_level(&shadow);
+    memset(&shadow, 0, sizeof(shadow));
+    mem_free(MEM_AUTOPILOT, was_charged);
+    was_charged = NULL;
+    forecast_ready = false;
+}
+
+// Helper private function to copy the walls and the ghosts of the game, without the pacmans
+static int copy_shadow(board_t* board) {
+    free_shadow();
+    sync_ghosts(board); // countdowns and waits as the copy builds its wheel from them
+
+    shadow.width = board->width;
+    shadow.height = board->height;
+    if (board_alloc_cells(&shadow) != 0) return -1;
+    memcpy(shadow.board, board->board, board_storage_cells(board->width, board->height) * sizeof(board_pos_t));
+    for (int p = 0; p < board->n_pacmans; p++) {
+        pacman_t* pac = &board->pacmans[p];
+        board_pos_t* pos = &shadow.board[board_index(&shadow, pac->pos_x, pac->pos_y)];
+        if (pac->alive && pos->content == 'P') pos->content = ' ';
+    }
+
+    was_charged = mem_malloc(MEM_AUTOPILOT, (board->n_ghosts > 0 ? board->n_ghosts : 1) * sizeof(unsigned char));
+    if (!was_charged || allocate_ghosts(&shadow, board->n_ghosts) != 0) return -1;
+    for (int i = 0; i < board->n_ghosts; i++) {
+        command_t* moves = shadow.ghosts[i].moves;
+        shadow.ghosts[i] = board->ghosts[i];
+        shadow.ghosts[i].moves = moves;
+    }
+    memcpy(shadow.ghost_waiting, board->ghost_waiting, board->n_ghosts * sizeof(int));
+    memcpy(shadow.ghost_moves, board->ghost_moves, (size_t)board->n_ghosts * MAX_MOVES * sizeof(command_t));
+    shadow.wheel->now = board->wheel->now;
+    shadow.wheel->lines_built = 1; // played live, a copy made for a few plays is not worth the timelines
+    shadow.rng_state = board->rng_state;
+    return 0;
+}
+
+static inline forecast_slot_t* forecast_slot(int offset) {
+    return &slots[(first_slot + offset) % (horizon_max + 1)];
+}
+
+// Helper private function to forecast the ghosts again from the game
+static int forecast_rebuild(board_t* board) {
+    if (copy_shadow(board) != 0) {
+        debug("Error: Could not copy the board for the autopilot\n");
+        free_shadow();
+        return -1;
+    }
+    first_slot = 0;
+    forecast_now = board->wheel->now;
+    if (record_slot(forecast_slot(0), NULL) != 0) return -1;
+    for (int t = 1; t <= horizon_max; t++) {
+        if (forecast_step(forecast_slot(t), forecast_slot(t - 1)) != 0) return -1;
+    }
+    forecast_ready = true;
+    forecast_generation++;
+    stats.forecasts++;
+    return 0;
+}
+
+// Helper private function to move the forecast on to play 'now' of the game, made again when
+// the game went another way (a rewind, a restored game, a ghost that met a pacman...)
+static int forecast_update(board_t* board) {
+    long now = board->wheel->now;
+    if (forecast_ready && now >= forecast_now && now - forecast_now <= horizon_max) {
+        for (; forecast_now < now; forecast_now++) {
+            first_slot = (first_slot + 1) % (horizon_max + 1);
+            if (forecast_step(forecast_slot(horizon_max), forecast_slot(horizon_max - 1)) != 0) return -1;
+        }
+        forecast_slot_t* slot = forecast_slot(0);
+        bool same = true;
+        for (int i = 0; i < board->n_ghosts && same; i++)
+            same = slot->cells[i].x == board->ghosts[i].pos_x && slot->cells[i].y == board->ghosts[i].pos_y;
+        if (same) return 0;
+    }
+    return forecast_rebuild(board);
+}
+
+// Helper private function: breadth-first walking distance from every cell to the goals
+static void fill_togo(board_t* board, bool to_portal) {
+    int width = board->width;
+    int head = 0, tail = 0;
+    for (long i = 0; i < togo_size; i++)
+        togo[i] = INT_MAX;
+    for (int y = 0; y < board->height; y++) {
+        for (int x = 0; x < width; x++) {
+            long index = board_index(board, x, y);
+            board_pos_t* pos = &board->board[index];
+            if (to_portal ? pos->has_portal : (pos->has_dot && !pos->has_portal && pos->content != 'W')) {
+                togo[index] = 0;
+                togo_queue[tail++] = y * width + x;
+            }
+        }
+    }
+
+    static const int dx[] = {0, 0, -1, 1}, dy[] = {-1, 1, 0, 0};
+    while (head < tail) {
+        int x = togo_queue[head] % width, y = togo_queue[head] / width;
+        head++;
+        int distance = togo[board_index(board, x, y)] + 1;
+        for (int d = 0; d < 4; d++) {
+            int nx = x + dx[d], ny = y + dy[d];
+            if (nx < 0 || nx >= width || ny < 0 || ny >= board->height) continue;
+            long index = board_index(board, nx, ny);
+            board_pos_t* pos = &board->board[index];
+            if (togo[index] != INT_MAX || pos->has_portal || pos->content == 'W') continue;
+            togo[index] = distance;
+            togo_queue[tail++] = ny * width + nx;
+        }
+    }
+}
+
+// Helper private function to make the distances again after dots were eaten, the goal becomes
+// the portal when no dot can be reached from (x, y). Returns whether the goal changed
+static bool update_togo(board_t* board, int x, int y) {
+    int points = total_points(board);
+    if (points == togo_points) return false;
+    togo_points = points;
+    stats.fields++;
+
+    bool was_portal = portal_mode;
+    fill_togo(board, false);
+    portal_mode = togo[board_index(board, x, y)] == INT_MAX;
+    if (portal_mode) fill_togo(board, true);
+    return portal_mode != was_portal;
+}
+
+// Helper private function to mark where the ghosts are in layers [from, to) of the window
+static void danger_job(int share, int shares) {
+    int from = (window.h + 1) * share / shares;
+    int to = (window.h + 1) * (share + 1) / shares;
+    // Tiles under the window
+    int tile_x0 = (window.x0 > 0 ? window.x0 : 0) >> TILE_SHIFT;
+    int tile_y0 = (window.y0 > 0 ? window.y0 : 0) >> TILE_SHIFT;
+    int tile_x1 = (window.x0 + window.side - 1 < shadow.width ? window.x0 + window.side - 1 : shadow.width - 1) >> TILE_SHIFT;
+    int tile_y1 = (window.y0 + window.side - 1 < shadow.height ? window.y0 + window.side - 1 : shadow.height - 1) >> TILE_SHIFT;
+    for (int t = from; t < to; t++) {
+        unsigned char* danger = window.danger + t * window.size;
+        memset(danger, 0, window.size);
+        forecast_slot_t* slot = forecast_slot(t);
+        for (int ty = tile_y0; ty <= tile_y1; ty++) {
+            for (int tx = tile_x0; tx <= tile_x1; tx++) {
+                long tile = (long)ty * shadow.tiles_x + tx;
+                for (int c = slot->tile_start[tile]; c < slot->tile_start[tile + 1]; c++) {
+                    int col = slot->by_tile[c].x - window.x0;
+                    int row = slot->by_tile[c].y - window.y0;
+                    if (col >= 0 && col < window.side && row >= 0 && row < window.side)
+                        danger[row * window.side + col] = 1;
+                }
+            }
+        }
+    }
+}
+
+// Helper private function: rows of the share of layer t, only the cells the pacman can have reached in t plays are visited
+static inline void share_rows(int t, int share, int shares, int* row_from, int* row_to) {
+    int rows = 2 * t + 1;
+    *row_from = window.h + 1 - t + rows * share / shares;
+    *row_to = window.h + 1 - t + rows * (share + 1) / shares;
+}
+
+// Helper private function to fill a share of the rows of layer window.t from layer t - 1
+static void forward_job(int share, int shares) {
+    int t = window.t, side = window.side, center = window.h + 1;
+    int row_from, row_to;
+    share_rows(t, share, shares, &row_from, &row_to);
+    const unsigned char* danger = window.danger + t * window.size;
+    const unsigned char* danger_before = danger - window.size;
+    const unsigned char* before = window.reached + (t - 1) * window.size;
+    unsigned char* reached = window.reached + t * window.size;
+
+    int count = 0;
+    for (int row = row_from; row < row_to; row++) {
+        int half = t - abs(row - center); // cells at most t moves away from the center
+        for (int col = center - half; col <= center + half; col++) {
+            int w = row * side + col;
+            char command = 0;
+            if (!(window.flags[w] & CELL_BLOCKED) && !danger[w]) {
+                if (before[w])
+                    command = 'T'; // stays: a ghost moving into the cell is already in danger
+                else if (window.can_move[t] && !danger_before[w]) {
+                    // The pacman moves first: it cannot walk into a ghost that is still there
+                    if (before[w + side]) command = 'W';
+                    else if (before[w - side]) command = 'S';
+                    else if (before[w + 1]) command = 'A';
+                    else if (before[w - 1]) command = 'D';
+                }
+            }
+            reached[w] = command;
+            count += command != 0;
+        }
+    }
+    share_count[share] = count;
+}
+
+// Helper private function to mark, in a share of the rows of layer window.t, the cells from which
+// the pacman can still get to the last layer reached, and find the first goal among them
+static void backward_job(int share, int shares) {
+    int t = window.t, side = window.side, center = window.h + 1;
+    int row_from, row_to;
+    share_rows(t, share, shares, &row_from, &row_to);
+    const unsigned char* danger = window.danger + t * window.size;
+    const unsigned char* after = window.reached + (t + 1) * window.size;
+    unsigned char* reached = window.reached + t * window.size;
+    bool last = t == window.last;
+
+    int goal = -1;
+    for (int row = row_from; row < row_to; row++) {
+        int half = t - abs(row - center); // cells at most t moves away from the center
+        for (int col = center - half; col <= center + half; col++) {
+            int w = row * side + col;
+            if (!reached[w]) continue;
+            bool viable = last || (after[w] & REACHED_VIABLE);
+            if (!viable && window.can_move[t + 1]) {
+                // A move is possible wherever the next cell is reached, unless a ghost is still in it
+                viable = ((after[w - side] & REACHED_VIABLE) && !danger[w - side]) ||
+                         ((after[w + side] & REACHED_VIABLE) && !danger[w + side]) ||
+                         ((after[w - 1] & REACHED_VIABLE) && !danger[w - 1]) ||
+                         ((after[w + 1] & REACHED_VIABLE) && !danger[w + 1]);
+            }
+            if (!viable) continue;
+            reached[w] |= REACHED_VIABLE;
+            if (goal < 0 && (window.flags[w] & CELL_GOAL)) goal = w;
+        }
+    }
+    share_goal[share] = goal;
+}
+
+// Helper private function to run a layer job, split between the threads when the layer is large
+// Returns the number of shares it was split in
+static int run_layer(void (*job)(int share, int shares), int t) {
+    window.t = t;
+    bool parallel = (long)(2 * t + 1) * (2 * t + 1) >= AUTOPILOT_MIN_PARALLEL_CELLS;
+    pool_run(job, parallel);
+    return (parallel && n_workers > 0) ? n_workers + 1 : 1;
+}
+
+// Helper private function to fill the flags of the window around (x, y)
+static void fill_window(board_t* board, int pacman_index, int x, int y) {
+    int center = window.h + 1;
+    window.x0 = x - center;
+    window.y0 = y - center;
+    for (int row = 0; row < window.side; row++) {
+        int by = window.y0 + row;
+        for (int col = 0; col < window.side; col++) {
+            int bx = window.x0 + col;
+            unsigned char flags = CELL_BLOCKED;
+            if (bx >= 0 && bx < board->width && by >= 0 && by < board->height) {
+                board_pos_t* pos = &board->board[board_index(board, bx, by)];
+                if (pos->has_portal) flags = portal_mode ? CELL_GOAL : CELL_BLOCKED;
+                else if (pos->content == 'W') flags = CELL_BLOCKED;
+                else flags = (pos->has_dot && !portal_mode) ? CELL_GOAL : 0;
+            }
+            window.flags[row * window.side + col] = flags;
+        }
+    }
+    window.flags[center * window.side + center] &= ~CELL_GOAL; // staying does not eat a dot
+    // The other pacmans are in the way, wherever they go
+    for (int p = 0; p < board->n_pacmans; p++) {
+        pacman_t* pac = &board->pacmans[p];
+        int col = pac->pos_x - window.x0, row = pac->pos_y - window.y0;
+        if (p != pacman_index && pac->alive && col >= 0 && col < window.side && row >= 0 && row < window.side)
+            window.flags[row * window.side + col] = CELL_BLOCKED;
+    }
+}
+
+// Helper private function: layers of the search from the pacman in the center of the window
+// Every layer is searched forward, then walked back to keep only the cells from which the pacman
+// can still get to the last layer reached: a goal right before a ghost sweeps it is no goal.
+// Returns the play of the first goal, or -(last play reached) when there is none (*end is its cell)
+static int search_layers(int passo, int waiting, int* end) {
+    int center = window.h + 1;
+    for (int t = 1; t <= window.h + 1; t++)
+        window.can_move[t] = t - 1 >= waiting && (t - 1 - waiting) % (passo + 1) == 0;
+    if (window.cleared_side != window.side) {
+        // Each layer only ever writes the cells at most t moves from the center,
+        // the others stay zero until the horizon (and so the window) changes
+        memset(window.reached, 0, (window.h + 1) * window.size);
+        window.cleared_side = window.side;
+    }
+    window.reached[center * window.side + center] = 'T';
+
+    window.last = 0;
+    for (int t = 1; t <= window.h; t++) {
+        int shares = run_layer(forward_job, t);
+        int count = 0;
+        for (int s = 0; s < shares; s++)
+            count += share_count[s];
+        if (count == 0) break; // every way meets a ghost
+        window.last = t;
+    }
+
+    int goal_t = 0;
+    *end = center * window.side + center;
+    for (int t = window.last; t >= 1; t--) {
+        int shares = run_layer(backward_job, t);
+        for (int s = 0; s < shares; s++) {
+            if (share_goal[s] >= 0) {
+                goal_t = t;
+                *end = share_goal[s];
+                break;
+            }
+        }
+    }
+    return goal_t > 0 ? goal_t : -window.last;
+}
+
+// Helper private function to choose, in the last play reached, the cell closest to a goal
+static int closest_cell(board_t* board, int t) {
+    const unsigned char* reached = window.reached + t * window.size;
+    int best = -1, best_togo = INT_MAX;
+    for (long w = 0; w < window.size; w++) {
+        if (!reached[w]) continue;
+        int x = window.x0 + (int)(w % window.side), y = window.y0 + (int)(w / window.side);
+        int distance = togo[board_index(board, x, y)];
+        if (best < 0 || distance < best_togo) {
+            best = (int)w;
+            best_togo = distance;
+        }
+    }
+    return best;
+}
+
+// Helper private function to search a route for the pacman from (x, y), kept in route_*
+static void search_route(board_t* board, int pacman_index, int x, int y, int waiting) {
+    pacman_t* pac = &board->pacmans[pacman_index];
+    double start = now_ms();
+
+    window.h = horizon;
+    window.side = 2 * horizon + 3;
+    window.size = (long)window.side * window.side;
+    fill_window(board, pacman_index, x, y);
+    pool_run(danger_job, board->n_ghosts * (long)(horizon + 1) >= AUTOPILOT_MIN_PARALLEL_CELLS);
+
+    int end;
+    int t = search_layers(pac->passo, waiting, &end);
+    if (t <= 0 && update_togo(board, x, y)) {
+        // Every dot that could be reached is eaten: the portal is the goal from now on
+        fill_window(board, pacman_index, x, y);
+        t = search_layers(pac->passo, waiting, &end);
+    }
+    route_to_goal = t > 0;
+    if (t < 0) {
+        t = -t;
+        end = closest_cell(board, t);
+    }
+
+    route_length = t;
+    route_from = (forecast_cell_t){x, y};
+    route_now = board->wheel->now;
+    route_generation = forecast_generation;
+    for (int play = t; play > 0; play--) {
+        char command = (char)(window.reached[play * window.size + end] & ~REACHED_VIABLE);
+        route_commands[play - 1] = command;
+        route_cells[play - 1] = (forecast_cell_t){window.x0 + end % window.side, window.y0 + end / window.side};
+        switch (command) {
+            case 'W': end += window.side; break;
+            case 'S': end -= window.side; break;
+            case 'A': end += 1; break;
+            case 'D': end -= 1; break;
+        }
+    }
+
+    // The horizon is cut when a search takes more than half of a play, and grows back when it is fast
+    // (with TEMPO 0 there is no play to fit in: the whole horizon is searched, the same on every machine)
+    double elapsed = now_ms() - start;
+    double budget = board->tempo / 2.0;
+    if (board->tempo > 0 && elapsed > budget && horizon > AUTOPILOT_MIN_HORIZON)
+        horizon = (horizon * 3 / 4 > AUTOPILOT_MIN_HORIZON) ? horizon * 3 / 4 : AUTOPILOT_MIN_HORIZON;
+    else if ((board->tempo == 0 || elapsed < budget / 4) && horizon < horizon_max)
+        horizon = (horizon + 4 < horizon_max) ? horizon + 4 : horizon_max;
+
+    stats.searches++;
+    stats.search_ms += elapsed;
+    if (elapsed > stats.max_search_ms) stats.max_search_ms = elapsed;
+}
+
+// Helper private function: the route can still be followed in play 'played' of it
+static bool route_usable(board_t* board, long played, int x, int y) {
+    if (route_generation != forecast_generation || played < 0 || played >= route_length) return false;
+    forecast_cell_t at = played == 0 ? route_from : route_cells[played - 1];
+    if (at.x != x || at.y != y) return false;
+
+    if (!route_to_goal) return route_length - played >= horizon / 2; // time to look further
+    forecast_cell_t goal = route_cells[route_length - 1];
+    board_pos_t* pos = &board->board[board_index(board, goal.x, goal.y)];
+    return portal_mode ? pos->has_portal : pos->has_dot; // not eaten by another pacman
+}
+
+// Helper private function to write the counters of the level to the debug file
+static void report() {
+    if (stats.plays == 0) return;
+    debug("AUTOPILOT %s: %lu plays, %lu searches (%.3f ms average, %.3f ms max), %lu plays on a kept route, "
+          "%lu forecasts, %lu distance maps, horizon %d of %d, %d threads\n",
+          stats.level_name, stats.plays, stats.searches,
+          stats.searches ? stats.search_ms / stats.searches : 0.0, stats.max_search_ms, stats.kept,
+          stats.forecasts, stats.fields, horizon, horizon_max, n_workers + 1);
+}
+
+static void free_buffers() {
+    free_shadow();
+    for (int s = 0; s <= AUTOPILOT_MAX_HORIZON; s++) {
+        mem_free(MEM_AUTOPILOT, slots[s].cells);
+        mem_free(MEM_AUTOPILOT, slots[s].by_tile);
+        mem_free(MEM_AUTOPILOT, slots[s].tile_start);
+        slots[s] = (forecast_slot_t){NULL, NULL, NULL, 0, 0};
+    }
+    mem_free(MEM_AUTOPILOT, togo);
+    mem_free(MEM_AUTOPILOT, togo_queue);
+    mem_free(MEM_AUTOPILOT, window.flags);
+    mem_free(MEM_AUTOPILOT, window.danger);
+    mem_free(MEM_AUTOPILOT, window.reached);
+    togo = NULL;
+    togo_queue = NULL;
+    window.flags = window.danger = NULL;
+    window.reached = NULL;
+}
+
+int autopilot_reset(board_t* board) {
+    report();
+    free_buffers();
+    memset(&stats, 0, sizeof(stats));
+    snprintf(stats.level_name, sizeof(stats.level_name), "%s", board->level_name);
+    route_length = 0;
+    togo_points = -1;
+    portal_mode = false;
+
+    // The copy of the ghosts and the distances need the whole board in memory
+    togo_size = board_storage_cells(board->width, board->height);
+    n_tiles = togo_size / TILE_CELLS;
+    if (board->stream || togo_size > AUTOPILOT_MAX_CELLS) {
+        debug("AUTOPILOT off for %s: the board is too large to be copied\n", board->level_name);
+        return -1;
+    }
+
+    horizon_max = AUTOPILOT_FORECAST_CELLS / (board->n_ghosts > 0 ? board->n_ghosts : 1);
+    if (horizon_max > AUTOPILOT_MAX_HORIZON) horizon_max = AUTOPILOT_MAX_HORIZON;
+    if (horizon_max < AUTOPILOT_MIN_HORIZON) horizon_max = AUTOPILOT_MIN_HORIZON;
+    horizon = horizon_max;
+
+    long side = 2 * horizon_max + 3;
+    togo = mem_malloc(MEM_AUTOPILOT, togo_size * sizeof(int));
+    togo_queue = mem_malloc(MEM_AUTOPILOT, (size_t)board->width * board->height * sizeof(int));
+    window.flags = mem_malloc(MEM_AUTOPILOT, side * side);
+    window.danger = mem_malloc(MEM_AUTOPILOT, (horizon_max + 1) * side * side);
+    window.reached = mem_malloc(MEM_AUTOPILOT, (horizon_max + 1) * side * side);
+    window.cleared_side = 0;
+    if (!togo || !togo_queue || !window.flags || !window.danger || !window.reached) {
+        debug("Error: Could not allocate the autopilot for %s\n", board->level_name);
+        free_buffers();
+        return -1;
+    }
+
+    pool_start_workers();
+    return forecast_rebuild(board);
+}
+
+char autopilot_next(board_t* board) {
+    if (!window.reached || forecast_update(board) != 0) return 'T';
+    stats.plays++;
+
+    // The pacmans without a script all play the same command: it is chosen for the first of them
+    int pacman_index = -1;
+    for (int p = 0; p < board->n_pacmans && pacman_index < 0; p++) {
+        pacman_t* pac = &board->pacmans[p];
+        if (pac->n_moves == 0 && (pac->alive || pac->lives > 0)) pacman_index = p;
+    }
+    if (pacman_index < 0) return 'T';
+
+    // A dead pacman comes back on its start cell in the next play, and waits its passo from there
+    pacman_t* pac = &board->pacmans[pacman_index];
+    int x = pac->alive ? pac->pos_x : pac->start_x;
+    int y = pac->alive ? pac->pos_y : pac->start_y;
+    int waiting = pac->alive ? pac->waiting : pac->passo;
+
+    long played = board->wheel->now - route_now;
+    if (route_usable(board, played, x, y)) {
+        stats.kept++;
+    } else {
+        search_route(board, pacman_index, x, y, waiting);
+        played = 0;
+    }
+    return route_length > 0 ? route_commands[played] : 'T';
+}
+
+void autopilot_free() {
+    report();
+    memset(&stats, 0, sizeof(stats));
+    free_buffers();
+    pool_stop();
+}
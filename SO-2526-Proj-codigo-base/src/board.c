@@ -1,37 +1,17 @@
+#define _DEFAULT_SOURCE // MAP_ANONYMOUS, MAP_NORESERVE and MADV_DONTNEED
 #include "board.h"
+#include "timeline.h"
+#include "memstats.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <time.h>
 #include <unistd.h>
 #include <stdarg.h>
 #include <string.h>
+#include <sys/mman.h>
 
-void copy_board_state(board_t *dst, board_t *src) {
-    dst->width = src->width;
-    dst->height = src->height;
-    int total = src->width * src->height;
-    dst->board = malloc(sizeof(char) * total);
-    if (!dst->board) exit(1);
-    memcpy(dst->board, src->board, sizeof(char) * total);
-}
-
-void restore_board_state(board_t *dst, board_t *src) {
-    dst->width = src->width;
-    dst->height = src->height;
-    int total = src->width * src->height;
-    if (!dst->board)
-        dst->board = malloc(sizeof(char) * total);
-    memcpy(dst->board, src->board, sizeof(char) * total);
-}
-
-void free_board_backup(board_t *board) {
-    if (board->board) {
-        free(board->board);
-        board->board = NULL;
-    }
-}
-
-FILE * debugfile;
+FILE * debugfile = NULL;
 
 // Helper private function to find and kill pacman at specific position
 static int find_and_kill_pacman(board_t* board, int new_x, int new_y) {
@@ -46,9 +26,10 @@ static int find_and_kill_pacman(board_t* board, int new_x, int new_y) {
     return VALID_MOVE;
 }
 
-// Helper private function for getting board position index
-static inline int get_board_index(board_t* board, int x, int y) {
-    return y * board->width + x;
+// Helper private function for getting board position index, the tile is brought in on streamed worlds
+static inline long get_board_index(board_t* board, int x, int y) {
+    board_touch(board, x, y);
+    return board_index(board, x, y);
 }
 
 // Helper private function for checking valid position
@@ -63,14 +44,220 @@ void sleep_ms(int milliseconds) {
     nanosleep(&ts, NULL);
 }
 
-int move_pacman(board_t* board, int pacman_index, command_t* command) {
-    if (pacman_index < 0 || !board->pacmans[pacman_index].alive) {
-        return DEAD_PACMAN; // Invalid or dead pacman
+double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+// Tile states of a streamed world
+#define TILE_NEW 0        // never used, its cells are generated on the first touch
+#define TILE_RESIDENT 1
+#define TILE_EVICTED 2    // dropped from memory, read back from the file on the next touch
+
+// Generated worlds: corridors every STREAM_CORRIDOR rows and columns keep every part reachable
+#define STREAM_CORRIDOR 8
+#define STREAM_WALL_PERCENT 12
+
+struct board_stream {
+    int fd;                     // unlinked temporary file holding the cells
+    unsigned int seed;
+    unsigned int plays;         // plays since the world was mapped
+    long n_tiles;
+    unsigned char* state;       // TILE_* of every tile
+    unsigned int* last_used;    // play of the last touch of every tile
+    long* resident;             // tiles in memory, in no particular order
+    long n_resident, resident_capacity;
+    long generated;
+};
+
+long board_storage_cells(int width, int height) {
+    long tiles_x = ((long)width + TILE_SIDE - 1) >> TILE_SHIFT;
+    long tiles_y = ((long)height + TILE_SIDE - 1) >> TILE_SHIFT;
+    if (tiles_x < 1) tiles_x = 1;
+    if (tiles_y < 1) tiles_y = 1;
+    return tiles_x * tiles_y * TILE_CELLS;
+}
+
+// Helper private function to map the cells of the board from 'fd', or anonymous ones when it is -1
+static int map_cells(board_t* board, int fd) {
+    size_t size = board_storage_cells(board->width, board->height) * sizeof(board_pos_t);
+    int flags = (fd < 0) ? MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE : MAP_SHARED;
+    board->stream = NULL;
+    board->tiles_x = (board->width + TILE_SIDE - 1) >> TILE_SHIFT;
+    board->board = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, fd, 0);
+    if (board->board == MAP_FAILED) {
+        debug("Error: Could not map %zu bytes of cells\n", size);
+        board->board = NULL;
+        return -1;
     }
+    mem_mapped(MEM_LEVEL, (long)size);
+    return 0;
+}
 
-    pacman_t* pac = &board->pacmans[pacman_index];
-    int new_x = pac->pos_x;
-    int new_y = pac->pos_y;
+// Helper private function for zeroed memory only backed where it is used, NULL on error
+// (calloc would clear it all when the allocator reuses its own memory)
+static void* map_zeroed(size_t size) {
+    void* ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (ptr == MAP_FAILED) return NULL;
+    mem_mapped(MEM_LEVEL, (long)size);
+    return ptr;
+}
+
+int board_alloc_cells(board_t* board) {
+    return map_cells(board, -1);
+}
+
+int board_stream_cells(board_t* board, unsigned int seed) {
+    const char* dir = getenv("TMPDIR");
+    char path[MAX_FILENAME];
+    snprintf(path, sizeof(path), "%s/pacmanist-world-XXXXXX", (dir && dir[0]) ? dir : "/var/tmp");
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        debug("Error: Could not create the world file %s\n", path);
+        return -1;
+    }
+    unlink(path); // gone with the last reference, even after a crash
+
+    long n_tiles = board_storage_cells(board->width, board->height) / TILE_CELLS;
+    struct board_stream* stream = mem_calloc(MEM_LEVEL, 1, sizeof(struct board_stream));
+    if (!stream || ftruncate(fd, n_tiles * TILE_CELLS * (off_t)sizeof(board_pos_t)) != 0 || map_cells(board, fd) != 0) {
+        debug("Error: Could not map a world of %d x %d\n", board->width, board->height);
+        mem_free(MEM_LEVEL, stream);
+        close(fd);
+        return -1;
+    }
+    stream->fd = fd;
+    stream->seed = seed;
+    stream->n_tiles = n_tiles;
+    stream->state = map_zeroed(n_tiles * sizeof(unsigned char));
+    stream->last_used = map_zeroed(n_tiles * sizeof(unsigned int));
+    board->stream = stream;
+    if (!stream->state || !stream->last_used) {
+        board_free_cells(board);
+        return -1;
+    }
+
+    debug("WORLD %d x %d (seed %u): %ld tiles of %d x %d cells in %s\n",
+          board->width, board->height, seed, n_tiles, TILE_SIDE, TILE_SIDE, (dir && dir[0]) ? dir : "/var/tmp");
+    return 0;
+}
+
+// Helper private function to unmap 'size' bytes counted by mem_mapped
+static void unmap_counted(void* ptr, size_t size) {
+    munmap(ptr, size);
+    mem_mapped(MEM_LEVEL, -(long)size);
+}
+
+void board_free_cells(board_t* board) {
+    if (board->board)
+        unmap_counted(board->board, board_storage_cells(board->width, board->height) * sizeof(board_pos_t));
+    if (board->stream) {
+        close(board->stream->fd);
+        if (board->stream->state) unmap_counted(board->stream->state, board->stream->n_tiles * sizeof(unsigned char));
+        if (board->stream->last_used) unmap_counted(board->stream->last_used, board->stream->n_tiles * sizeof(unsigned int));
+        mem_free(MEM_LEVEL, board->stream->resident);
+        mem_free(MEM_LEVEL, board->stream);
+    }
+    board->board = NULL;
+    board->stream = NULL;
+}
+
+void board_drop_tiles(board_t* board, long first_tile, long n_tiles) {
+    uintptr_t page = sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t)&board->board[first_tile * TILE_CELLS];
+    uintptr_t end = start + n_tiles * TILE_CELLS * sizeof(board_pos_t);
+    start = (start + page - 1) & ~(page - 1); // pages shared with the neighbours are kept
+    end &= ~(page - 1);
+    if (end > start) madvise((void*)start, end - start, MADV_DONTNEED);
+}
+
+// Helper private function: hash of a cell of a generated world
+static inline unsigned int cell_hash(unsigned int seed, int x, int y) {
+    uint64_t h = ((uint64_t)(unsigned int)x << 32 | (unsigned int)y) ^ (seed * 0x9E3779B97F4A7C15ULL);
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return (unsigned int)h;
+}
+
+// Helper private function to fill a tile of a streamed world the first time it is used
+static void generate_tile(board_t* board, long tile) {
+    unsigned int seed = board->stream->seed;
+    int x0 = (int)(tile % board->tiles_x) << TILE_SHIFT;
+    int y0 = (int)(tile / board->tiles_x) << TILE_SHIFT;
+    board_pos_t* cells = &board->board[tile * TILE_CELLS];
+
+    for (int dy = 0; dy < TILE_SIDE; dy++) {
+        for (int dx = 0; dx < TILE_SIDE; dx++) {
+            int x = x0 + dx, y = y0 + dy;
+            board_pos_t* pos = &cells[(dy << TILE_SHIFT) | dx];
+            if (x >= board->width - 1 || y >= board->height - 1 || x == 0 || y == 0)
+                *pos = (board_pos_t){'W', 0, 0}; // outer wall and the cells past it
+            else if (x == board->width - 2 && y == board->height - 2)
+                *pos = (board_pos_t){' ', 0, 1};
+            else if (x % STREAM_CORRIDOR != 1 && y % STREAM_CORRIDOR != 1 &&
+                     cell_hash(seed, x, y) % 100 < STREAM_WALL_PERCENT)
+                *pos = (board_pos_t){'W', 0, 0};
+            else
+                *pos = (board_pos_t){' ', 1, 0};
+        }
+    }
+}
+
+void stream_touch(board_t* board, int x, int y) {
+    struct board_stream* stream = board->stream;
+    long tile = (long)(y >> TILE_SHIFT) * board->tiles_x + (x >> TILE_SHIFT);
+    stream->last_used[tile] = stream->plays;
+    if (stream->state[tile] == TILE_RESIDENT) return;
+
+    if (stream->n_resident == stream->resident_capacity) {
+        stream->resident_capacity = stream->resident_capacity ? stream->resident_capacity * 2 : 64;
+        stream->resident = mem_realloc(MEM_LEVEL, stream->resident, stream->resident_capacity * sizeof(long));
+        if (!stream->resident) exit(1);
+    }
+    if (stream->state[tile] == TILE_NEW) {
+        generate_tile(board, tile);
+        stream->generated++;
+    }
+    stream->state[tile] = TILE_RESIDENT;
+    stream->resident[stream->n_resident++] = tile;
+}
+
+void stream_stats(board_t* board, long* generated, long* resident) {
+    *generated = board->stream ? board->stream->generated : 0;
+    *resident = board->stream ? board->stream->n_resident : 0;
+}
+
+// Helper private function to count a play and drop the tiles left idle, every STREAM_EVICT_INTERVAL plays
+// Evicted cells stay in the file, only the memory they were using is given back
+static void stream_tick(board_t* board) {
+    struct board_stream* stream = board->stream;
+    stream->plays++;
+    if (stream->plays % STREAM_EVICT_INTERVAL != 0) return;
+
+    for (long r = 0; r < stream->n_resident;) {
+        long tile = stream->resident[r];
+        if (stream->plays - stream->last_used[tile] <= STREAM_IDLE_PLAYS) {
+            r++;
+            continue;
+        }
+        board_drop_tiles(board, tile, 1);
+        stream->state[tile] = TILE_EVICTED;
+        stream->resident[r] = stream->resident[--stream->n_resident];
+    }
+}
+
+// Internal result of plan_pacman_move: the pacman wants to enter (new_x, new_y)
+#define PLANNED_MOVE 2
+
+// Helper private function that consumes the pacman's command and decides its target cell
+// Returns PLANNED_MOVE with the target, or the final result when the pacman does not move
+static int plan_pacman_move(board_t* board, pacman_t* pac, command_t* command, int* new_x, int* new_y) {
+    *new_x = pac->pos_x;
+    *new_y = pac->pos_y;
 
     // check passo
     if (pac->waiting > 0) {
@@ -83,22 +270,22 @@ int move_pacman(board_t* board, int pacman_index, command_t* command) {
 
     if (direction == 'R') {
         char directions[] = {'W', 'S', 'A', 'D'};
-        direction = directions[rand() % 4];
+        direction = directions[rand_r(&board->rng_state) % 4];
     }
 
     // Calculate new position based on direction
     switch (direction) {
         case 'W': // Up
-            new_y--;
+            (*new_y)--;
             break;
         case 'S': // Down
-            new_y++;
+            (*new_y)++;
             break;
         case 'A': // Left
-            new_x--;
+            (*new_x)--;
             break;
         case 'D': // Right
-            new_x++;
+            (*new_x)++;
             break;
         case 'T': // Wait
             if (command->turns_left == 1) {
@@ -115,28 +302,43 @@ int move_pacman(board_t* board, int pacman_index, command_t* command) {
     pac->current_move+=1;
 
     // Check boundaries
-    if (!is_valid_position(board, new_x, new_y)) {
+    if (!is_valid_position(board, *new_x, *new_y)) {
+        return INVALID_MOVE;
+    }
+
+    // Check for walls (a portal is never on a wall)
+    long new_index = get_board_index(board, *new_x, *new_y);
+    if (board->board[new_index].content == 'W' && !board->board[new_index].has_portal) {
         return INVALID_MOVE;
     }
 
-    int new_index = get_board_index(board, new_x, new_y);
-    int old_index = get_board_index(board, pac->pos_x, pac->pos_y);
+    return PLANNED_MOVE;
+}
+
+// Helper private function for a pacman losing a life, its cell must already be cleared
+static void lose_life(board_t* board, int pacman_index) {
+    pacman_t* pac = &board->pacmans[pacman_index];
+    pac->alive = 0;
+    if (pac->lives > 0)
+        pac->lives--;
+}
+
+// Helper private function that moves the pacman into its planned cell
+// The pacman's old cell must already be cleared
+static int apply_pacman_move(board_t* board, int pacman_index, int new_x, int new_y) {
+    pacman_t* pac = &board->pacmans[pacman_index];
+    long new_index = get_board_index(board, new_x, new_y);
     char target_content = board->board[new_index].content;
 
     if (board->board[new_index].has_portal) {
-        board->board[old_index].content = ' ';
         board->board[new_index].content = 'P';
         return REACHED_PORTAL;
     }
 
-    // Check for walls
-    if (target_content == 'W') {
-        return INVALID_MOVE;
-    }
-
     // Check for ghosts
     if (target_content == 'M') {
-        kill_pacman(board, pacman_index);
+        debug("Killing %d pacman\n\n", pacman_index);
+        lose_life(board, pacman_index);
         return DEAD_PACMAN;
     }
 
@@ -146,7 +348,6 @@ int move_pacman(board_t* board, int pacman_index, command_t* command) {
         board->board[new_index].has_dot = 0;
     }
 
-    board->board[old_index].content = ' ';
     pac->pos_x = new_x;
     pac->pos_y = new_y;
     board->board[new_index].content = 'P';
@@ -154,6 +355,192 @@ int move_pacman(board_t* board, int pacman_index, command_t* command) {
     return VALID_MOVE;
 }
 
+int move_pacman(board_t* board, int pacman_index, command_t* command) {
+    if (pacman_index < 0 || !board->pacmans[pacman_index].alive) {
+        return DEAD_PACMAN; // Invalid or dead pacman
+    }
+
+    pacman_t* pac = &board->pacmans[pacman_index];
+    int new_x, new_y;
+    int result = plan_pacman_move(board, pac, command, &new_x, &new_y);
+    if (result != PLANNED_MOVE)
+        return result;
+
+    // Another pacman blocks the way
+    if (board->board[get_board_index(board, new_x, new_y)].content == 'P')
+        return INVALID_MOVE;
+
+    board->board[get_board_index(board, pac->pos_x, pac->pos_y)].content = ' ';
+    return apply_pacman_move(board, pacman_index, new_x, new_y);
+}
+
+// Helper private function to bring back a dead pacman with lives left to its start cell
+static void respawn_pacman(board_t* board, pacman_t* pac) {
+    long index = get_board_index(board, pac->start_x, pac->start_y);
+    if (board->board[index].content != ' ') return; // occupied, try again on the next play
+
+    pac->pos_x = pac->start_x;
+    pac->pos_y = pac->start_y;
+    pac->alive = 1;
+    pac->waiting = pac->passo;
+    board->board[index].content = 'P';
+}
+
+// Pacman move being resolved by move_pacmans
+typedef struct {
+    int pacman;     // index in board->pacmans
+    long from;      // current board index
+    long want;      // planned board index, -1 if it does not try to move
+    long to;        // resolved board index, -1 if it stays in place
+    int want_x, want_y; // planned position
+} pacman_plan_t;
+
+static int compare_plan_want(const void* a, const void* b) {
+    const pacman_plan_t* pa = *(const pacman_plan_t* const*)a;
+    const pacman_plan_t* pb = *(const pacman_plan_t* const*)b;
+    if (pa->want != pb->want) return (pa->want < pb->want) ? -1 : 1;
+    return pa->pacman - pb->pacman;
+}
+
+static int compare_plan_from(const void* a, const void* b) {
+    const pacman_plan_t* pa = *(const pacman_plan_t* const*)a;
+    const pacman_plan_t* pb = *(const pacman_plan_t* const*)b;
+    return (pa->from > pb->from) - (pa->from < pb->from);
+}
+
+// Helper private function to find the plan of the pacman standing on 'index'
+static pacman_plan_t* find_plan_from(pacman_plan_t** by_from, int n, long index) {
+    int lo = 0, hi = n - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (by_from[mid]->from == index) return by_from[mid];
+        if (by_from[mid]->from < index) lo = mid + 1;
+        else hi = mid - 1;
+    }
+    return NULL;
+}
+
+// Helper private function to find the pacman still moving into 'index'
+static pacman_plan_t* find_plan_to(pacman_plan_t** by_want, int n, long index) {
+    int lo = 0, hi = n;
+    while (lo < hi) { // first plan with want >= index
+        int mid = (lo + hi) / 2;
+        if (by_want[mid]->want < index) lo = mid + 1;
+        else hi = mid;
+    }
+    for (; lo < n && by_want[lo]->want == index; lo++) {
+        if (by_want[lo]->to == index) return by_want[lo];
+    }
+    return NULL;
+}
+
+// Helper private function behind move_pacmans and move_pacmans_each: the pacmans controlled by
+// the user play 'each[p]' when it is given, 'input' otherwise
+static int move_all_pacmans(board_t* board, command_t* input, command_t* each) {
+    int n = 0;
+    pacman_plan_t plans[MAX_PACMANS];
+    pacman_plan_t* by_want[MAX_PACMANS];
+    pacman_plan_t* by_from[MAX_PACMANS];
+    long blocked[MAX_PACMANS]; // worklist of cells of pacmans that stay in place, each pacman at most once
+
+    for (int p = 0; p < board->n_pacmans; p++) {
+        pacman_t* pac = &board->pacmans[p];
+        if (!pac->alive && pac->lives > 0) respawn_pacman(board, pac);
+    }
+
+    // 1. Every pacman decides its move from the same board
+    for (int p = 0; p < board->n_pacmans; p++) {
+        pacman_t* pac = &board->pacmans[p];
+        if (!pac->alive) continue;
+
+        command_t* command;
+        if (pac->n_moves > 0)
+            command = &pac->moves[pac->current_move % pac->n_moves];
+        else
+            command = each ? (each[p].command ? &each[p] : NULL) : input;
+        int new_x = pac->pos_x, new_y = pac->pos_y;
+        int planned = command ? plan_pacman_move(board, pac, command, &new_x, &new_y) : VALID_MOVE;
+
+        plans[n].pacman = p;
+        plans[n].from = get_board_index(board, pac->pos_x, pac->pos_y);
+        plans[n].want = (planned == PLANNED_MOVE) ? get_board_index(board, new_x, new_y) : -1;
+        plans[n].to = plans[n].want;
+        plans[n].want_x = new_x;
+        plans[n].want_y = new_y;
+        by_want[n] = by_from[n] = &plans[n];
+        n++;
+    }
+
+    qsort(by_want, n, sizeof(pacman_plan_t*), compare_plan_want);
+    qsort(by_from, n, sizeof(pacman_plan_t*), compare_plan_from);
+
+    // 2. Same target: the lowest index wins, the others stay in place
+    int n_blocked = 0;
+    for (int i = 0; i < n; i++) {
+        if (by_want[i]->want < 0 || (i > 0 && by_want[i - 1]->want == by_want[i]->want)) {
+            by_want[i]->to = -1;
+            blocked[n_blocked++] = by_want[i]->from;
+        }
+    }
+
+    // 3. Pacmans never swap places
+    for (int i = 0; i < n; i++) {
+        pacman_plan_t* plan = &plans[i];
+        if (plan->to < 0) continue;
+        pacman_plan_t* other = find_plan_from(by_from, n, plan->to);
+        if (other && other->to == plan->from) {
+            plan->to = other->to = -1;
+            blocked[n_blocked++] = plan->from;
+            blocked[n_blocked++] = other->from;
+        }
+    }
+
+    // 4. A pacman staying in place blocks whoever still moves into its cell, which may block another one
+    while (n_blocked > 0) {
+        long cell = blocked[--n_blocked];
+        pacman_plan_t* incoming = find_plan_to(by_want, n, cell);
+        if (incoming) {
+            incoming->to = -1;
+            blocked[n_blocked++] = incoming->from;
+        }
+    }
+
+    // 5. Apply: clear every old cell first so pacmans can follow each other
+    for (int i = 0; i < n; i++)
+        if (plans[i].to >= 0) board->board[plans[i].from].content = ' ';
+
+    // Every resolved move is made, the level only ends once they all are (the last frame shows them)
+    int result = VALID_MOVE;
+    for (int i = 0; i < n; i++) {
+        if (plans[i].to < 0) continue;
+        int move = apply_pacman_move(board, plans[i].pacman, plans[i].want_x, plans[i].want_y);
+        if (move == REACHED_PORTAL) result = REACHED_PORTAL;
+    }
+
+    if (result == REACHED_PORTAL) return REACHED_PORTAL;
+
+    for (int p = 0; p < board->n_pacmans; p++) {
+        if (board->pacmans[p].alive || board->pacmans[p].lives > 0)
+            return VALID_MOVE;
+    }
+    return DEAD_PACMAN;
+}
+
+int move_pacmans(board_t* board, command_t* input) {
+    return move_all_pacmans(board, input, NULL);
+}
+
+int move_pacmans_each(board_t* board, command_t* inputs) {
+    return move_all_pacmans(board, NULL, inputs);
+}
+
+int total_points(const board_t* board) {
+    int points = 0;
+    for (int p = 0; p < board->n_pacmans; p++)
+        points += board->pacmans[p].points;
+    return points;
+}
+
 // Helper private function for charged ghost movement in one direction
 static int move_ghost_charged_direction(board_t* board, ghost_t* ghost, char direction, int* new_x, int* new_y) {
     int x = ghost->pos_x;
@@ -247,8 +634,8 @@ int move_ghost_charged(board_t* board, int ghost_index, char direction) {
     }
 
     // Get board indices
-    int old_index = get_board_index(board, ghost->pos_x, ghost->pos_y);
-    int new_index = get_board_index(board, new_x, new_y);
+    long old_index = get_board_index(board, ghost->pos_x, ghost->pos_y);
+    long new_index = get_board_index(board, new_x, new_y);
 
     // Update board - clear old position (restore what was there)
     board->board[old_index].content = ' '; // Or restore the dot if ghost was on one
@@ -260,23 +647,19 @@ int move_ghost_charged(board_t* board, int ghost_index, char direction) {
     return result;
 }
 
-int move_ghost(board_t* board, int ghost_index, command_t* command) {
+// Helper private function that runs a ghost's command once its countdown has ended
+static int act_ghost(board_t* board, int ghost_index, command_t* command) {
     ghost_t* ghost = &board->ghosts[ghost_index];
     int new_x = ghost->pos_x;
     int new_y = ghost->pos_y;
 
-    // check passo
-    if (ghost->waiting > 0) {
-        ghost->waiting -= 1;
-        return VALID_MOVE;
-    }
-    ghost->waiting = ghost->passo;
+    board->ghost_waiting[ghost_index] = ghost->passo;
 
     char direction = command->command;
     
     if (direction == 'R') {
         char directions[] = {'W', 'S', 'A', 'D'};
-        direction = directions[rand() % 4];
+        direction = directions[rand_r(&board->rng_state) % 4];
     }
 
     // Calculate new position based on direction
@@ -319,8 +702,8 @@ int move_ghost(board_t* board, int ghost_index, command_t* command) {
     }
 
     // Check board position
-    int new_index = get_board_index(board, new_x, new_y);
-    int old_index = get_board_index(board, ghost->pos_x, ghost->pos_y);
+    long new_index = get_board_index(board, new_x, new_y);
+    long old_index = get_board_index(board, ghost->pos_x, ghost->pos_y);
     char target_content = board->board[new_index].content;
 
     // Check for walls and ghosts
@@ -346,24 +729,279 @@ int move_ghost(board_t* board, int ghost_index, command_t* command) {
     return result;
 }
 
+int move_ghost(board_t* board, int ghost_index, command_t* command) {
+    // check passo
+    if (board->ghost_waiting[ghost_index] > 0) {
+        board->ghost_waiting[ghost_index] -= 1;
+        return VALID_MOVE;
+    }
+    return act_ghost(board, ghost_index, command);
+}
+
+// Helper private function: a 'T' with turns left is skipped in one step by the wheel
+// (a 'T' without turns never ends, it is run as any other command)
+static inline command_t* waiting_command(ghost_t* ghost) {
+    command_t* command = &ghost->moves[ghost->current_move % ghost->n_moves];
+    return (command->command == 'T' && command->turns_left >= 1) ? command : NULL;
+}
+
+// Helper private function to put a ghost in the slot of the play where it acts next
+static inline void wheel_insert(ghost_wheel_t* wheel, int ghost_index) {
+    int slot = wheel->due[ghost_index] & (WHEEL_SLOTS - 1);
+    wheel->next[ghost_index] = wheel->heads[slot];
+    wheel->heads[slot] = ghost_index;
+}
+
+// Helper private function to build the wheel from the countdowns and the scripts
+static void build_wheel(board_t* board) {
+    ghost_wheel_t* wheel = board->wheel;
+    for (int s = 0; s < WHEEL_SLOTS; s++)
+        wheel->heads[s] = -1;
+
+    if (!wheel->lines_built) {
+        wheel->lines = timeline_build(board);
+        wheel->lines_built = 1;
+    }
+
+    // Every ghost acts when its countdown ends, a running 'T' is skipped from there
+    for (int i = 0; i < board->n_ghosts; i++) {
+        wheel->due[i] = wheel->now + board->ghost_waiting[i];
+        wheel->in_wait[i] = 0;
+        if (wheel->lines) wheel->lines[i].following = 0; // joins again at the start of its script
+        wheel_insert(wheel, i);
+    }
+    wheel->built = 1;
+}
+
+// Helper private function to write the countdown and the script cursor of a ghost following its timeline
+static void timeline_state(board_t* board, int ghost_index, ghost_timeline_t* line) {
+    ghost_t* ghost = &board->ghosts[ghost_index];
+    long now = board->wheel->now;
+    long period = ghost->passo + 1;
+    long steps = now <= line->start ? 0 : (now - line->start + period - 1) / period; // acts already played
+
+    int moves, turns_left;
+    timeline_cursor(ghost, line, steps, &moves, &turns_left);
+    for (int m = 0; m < ghost->n_moves; m++)
+        ghost->moves[m].turns_left = ghost->moves[m].turns;
+    ghost->current_move = line->base_move + moves;
+    ghost->moves[ghost->current_move % ghost->n_moves].turns_left = turns_left;
+    board->ghost_waiting[ghost_index] = line->start + steps * period - now;
+}
+
+// Helper private function to move a ghost along its timeline and put it on the wheel for its next move
+// A ghost that finds its next cell taken leaves the timeline and plays that act live
+static void follow_timeline(board_t* board, int ghost_index, ghost_timeline_t* line) {
+    ghost_wheel_t* wheel = board->wheel;
+    ghost_t* ghost = &board->ghosts[ghost_index];
+    long period = ghost->passo + 1;
+
+    while (line->n_events > 0) {
+        timeline_event_t* event = &line->events[line->event];
+        long due = line->start + (line->laps * line->period_steps + event->step) * period;
+        if (due > wheel->now) {
+            wheel->due[ghost_index] = due;
+            wheel_insert(wheel, ghost_index);
+            return;
+        }
+
+        long new_index = get_board_index(board, event->pos_x, event->pos_y);
+        if (board->board[new_index].content != ' ') {
+            timeline_state(board, ghost_index, line);
+            line->following = 0;
+            act_ghost(board, ghost_index, &ghost->moves[ghost->current_move % ghost->n_moves]);
+            wheel->due[ghost_index] = wheel->now + period;
+            wheel_insert(wheel, ghost_index);
+            return;
+        }
+        board->board[get_board_index(board, ghost->pos_x, ghost->pos_y)].content = ' ';
+        ghost->pos_x = event->pos_x;
+        ghost->pos_y = event->pos_y;
+        board->board[new_index].content = 'M';
+
+        if (++line->event == line->n_events) {
+            line->event = 0;
+            line->laps++;
+        }
+    }
+    // A timeline without moves: the ghost stays off the wheel
+}
+
+// Helper private function: a live ghost joins its timeline at the start of its script, on its origin
+static int can_join(ghost_t* ghost, ghost_timeline_t* line) {
+    return line && line->events && ghost->current_move % ghost->n_moves == 0 &&
+           ghost->moves[0].turns_left == ghost->moves[0].turns &&
+           ghost->pos_x == line->origin_x && ghost->pos_y == line->origin_y;
+}
+
+static int compare_index(const void* a, const void* b) {
+    return *(const int*)a - *(const int*)b;
+}
+
+void move_ghosts(board_t* board) {
+    ghost_wheel_t* wheel = board->wheel;
+    if (!wheel->built) build_wheel(board);
+
+    // Take the ghosts due now out of the slot, the others are a lap (or more) ahead
+    int n_acting = 0;
+    int* link = &wheel->heads[wheel->now & (WHEEL_SLOTS - 1)];
+    while (*link >= 0) {
+        int i = *link;
+        if (wheel->due[i] == wheel->now) {
+            *link = wheel->next[i];
+            wheel->acting[n_acting++] = i;
+        } else {
+            link = &wheel->next[i];
+        }
+    }
+
+    // Moves touch the shared board, so they keep the original order: a sort when few
+    // ghosts act, a pass over the marks of every ghost when most of them do
+    if (n_acting > board->n_ghosts / 16) {
+        for (int a = 0; a < n_acting; a++)
+            wheel->marked[wheel->acting[a]] = 1;
+        n_acting = 0;
+        for (int i = 0; i < board->n_ghosts; i++) {
+            if (!wheel->marked[i]) continue;
+            wheel->marked[i] = 0;
+            wheel->acting[n_acting++] = i;
+        }
+    } else {
+        qsort(wheel->acting, n_acting, sizeof(int), compare_index);
+    }
+
+    for (int a = 0; a < n_acting; a++) {
+        int i = wheel->acting[a];
+        ghost_t* ghost = &board->ghosts[i];
+        long period = ghost->passo + 1;
+        ghost_timeline_t* line = wheel->lines ? &wheel->lines[i] : NULL;
+
+        if (line && line->following) {
+            follow_timeline(board, i, line);
+            continue;
+        }
+
+        if (wheel->in_wait[i]) {
+            // The wait ended: move on as its last turn would have done
+            command_t* wait = &ghost->moves[ghost->current_move % ghost->n_moves];
+            wait->turns_left = wait->turns;
+            ghost->current_move += 1;
+            wheel->in_wait[i] = 0;
+        }
+
+        if (can_join(ghost, line)) {
+            line->following = 1;
+            line->event = 0;
+            line->laps = 0;
+            line->start = wheel->now;
+            line->base_move = ghost->current_move;
+            follow_timeline(board, i, line);
+            continue;
+        }
+
+        command_t* wait = waiting_command(ghost);
+        if (wait) {
+            // This play is the first turn of the wait, the next command runs turns_left turns later
+            wheel->due[i] = wheel->now + wait->turns_left * period;
+            wheel->in_wait[i] = 1;
+        } else {
+            act_ghost(board, i, &ghost->moves[ghost->current_move % ghost->n_moves]);
+            wheel->due[i] = wheel->now + period;
+        }
+        wheel_insert(wheel, i);
+    }
+    wheel->now++;
+    if (board->stream) stream_tick(board);
+}
+
+void sync_ghosts(board_t* board) {
+    ghost_wheel_t* wheel = board->wheel;
+    if (!wheel || !wheel->built) return; // the countdowns are up to date
+
+    for (int i = 0; i < board->n_ghosts; i++) {
+        ghost_t* ghost = &board->ghosts[i];
+        if (wheel->lines && wheel->lines[i].following) {
+            timeline_state(board, i, &wheel->lines[i]);
+            continue;
+        }
+
+        long period = ghost->passo + 1;
+        long remaining = wheel->due[i] - wheel->now;
+        if (!wheel->in_wait[i]) {
+            board->ghost_waiting[i] = remaining;
+            continue;
+        }
+
+        board->ghost_waiting[i] = remaining % period;
+        command_t* wait = &ghost->moves[ghost->current_move % ghost->n_moves];
+        long turns_left = remaining / period;
+        if (turns_left > 0) {
+            wait->turns_left = turns_left;
+        } else {
+            // The last turn of the wait was already played
+            wait->turns_left = wait->turns;
+            ghost->current_move += 1;
+            wheel->in_wait[i] = 0;
+        }
+    }
+}
+
+void reschedule_ghosts(board_t* board) {
+    if (board->wheel) board->wheel->built = 0;
+}
+
+void rescript_ghosts(board_t* board) {
+    if (!board->wheel) return;
+    timeline_free(board->wheel->lines, board->n_ghosts);
+    board->wheel->lines = NULL;
+    board->wheel->lines_built = 0;
+    board->wheel->built = 0;
+}
+
+int allocate_ghosts(board_t* board, int n_ghosts) {
+    int n = (n_ghosts > 0) ? n_ghosts : 1;
+    board->n_ghosts = n_ghosts;
+    board->ghosts = mem_calloc(MEM_AGENTS, n, sizeof(ghost_t));
+    board->ghost_waiting = mem_calloc(MEM_AGENTS, n, sizeof(int));
+    board->ghost_moves = mem_calloc(MEM_AGENTS, (size_t)n * MAX_MOVES, sizeof(command_t));
+    board->wheel = mem_calloc(MEM_AGENTS, 1, sizeof(ghost_wheel_t));
+    if (!board->ghosts || !board->ghost_waiting || !board->ghost_moves || !board->wheel)
+        return -1;
+    board->wheel->next = mem_calloc(MEM_AGENTS, n, sizeof(int));
+    board->wheel->due = mem_calloc(MEM_AGENTS, n, sizeof(long));
+    board->wheel->in_wait = mem_calloc(MEM_AGENTS, n, sizeof(unsigned char));
+    board->wheel->acting = mem_calloc(MEM_AGENTS, n, sizeof(int));
+    board->wheel->marked = mem_calloc(MEM_AGENTS, n, sizeof(unsigned char));
+    if (!board->wheel->next || !board->wheel->due || !board->wheel->in_wait || !board->wheel->acting ||
+        !board->wheel->marked)
+        return -1;
+
+    for (int i = 0; i < n_ghosts; i++)
+        board->ghosts[i].moves = &board->ghost_moves[(size_t)i * MAX_MOVES];
+    return 0;
+}
+
 void kill_pacman(board_t* board, int pacman_index) {
     debug("Killing %d pacman\n\n", pacman_index);
     pacman_t* pac = &board->pacmans[pacman_index];
-    int index = pac->pos_y * board->width + pac->pos_x;
+    long index = get_board_index(board, pac->pos_x, pac->pos_y);
 
     // Remove pacman from the board
     board->board[index].content = ' ';
 
     // Mark pacman as dead
-    pac->alive = 0;
+    lose_life(board, pacman_index);
 }
 
 // Static Loading
 int load_pacman(board_t* board, int points) {
-    board->board[1 * board->width + 1].content = 'P'; // Pacman
+    board->board[board_index(board, 1, 1)].content = 'P'; // Pacman
     board->pacmans[0].pos_x = 1;
     board->pacmans[0].pos_y = 1;
+    board->pacmans[0].start_x = 1;
+    board->pacmans[0].start_y = 1;
     board->pacmans[0].alive = 1;
+    board->pacmans[0].lives = 1;
     board->pacmans[0].points = points;
     return 0;
 }
@@ -371,11 +1009,11 @@ int load_pacman(board_t* board, int points) {
 // Static Loading
 int load_ghost(board_t* board) {
     // Ghost 0
-    board->board[3 * board->width + 1].content = 'M'; // Monster
+    board->board[board_index(board, 1, 3)].content = 'M'; // Monster
     board->ghosts[0].pos_x = 1;
     board->ghosts[0].pos_y = 3;
     board->ghosts[0].passo = 0;
-    board->ghosts[0].waiting = 0;
+    board->ghost_waiting[0] = 0;
     board->ghosts[0].current_move = 0;
     board->ghosts[0].n_moves = 16;
     for (int i = 0; i < 8; i++) {
@@ -388,11 +1026,11 @@ int load_ghost(board_t* board) {
     }
 
     // Ghost 1
-    board->board[2 * board->width + 4].content = 'M'; // Monster
+    board->board[board_index(board, 4, 2)].content = 'M'; // Monster
     board->ghosts[1].pos_x = 4;
     board->ghosts[1].pos_y = 2;
     board->ghosts[1].passo = 1;
-    board->ghosts[1].waiting = 1;
+    board->ghost_waiting[1] = 1;
     board->ghosts[1].current_move = 0;
     board->ghosts[1].n_moves = 1;
     board->ghosts[1].moves[0].command = 'R'; // Random
@@ -409,24 +1047,26 @@ int load_level(board_t *board, int points) {
     board->n_ghosts = 2;
     board->n_pacmans = 1;
 
-    board->board = calloc(board->width * board->height, sizeof(board_pos_t));
-    board->pacmans = calloc(board->n_pacmans, sizeof(pacman_t));
-    board->ghosts = calloc(board->n_ghosts, sizeof(ghost_t));
+    board_alloc_cells(board);
+    board->pacmans = mem_calloc(MEM_AGENTS, board->n_pacmans, sizeof(pacman_t));
+    allocate_ghosts(board, board->n_ghosts);
+    board->ghosts_files = NULL;
 
     sprintf(board->level_name, "Static Level");
 
     for (int i = 0; i < board->height; i++) {
         for (int j = 0; j < board->width; j++) {
+            board_pos_t* pos = &board->board[board_index(board, j, i)];
             if (i == 0 || j == 0 || j == (board->width - 1)) {
-                board->board[i * board->width + j].content = 'W';
+                pos->content = 'W';
             }
             else if (i == 4 && j == 8) {
-                board->board[i * board->width + j].content = ' ';
-                board->board[i * board->width + j].has_portal = 1;
+                pos->content = ' ';
+                pos->has_portal = 1;
             }
             else {
-                board->board[i * board->width + j].content = ' ';
-                board->board[i * board->width + j].has_dot = 1;
+                pos->content = ' ';
+                pos->has_dot = 1;
             }
         }
     }
@@ -438,9 +1078,22 @@ int load_level(board_t *board, int points) {
 }
 
 void unload_level(board_t * board) {
-    free(board->board);
-    free(board->pacmans);
-    free(board->ghosts);
+    board_free_cells(board);
+    mem_free(MEM_AGENTS, board->pacmans);
+    mem_free(MEM_AGENTS, board->ghosts);
+    mem_free(MEM_AGENTS, board->ghost_waiting);
+    mem_free(MEM_AGENTS, board->ghost_moves);
+    if (board->wheel) {
+        mem_free(MEM_AGENTS, board->wheel->next);
+        mem_free(MEM_AGENTS, board->wheel->due);
+        mem_free(MEM_AGENTS, board->wheel->in_wait);
+        mem_free(MEM_AGENTS, board->wheel->acting);
+        mem_free(MEM_AGENTS, board->wheel->marked);
+        timeline_free(board->wheel->lines, board->n_ghosts);
+        mem_free(MEM_AGENTS, board->wheel);
+        board->wheel = NULL;
+    }
+    mem_free(MEM_LEVEL, board->ghosts_files);
 }
 
 void open_debug_file(char *filename) {
@@ -448,10 +1101,15 @@ void open_debug_file(char *filename) {
 }
 
 void close_debug_file() {
-    fclose(debugfile);
+    if (debugfile) { // the soak (-S) runs without a debug file
+        fclose(debugfile);
+        debugfile = NULL;
+    }
 }
 
 void debug(const char * format, ...) {
+    if (!debugfile) return; // e.g. the spectator viewer has no debug file
+
     va_list args;
     va_start(args, format);
     vfprintf(debugfile, format, args);
@@ -466,42 +1124,65 @@ void print_board(board_t *board) {
         return;
     }
 
-    // Large buffer to accumulate the whole output
-    char buffer[8192];
-    size_t offset = 0;
+    debug("=== [%d] LEVEL INFO ===\n"
+          "Dimensions: %d x %d\n"
+          "Tempo: %d\n",
+          getpid(), board->height, board->width, board->tempo);
 
-    offset += snprintf(buffer + offset, sizeof(buffer) - offset,
-                       "=== [%d] LEVEL INFO ===\n"
-                       "Dimensions: %d x %d\n"
-                       "Tempo: %d\n"
-                       "Pacman file: %s\n",
-                       getpid(), board->height, board->width, board->tempo, board->pacman_file);
-
-    offset += snprintf(buffer + offset, sizeof(buffer) - offset,
-                       "Monster files (%d):\n", board->n_ghosts);
+    debug("Pacman files (%d):\n", board->n_pacmans);
+    for (int i = 0; i < board->n_pacmans; i++) {
+        debug("  - %s\n", board->pacman_files[i][0] ? board->pacman_files[i] : "(manual)");
+    }
 
+    debug("Monster files (%d):\n", board->n_ghosts);
     for (int i = 0; i < board->n_ghosts; i++) {
-        offset += snprintf(buffer + offset, sizeof(buffer) - offset,
-                           "  - %s\n", board->ghosts_files[i]);
+        debug("  - %s\n", board->ghosts_files[i]);
     }
 
-    offset += snprintf(buffer + offset, sizeof(buffer) - offset, "\n=== BOARD ===\n");
+    if (board->stream) {
+        debug("\n=== BOARD (streamed world, not printed) ===\n");
+        return;
+    }
+    debug("\n=== BOARD ===\n");
 
+    // One row at a time, so boards of any size are written in full
+    char* row = mem_malloc(MEM_LOGGING, board->width + 1);
+    if (!row) return;
     for (int y = 0; y < board->height; y++) {
         for (int x = 0; x < board->width; x++) {
-            int idx = y * board->width + x;
-            if (offset < sizeof(buffer) - 2) {
-                buffer[offset++] = board->board[idx].content;
-            }
-        }
-        if (offset < sizeof(buffer) - 2) {
-            buffer[offset++] = '\n';
+            row[x] = board->board[board_index(board, x, y)].content;
         }
+        row[board->width] = '\0';
+        debug("%s\n", row);
     }
+    mem_free(MEM_LOGGING, row);
 
-    offset += snprintf(buffer + offset, sizeof(buffer) - offset, "==================\n");
+    debug("==================\n");
+}
 
-    buffer[offset] = '\0';
+// Content codes for pack_cell, the index is the code
+static const char cell_contents[] = {'\0', ' ', 'W', 'P', 'M'};
+#define CELL_CONTENT_MASK 0x07
+#define CELL_DOT_BIT 0x08
+#define CELL_PORTAL_BIT 0x10
+
+unsigned char pack_cell(const board_pos_t* pos) {
+    unsigned char packed;
+    switch (pos->content) {
+        case ' ': packed = 1; break;
+        case 'W': packed = 2; break;
+        case 'P': packed = 3; break;
+        case 'M': packed = 4; break;
+        default: packed = 0; break;
+    }
+    if (pos->has_dot) packed |= CELL_DOT_BIT;
+    if (pos->has_portal) packed |= CELL_PORTAL_BIT;
+    return packed;
+}
 
-    debug("%s", buffer);
+void unpack_cell(unsigned char packed, board_pos_t* pos) {
+    unsigned char code = packed & CELL_CONTENT_MASK;
+    pos->content = (code < sizeof(cell_contents)) ? cell_contents[code] : '\0';
+    pos->has_dot = (packed & CELL_DOT_BIT) != 0;
+    pos->has_portal = (packed & CELL_PORTAL_BIT) != 0;
 }
@@ -0,0 +1,155 @@
+#include "board.h"
+#include "display.h"
+#include "trace.h"
+#include "protocol.h"
+#include "session.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Helper function to connect to the game server
+static int connect_server(const char* path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+// Helper function to turn the decoded trace state into a board that draw_board understands
+static void state_to_board(trace_state_t* state, board_t* board) {
+    if (!board->board || board->width != state->width || board->height != state->height
+        || board->n_pacmans != state->n_pacmans || board->n_ghosts != state->n_ghosts) {
+        board_free_cells(board);
+        free(board->pacmans);
+        free(board->ghosts);
+        board->width = state->width;
+        board->height = state->height;
+        board_alloc_cells(board);
+        board->pacmans = calloc(state->n_pacmans > 0 ? state->n_pacmans : 1, sizeof(pacman_t));
+        board->ghosts = calloc(state->n_ghosts > 0 ? state->n_ghosts : 1, sizeof(ghost_t));
+        if (!board->board || !board->pacmans || !board->ghosts) exit(1);
+    }
+    board->n_pacmans = state->n_pacmans;
+    board->n_ghosts = state->n_ghosts;
+
+    // The trace is row-major
+    int i = 0;
+    for (int y = 0; y < state->height; y++)
+        for (int x = 0; x < state->width; x++)
+            unpack_cell(state->cells[i++], &board->board[board_index(board, x, y)]);
+    for (int p = 0; p < state->n_pacmans; p++) {
+        trace_agent_t* agent = &state->agents[p];
+        board->pacmans[p].pos_x = agent->pos_x;
+        board->pacmans[p].pos_y = agent->pos_y;
+        board->pacmans[p].alive = agent->state;
+        board->pacmans[p].points = agent->points;
+        board->pacmans[p].lives = agent->lives;
+    }
+    for (int g = 0; g < state->n_ghosts; g++) {
+        trace_agent_t* agent = &state->agents[state->n_pacmans + g];
+        board->ghosts[g].pos_x = agent->pos_x;
+        board->ghosts[g].pos_y = agent->pos_y;
+        board->ghosts[g].charged = agent->state;
+    }
+}
+
+// Helper function to apply one frame message to the decoded state
+// Returns the session state of the frame, -1 if the frame is corrupted
+static int apply_frame(const unsigned char* payload, uint32_t length, trace_state_t* state) {
+    int32_t session_state;
+    if (length <= sizeof(session_state)) return -1;
+    memcpy(&session_state, payload, sizeof(session_state));
+
+    // The record has the trace file layout, so the trace reader decodes it from memory
+    FILE* record = fmemopen((void*)(payload + sizeof(session_state)), length - sizeof(session_state), "rb");
+    if (!record) return -1;
+    int result = trace_read_record(record, state);
+    fclose(record);
+    return result == 1 ? session_state : -1;
+}
+
+// Terminal client of the game server: sends keys and draws the frames it receives
+int main(int argc, char** argv) {
+    if (argc > 2) {
+        printf("Usage: %s [socket_path]\n", argv[0]);
+        return 1;
+    }
+
+    const char* path = (argc == 2) ? argv[1] : PROTO_DEFAULT_SOCKET;
+    int fd = connect_server(path);
+    if (fd < 0) {
+        printf("Error: Could not connect to %s\n", path);
+        return 1;
+    }
+
+    terminal_init();
+
+    board_t board;
+    memset(&board, 0, sizeof(board));
+    trace_state_t state = {0};
+    proto_buffer_t in = {0};
+    int mode = DRAW_MENU;
+    int connected = 1;
+
+    while (connected) {
+        char key = get_input();
+        if (key == 'Q') break;
+        if (key == 'W' || key == 'A' || key == 'S' || key == 'D') {
+            if (write(fd, &key, 1) != 1) break;
+        }
+
+        struct pollfd pfd = {.fd = fd, .events = POLLIN};
+        if (poll(&pfd, 1, 10) <= 0) continue;
+        if (proto_receive(fd, &in) <= 0) connected = 0;
+
+        char type;
+        const unsigned char* payload;
+        uint32_t length;
+        int frames = 0;
+        while (proto_next(&in, &type, &payload, &length)) {
+            if (type == PROTO_MSG_LEVEL && length == sizeof(board.level_name)) {
+                memcpy(board.level_name, payload, length);
+                board.level_name[sizeof(board.level_name) - 1] = '\0';
+            } else if (type == PROTO_MSG_FRAME) {
+                int session_state = apply_frame(payload, length, &state);
+                if (session_state < 0) {
+                    connected = 0;
+                    break;
+                }
+                mode = session_state == SESSION_WON ? DRAW_WIN
+                     : session_state == SESSION_OVER ? DRAW_GAME_OVER : DRAW_MENU;
+                frames++;
+            }
+        }
+
+        // Only the newest of the frames received together is drawn
+        if (frames > 0) {
+            state_to_board(&state, &board);
+            draw_board(&board, mode);
+            refresh_screen();
+        }
+    }
+
+    terminal_cleanup();
+    close(fd);
+    proto_free(&in);
+    trace_free_state(&state);
+    board_free_cells(&board);
+    free(board.pacmans);
+    free(board.ghosts);
+    return 0;
+}
@@ -1,161 +1,190 @@
 #include "display.h"
 #include "board.h"
-#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
 #include <ctype.h>
+#include <time.h>
 
+static const display_backend_t* backends[] = {&ncurses_backend, &ansi_backend, &null_backend};
+static const display_backend_t* backend = &ncurses_backend;
 
-int terminal_init() {
-    // Initialize ncurses mode
-    initscr();
-
-    // Disable line buffering - get characters immediately
-    cbreak();
-
-    // Don't echo typed characters to the screen
-    noecho();
-
-    // Enable special keys (arrow keys, function keys, etc.)
-    keypad(stdscr, TRUE);
-
-    // Make getch() non-blocking (return ERR if no input)
-    // nodelay(stdscr, TRUE); // Uncomment if non-blocking input is desired
-
-    // Hide the cursor
-    curs_set(0);
-
-    // Enable color if terminal supports it
-    if (has_colors()) {
-        start_color();
+static display_stats_t stats;
+static double frame_start = -1; // when the frame being drawn was started, -1 if none
 
-        // Define color pairs (foreground, background)
-        init_pair(1, COLOR_YELLOW, COLOR_BLACK);  // Pacman
-        init_pair(2, COLOR_RED, COLOR_BLACK);     // Ghosts
-        init_pair(3, COLOR_BLUE, COLOR_BLACK);    // Walls
-        init_pair(4, COLOR_WHITE, COLOR_BLACK);   // Points/dots
-        init_pair(5, COLOR_GREEN, COLOR_BLACK);   // UI elements
-        init_pair(6, COLOR_MAGENTA, COLOR_BLACK); // Extra
-        init_pair(7, COLOR_CYAN, COLOR_BLACK);    // Extra
+int display_select(const char* name) {
+    for (size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); i++) {
+        if (strcmp(backends[i]->name, name) == 0) {
+            backend = backends[i];
+            return 0;
+        }
     }
+    return -1;
+}
 
-    // Clear the screen
-    clear();
+const char* display_name() {
+    return backend->name;
+}
 
-    return 0;
+int terminal_init() {
+    memset(&stats, 0, sizeof(stats));
+    frame_start = -1;
+    return backend->init();
 }
 
 
 void draw_board(board_t* board, int mode) {
+    frame_start = now_ms();
+    if (!backend->put_char) return; // nothing is drawn, e.g. the null backend
+
     // Clear the screen before redrawing
-    clear();
+    backend->clear();
 
     // Draw the border/title
-    attron(COLOR_PAIR(5));
-    mvprintw(0, 0, "=== PACMAN GAME ===");
+    backend->put_text(0, 0, 5, "=== PACMAN GAME ===");
+    char line[512];
     switch(mode) {
     case DRAW_GAME_OVER:
-        mvprintw(1, 0, " GAME OVER ");
+        backend->put_text(1, 0, 5, " GAME OVER ");
         break;
 
     case DRAW_WIN:
-        mvprintw(1, 0, " VICTORY ");
+        backend->put_text(1, 0, 5, " VICTORY ");
         break;
 
     case DRAW_MENU:
-        mvprintw(1, 0, "Level: %s | Use W/A/S/D to move | Q to quit | G to quicksave ", board->level_name);
+        snprintf(line, sizeof(line), "Level: %s | Use W/A/S/D to move | Q to quit | G to quicksave ", board->level_name);
+        backend->put_text(1, 0, 5, line);
         break;
     }
 
 
     // Starting row for the game board (leave space for UI)
     int start_row = 3;
-
-    // Draw the board
-    for (int y = 0; y < board->height; y++) {
-        for (int x = 0; x < board->width; x++) {
-            int index = y * board->width + x;
-            char ch = board->board[index].content;
-            int ghost_charged = 0;
-
-            for (int g = 0; g < board->n_ghosts; g++) {
-                ghost_t* ghost = &board->ghosts[g];
-                if (ghost->pos_x == x && ghost->pos_y == y) {
-                    if (ghost->charged)
-                        ghost_charged = 1;
-                    break;
-                }
+    int status_lines = board->n_pacmans > 1 ? board->n_pacmans : 1;
+
+    // Viewport: the part of the board that fits between the title and the status lines
+    int screen_rows = 0, screen_cols = 0;
+    backend->size(&screen_rows, &screen_cols);
+    int view_height = screen_rows - start_row - 1 - status_lines;
+    int view_width = screen_cols;
+    if (view_height > board->height) view_height = board->height;
+    if (view_width > board->width) view_width = board->width;
+    if (view_height < 1) view_height = 1;
+    if (view_width < 1) view_width = 1;
+
+    // Centered on the first pacman alive and clamped to the edges of the board
+    int top = 0, left = 0;
+    if (view_height < board->height || view_width < board->width) {
+        pacman_t* followed = board->n_pacmans > 0 ? &board->pacmans[0] : NULL;
+        for (int p = 0; p < board->n_pacmans; p++) {
+            if (board->pacmans[p].alive) {
+                followed = &board->pacmans[p];
+                break;
             }
+        }
+        if (followed) {
+            top = followed->pos_y - view_height / 2;
+            left = followed->pos_x - view_width / 2;
+        }
+        if (top > board->height - view_height) top = board->height - view_height;
+        if (left > board->width - view_width) left = board->width - view_width;
+        if (top < 0) top = 0;
+        if (left < 0) left = 0;
+
+        snprintf(line, sizeof(line), "View: rows %d-%d, columns %d-%d of %dx%d",
+                 top, top + view_height - 1, left, left + view_width - 1, board->width, board->height);
+        backend->put_text(2, 0, 5, line);
+    }
 
-            // Move cursor to position
-            move(start_row + y, x);
+    // Draw the visible cells only
+    for (int y = top; y < top + view_height; y++) {
+        int row = start_row + y - top;
+        for (int x = left; x < left + view_width; x++) {
+            board_pos_t* cell = &board->board[board_index(board, x, y)];
+            char ch = cell->content;
+            int col = x - left;
 
             // Draw with appropriate color
             switch (ch) {
                 case 'W': // Wall
-                    attron(COLOR_PAIR(3));
-                    addch('#');
-                    attroff(COLOR_PAIR(3));
+                    backend->put_char(row, col, '#', 3, 0);
                     break;
 
                 case 'P': // Pacman
-                    attron(COLOR_PAIR(1) | A_BOLD);
-                    addch('C');
-                    attroff(COLOR_PAIR(1) | A_BOLD);
+                    backend->put_char(row, col, 'C', 1, ATTR_BOLD);
                     break;
 
-                case 'M': // Monster/Ghost
-                    attron((COLOR_PAIR(2) | A_BOLD) | ((ghost_charged) ? (A_DIM) : (0)));
-                    addch('M');
-                    attroff((COLOR_PAIR(2) | A_BOLD) | ((ghost_charged) ? (A_DIM) : (0)));
+                case 'M': // Monster/Ghost, charged ones are dimmed below
+                    backend->put_char(row, col, 'M', 2, ATTR_BOLD);
                     break;
 
                 case ' ': // Empty space
-                    if (board->board[index].has_portal) {
-                        attron(COLOR_PAIR(6));
-                        addch('@');
-                        attroff(COLOR_PAIR(6));
-                    }
-                    else if (board->board[index].has_dot) {
-                        attron(COLOR_PAIR(4));
-                        addch('.');
-                        attroff(COLOR_PAIR(4));
-                    }
+                    if (cell->has_portal)
+                        backend->put_char(row, col, '@', 6, 0);
+                    else if (cell->has_dot)
+                        backend->put_char(row, col, '.', 4, 0);
                     else
-                        addch(' ');
+                        backend->put_char(row, col, ' ', 0, 0);
                     break;
 
                 default:
-                    addch(ch);
+                    backend->put_char(row, col, ch, 0, 0);
                     break;
             }
         }
     }
 
-    // Draw score/status at the bottom
-    attron(COLOR_PAIR(5));
-    mvprintw(start_row + board->height + 1, 0, "Points: %d",
-             board->pacmans[0].points); // Assuming first pacman for now
-    attroff(COLOR_PAIR(5));
+    // One pass over the ghosts instead of a search per cell
+    for (int g = 0; g < board->n_ghosts; g++) {
+        ghost_t* ghost = &board->ghosts[g];
+        if (!ghost->charged || ghost->pos_y < top || ghost->pos_y >= top + view_height ||
+            ghost->pos_x < left || ghost->pos_x >= left + view_width)
+            continue;
+        if (board->board[board_index(board, ghost->pos_x, ghost->pos_y)].content == 'M')
+            backend->put_char(start_row + ghost->pos_y - top, ghost->pos_x - left, 'M', 2, ATTR_BOLD | ATTR_DIM);
+    }
+
+    // Draw score/status at the bottom, one line per pacman
+    int status_row = start_row + view_height + 1;
+    if (board->n_pacmans == 1) {
+        int n = snprintf(line, sizeof(line), "Points: %d | Lives: %d",
+                         board->pacmans[0].points, board->pacmans[0].lives);
+        if (board->best_points > 0 && n > 0 && (size_t)n < sizeof(line))
+            snprintf(line + n, sizeof(line) - n, " | Best: %d", board->best_points);
+        backend->put_text(status_row, 0, 5, line);
+    } else {
+        for (int p = 0; p < board->n_pacmans; p++) {
+            int n = snprintf(line, sizeof(line), "Pacman %d - Points: %d | Lives: %d%s",
+                             p, board->pacmans[p].points, board->pacmans[p].lives,
+                             board->pacmans[p].alive ? "" : " (dead)");
+            if (p == 0 && board->best_points > 0 && n > 0 && (size_t)n < sizeof(line))
+                snprintf(line + n, sizeof(line) - n, " | Best: %d", board->best_points);
+            backend->put_text(status_row + p, 0, 5, line);
+        }
+    }
 }
 
 void draw(char c, int colour_i, int pos_x, int pos_y) {
-    move(pos_y, pos_x);
-    attron(COLOR_PAIR(colour_i) | A_BOLD);
-    addch(c);
-    attroff(COLOR_PAIR(colour_i) | A_BOLD);
+    if (backend->put_char)
+        backend->put_char(pos_y, pos_x, c, colour_i, ATTR_BOLD);
 }
 
 void refresh_screen() {
-    // Update the physical screen with the virtual screen
-    refresh();
+    backend->refresh();
+    if (frame_start >= 0) {
+        stats.frames++;
+        stats.draw_ms += now_ms() - frame_start;
+        frame_start = -1;
+    }
 }
 
 char get_input() {
     // Get a character from the keyboard
-    int ch = getch();
+    int ch = backend->read_key();
 
-    // getch() returns ERR if no input is available
-    if (ch == ERR) {
-        return '\0'; // No input
+    // No input
+    if (ch < 0) {
+        return '\0';
     }
 
     ch = toupper((char)ch);
@@ -166,15 +195,22 @@ char get_input() {
         case 'A':
         case 'D':
         case 'Q':
+        case 'G':
+        case 'B':
 
             return (char)ch;
-        
+
         default:
             return '\0';
     }
 }
 
+display_stats_t display_stats() {
+    return stats;
+}
+
 void terminal_cleanup() {
-    // Restore terminal settings and clean up ncurses
-    endwin();
+    backend->cleanup();
+    debug("DISPLAY %s: %lu frames in %.1f ms (%.0f frames/s)\n", backend->name, stats.frames, stats.draw_ms,
+          stats.draw_ms > 0 ? stats.frames * 1000.0 / stats.draw_ms : 0.0);
 }
@@ -0,0 +1,213 @@
+#include "display.h"
+#include "memstats.h"
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+/*
+Raw ANSI backend: frames are drawn into a grid of cells, compared with the grid
+the terminal is showing, and only the cells that changed are sent, as cursor
+moves, colour changes and characters, with one write() per frame.
+*/
+
+typedef struct {
+    char ch;
+    unsigned char colour;
+    unsigned char attrs;
+} ansi_cell_t;
+
+static ansi_cell_t* shown = NULL;   // what the terminal is showing
+static ansi_cell_t* frame = NULL;   // frame being drawn
+static int rows = 0, cols = 0;
+static int full_redraw = 1;
+
+// Output of one frame
+static char* out = NULL;
+static size_t out_size = 0, out_capacity = 0;
+
+static struct termios saved_termios;
+static int termios_saved = 0;
+static int saved_flags = -1;
+
+// Foreground colours of the colour pairs used by display.c (0 is the default colour)
+static const int colour_codes[] = {39, 33, 31, 34, 37, 32, 35, 36};
+
+// Helper private function to append bytes to the output of the frame
+static void emit(const char* bytes, size_t size) {
+    if (out_size + size > out_capacity) {
+        out_capacity = (out_size + size) * 2;
+        out = mem_realloc(MEM_DISPLAY, out, out_capacity);
+        if (!out) exit(1);
+    }
+    memcpy(out + out_size, bytes, size);
+    out_size += size;
+}
+
+// Helper private function to send the output with as few write() calls as the terminal allows
+// The whole frame is sent even if stdout turns out to be non-blocking: the cells in it are
+// already in 'shown' and would never be sent again. If it cannot be sent, the next frame redraws all
+static void flush_output() {
+    size_t done = 0;
+    while (done < out_size) {
+        ssize_t n = write(STDOUT_FILENO, out + done, out_size - done);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            struct pollfd pfd = {.fd = STDOUT_FILENO, .events = POLLOUT};
+            poll(&pfd, 1, -1);
+            continue;
+        }
+        if (n <= 0) {
+            full_redraw = 1;
+            break;
+        }
+        done += n;
+    }
+    out_size = 0;
+}
+
+// Helper private function to size the grids to the terminal, a new size redraws everything
+static void fit_terminal() {
+    struct winsize size;
+    int new_rows = 24, new_cols = 80;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_row > 0 && size.ws_col > 0) {
+        new_rows = size.ws_row;
+        new_cols = size.ws_col;
+    }
+    if (new_rows == rows && new_cols == cols && frame) return;
+
+    rows = new_rows;
+    cols = new_cols;
+    mem_free(MEM_DISPLAY, shown);
+    mem_free(MEM_DISPLAY, frame);
+    shown = mem_calloc(MEM_DISPLAY, (size_t)rows * cols, sizeof(ansi_cell_t));
+    frame = mem_calloc(MEM_DISPLAY, (size_t)rows * cols, sizeof(ansi_cell_t));
+    if (!shown || !frame) exit(1);
+    full_redraw = 1;
+}
+
+static int ansi_init() {
+    // Keys are read one at a time, without echo and without waiting
+    if (isatty(STDIN_FILENO) && tcgetattr(STDIN_FILENO, &saved_termios) == 0) {
+        struct termios raw = saved_termios;
+        raw.c_lflag &= ~(ICANON | ECHO);
+        raw.c_cc[VMIN] = 0;
+        raw.c_cc[VTIME] = 0;
+        tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+        termios_saved = 1;
+    }
+    // VMIN=0/VTIME=0 already make terminal reads return at once. O_NONBLOCK is only for other
+    // inputs (a pipe): on a terminal stdin and stdout share one open file, which it would change too
+    if (!termios_saved) {
+        saved_flags = fcntl(STDIN_FILENO, F_GETFL);
+        if (saved_flags >= 0)
+            fcntl(STDIN_FILENO, F_SETFL, saved_flags | O_NONBLOCK);
+    }
+
+    fit_terminal();
+    // Hide the cursor and clear the screen
+    emit("\x1b[?25l\x1b[2J", 10);
+    flush_output();
+    return 0;
+}
+
+static void ansi_clear() {
+    fit_terminal();
+    for (int i = 0; i < rows * cols; i++)
+        frame[i] = (ansi_cell_t){' ', 0, 0};
+}
+
+static void ansi_put_char(int row, int col, char c, int colour_i, int attrs) {
+    if (row < 0 || row >= rows || col < 0 || col >= cols) return; // clipped like ncurses
+    frame[row * cols + col] = (ansi_cell_t){c, (unsigned char)colour_i, (unsigned char)attrs};
+}
+
+static void ansi_put_text(int row, int col, int colour_i, const char* text) {
+    for (int i = 0; text[i] != '\0'; i++)
+        ansi_put_char(row, col + i, text[i], colour_i, 0);
+}
+
+static void ansi_refresh() {
+    if (!frame) return;
+
+    int cursor_row = -1, cursor_col = -1;
+    int colour = -1, attrs = -1; // unknown terminal state at the start of the frame
+    char sequence[32];
+
+    for (int row = 0; row < rows; row++) {
+        for (int col = 0; col < cols; col++) {
+            ansi_cell_t* cell = &frame[row * cols + col];
+            ansi_cell_t* old = &shown[row * cols + col];
+            if (!full_redraw && cell->ch == old->ch && cell->colour == old->colour && cell->attrs == old->attrs)
+                continue;
+
+            if (row != cursor_row || col != cursor_col) {
+                int n = snprintf(sequence, sizeof(sequence), "\x1b[%d;%dH", row + 1, col + 1);
+                emit(sequence, n);
+            }
+            if (cell->colour != colour || cell->attrs != attrs) {
+                int n = snprintf(sequence, sizeof(sequence), "\x1b[0%s%s;%dm",
+                                 (cell->attrs & ATTR_BOLD) ? ";1" : "", (cell->attrs & ATTR_DIM) ? ";2" : "",
+                                 colour_codes[cell->colour & 7]);
+                emit(sequence, n);
+                colour = cell->colour;
+                attrs = cell->attrs;
+            }
+            emit(&cell->ch, 1);
+            cursor_row = row;
+            cursor_col = col + 1;
+            *old = *cell;
+        }
+    }
+    full_redraw = 0;
+    flush_output();
+}
+
+static void ansi_size(int* rows_out, int* cols_out) {
+    fit_terminal();
+    *rows_out = rows;
+    *cols_out = cols;
+}
+
+static int ansi_read_key() {
+    unsigned char c;
+    return read(STDIN_FILENO, &c, 1) == 1 ? c : -1;
+}
+
+static void ansi_cleanup() {
+    char sequence[32];
+    int n = snprintf(sequence, sizeof(sequence), "\x1b[0m\x1b[%d;1H\x1b[?25h\n", rows);
+    emit(sequence, n);
+    flush_output();
+
+    if (termios_saved)
+        tcsetattr(STDIN_FILENO, TCSANOW, &saved_termios);
+    if (saved_flags >= 0)
+        fcntl(STDIN_FILENO, F_SETFL, saved_flags);
+    termios_saved = 0;
+    saved_flags = -1;
+
+    mem_free(MEM_DISPLAY, shown);
+    mem_free(MEM_DISPLAY, frame);
+    mem_free(MEM_DISPLAY, out);
+    shown = frame = NULL;
+    out = NULL;
+    out_capacity = 0;
+    rows = cols = 0;
+}
+
+const display_backend_t ansi_backend = {
+    .name = "ansi",
+    .init = ansi_init,
+    .clear = ansi_clear,
+    .put_char = ansi_put_char,
+    .put_text = ansi_put_text,
+    .refresh = ansi_refresh,
+    .size = ansi_size,
+    .read_key = ansi_read_key,
+    .cleanup = ansi_cleanup,
+};
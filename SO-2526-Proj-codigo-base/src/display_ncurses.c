@@ -0,0 +1,102 @@
+#include "display.h"
+#include <ncurses.h>
+
+
+static int ncurses_init() {
+    // Initialize ncurses mode
+    initscr();
+
+    // Disable line buffering - get characters immediately
+    cbreak();
+
+    // Don't echo typed characters to the screen
+    noecho();
+
+    // Enable special keys (arrow keys, function keys, etc.)
+    keypad(stdscr, TRUE);
+
+    // Make getch() non-blocking (return ERR if no input)
+    nodelay(stdscr, TRUE);
+
+    // Hide the cursor
+    curs_set(0);
+
+    // Enable color if terminal supports it
+    if (has_colors()) {
+        start_color();
+
+        // Define color pairs (foreground, background)
+        init_pair(1, COLOR_YELLOW, COLOR_BLACK);  // Pacman
+        init_pair(2, COLOR_RED, COLOR_BLACK);     // Ghosts
+        init_pair(3, COLOR_BLUE, COLOR_BLACK);    // Walls
+        init_pair(4, COLOR_WHITE, COLOR_BLACK);   // Points/dots
+        init_pair(5, COLOR_GREEN, COLOR_BLACK);   // UI elements
+        init_pair(6, COLOR_MAGENTA, COLOR_BLACK); // Extra
+        init_pair(7, COLOR_CYAN, COLOR_BLACK);    // Extra
+    }
+
+    // Clear the screen
+    clear();
+
+    return 0;
+}
+
+static void ncurses_clear() {
+    clear();
+}
+
+// Helper private function to turn colour and ATTR_* flags into ncurses attributes
+static attr_t to_attrs(int colour_i, int attrs) {
+    attr_t result = colour_i > 0 ? COLOR_PAIR(colour_i) : 0;
+    if (attrs & ATTR_BOLD) result |= A_BOLD;
+    if (attrs & ATTR_DIM) result |= A_DIM;
+    return result;
+}
+
+static void ncurses_put_char(int row, int col, char c, int colour_i, int attrs) {
+    attr_t attributes = to_attrs(colour_i, attrs);
+    move(row, col);
+    attron(attributes);
+    addch(c);
+    attroff(attributes);
+}
+
+static void ncurses_put_text(int row, int col, int colour_i, const char* text) {
+    attr_t attributes = to_attrs(colour_i, 0);
+    attron(attributes);
+    mvprintw(row, col, "%s", text);
+    attroff(attributes);
+}
+
+static void ncurses_refresh() {
+    // Update the physical screen with the virtual screen
+    refresh();
+}
+
+static void ncurses_size(int* rows, int* cols) {
+    // ncurses updates the size when getch() handles a resize (KEY_RESIZE)
+    getmaxyx(stdscr, *rows, *cols);
+}
+
+static int ncurses_read_key() {
+    // getch() returns ERR if no input is available
+    int ch = getch();
+    return ch == ERR ? -1 : ch;
+}
+
+static void ncurses_cleanup() {
+    // Restore terminal settings and clean up ncurses
+    endwin();
+}
+
+const display_backend_t ncurses_backend = {
+    .name = "ncurses",
+    .init = ncurses_init,
+    .clear = ncurses_clear,
+    .put_char = ncurses_put_char,
+    .put_text = ncurses_put_text,
+    .refresh = ncurses_refresh,
+    .size = ncurses_size,
+    .read_key = ncurses_read_key,
+    .cleanup = ncurses_cleanup,
+};
@@ -0,0 +1,41 @@
+#include "display.h"
+#include <poll.h>
+#include <unistd.h>
+
+/*
+Null backend: draws nothing, for benchmarks and batch runs.
+Keys are read from standard input without waiting, so a run can be scripted
+with a pipe; the end of the input reads as 'Q'. Standard input is polled rather
+than made non-blocking: on a terminal the flag would also apply to stdout.
+*/
+
+static int null_init() {
+    return 0;
+}
+
+static void null_refresh() {
+}
+
+static int null_read_key() {
+    struct pollfd pfd = {.fd = STDIN_FILENO, .events = POLLIN};
+    if (poll(&pfd, 1, 0) != 1) return -1;
+    unsigned char c;
+    ssize_t n = read(STDIN_FILENO, &c, 1);
+    if (n == 0) return 'Q';
+    return n == 1 ? c : -1;
+}
+
+static void null_cleanup() {
+}
+
+const display_backend_t null_backend = {
+    .name = "null",
+    .init = null_init,
+    .clear = NULL,
+    .put_char = NULL,
+    .put_text = NULL,
+    .refresh = null_refresh,
+    .size = NULL,
+    .read_key = null_read_key,
+    .cleanup = null_cleanup,
+};
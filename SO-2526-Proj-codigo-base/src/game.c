@@ -5,7 +5,18 @@
 #include <unistd.h>
 #include <stdbool.h>
 #include "file_loader.h"
+#include "level_watch.h"
 #include "game_backup.h"
+#include "checkpoint.h"
+#include "spectator.h"
+#include "renderer.h"
+#include "trace.h"
+#include "autopilot.h"
+#include "memstats.h"
+#include "scores.h"
+#include "latency.h"
+#include <stdio.h>
+#include <string.h>
 
 
 #define CONTINUE_PLAY 0
@@ -14,80 +25,273 @@
 #define LOAD_BACKUP 3
 #define CREATE_BACKUP 4
 
+// Espectadores ligados com -s (tabuleiro publicado em memória partilhada)
+static bool spectators_enabled = false;
+
+// Pacmans sem ficheiro de movimentos jogados pelo piloto automático (-a)
+static bool autopilot_enabled = false;
+static bool autopilot_level = false; // o piloto consegue jogar o nível atual
+
+// Autosave a cada 'autosave_interval' jogadas (-A, 0 desliga), escrito por um processo filho
+static int autosave_interval = 0;
+static long autosave_plays = 0;
+
+// Modo soak (-S): joga os níveis em ciclo, sem ecrã e sem esperas, e vai escrevendo a memória usada
+#define SOAK_REPORT_SECONDS 60  // intervalo entre relatórios
+#define SOAK_SAVE_PLAYS 500     // jogadas entre quicksaves ('G')
+#define SOAK_REWIND_PLAYS 170   // jogadas entre voltas ao checkpoint anterior ('B')
+static bool soak_enabled = false;
+static struct {
+    double seconds;             // duração pedida
+    double start, next_report;  // em segundos (CLOCK_MONOTONIC)
+    long plays;
+    int games;
+    unsigned int rng;           // direções ao acaso nos níveis que o piloto não joga
+    long first_resident, first_heap; // primeiro relatório, base do crescimento
+    bool done;
+} soak;
+
+// Helper: escreve em stderr a memória residente, o heap e os contadores de cada subsistema
+static void soak_report(const char* tag, double now) {
+    long resident = mem_resident_bytes(), heap = mem_heap_bytes();
+    if (soak.first_resident == 0) {
+        soak.first_resident = resident;
+        soak.first_heap = heap;
+    }
+    char subsystems[512];
+    mem_format(subsystems, sizeof(subsystems));
+    fprintf(stderr, "%s %7.0f s  plays %ld  games %d  rss %.1f MB (%+.1f)  heap %.1f MB (%+.1f)  %s\n", tag,
+            now - soak.start, soak.plays, soak.games, resident / 1048576.0, (resident - soak.first_resident) / 1048576.0,
+            heap / 1048576.0, (heap - soak.first_heap) / 1048576.0, subsystems);
+}
+
+// Helper: conta uma jogada do soak, escreve o relatório quando chega a altura
+// Retorna true quando o tempo pedido acabou
+static bool soak_tick(void) {
+    soak.plays++;
+    if (soak.plays % 256 != 0) return false;
+    double now = now_ms() / 1000;
+    if (now >= soak.next_report) {
+        soak_report("SOAK", now);
+        soak.next_report += SOAK_REPORT_SECONDS;
+    }
+    soak.done = now - soak.start >= soak.seconds;
+    return soak.done;
+}
+
+// Helper: tecla do soak para os pacmans manuais: guarda e recua de vez em quando, o resto vem do
+// piloto automático (ou é uma direção ao acaso nos níveis que o piloto não joga)
+static char soak_key(board_t* game_board) {
+    if (soak.plays % SOAK_SAVE_PLAYS == SOAK_SAVE_PLAYS - 1) return 'G';
+    if (soak.plays % SOAK_REWIND_PLAYS == SOAK_REWIND_PLAYS - 1) return 'B';
+    if (autopilot_level) return autopilot_next(game_board);
+    return "WASD"[rand_r(&soak.rng) % 4];
+}
+
 void screen_refresh(board_t * game_board, int mode) {
     debug("REFRESH\n");
-    draw_board(game_board, mode);
-    refresh_screen();
-    if(game_board->tempo != 0)
+    if (spectators_enabled)
+        spectator_publish(game_board, mode);
+    trace_record(game_board);
+    // O desenho é feito pela thread de render, a simulação não espera pelo terminal
+    renderer_publish(game_board, mode);
+    if(game_board->tempo != 0 && !soak_enabled)
         sleep_ms(game_board->tempo);       
 }
 
 int play_board(board_t *game_board) {
-    pacman_t* pacman = &game_board->pacmans[0];
-    command_t* play;
+    command_t input;
+    command_t* play = NULL;
 
-    // Receber input
-    if (pacman->n_moves == 0) {
-        command_t c;
-        c.command = get_input();
+    // Há input do utilizador se algum pacman não tiver ficheiro de movimentos
+    bool manual = false;
+    for (int p = 0; p < game_board->n_pacmans; p++) {
+        if (game_board->pacmans[p].n_moves == 0)
+            manual = true;
+    }
 
-        if (c.command == '\0')
+    // Receber input (partilhado por todos os pacmans manuais)
+    if (manual) {
+        if (soak_enabled) {
+            input.command = soak_key(game_board);
+        } else if (autopilot_level) {
+            // As teclas só servem para sair, guardar e recuar, a jogada vem do piloto automático
+            input.command = renderer_poll_input();
+            if (input.command != 'Q' && input.command != 'G' && input.command != 'B')
+                input.command = autopilot_next(game_board);
+        } else {
+            input.command = renderer_get_input();
+        }
+        if (input.command == '\0')
             return CONTINUE_PLAY;
 
-        c.turns = 1;
-        play = &c;
+        input.turns = 1;
+        input.turns_left = 1;
+        play = &input;
+        debug("KEY %c\n", play->command);
     } else {
         // Input pré-definido do ficheiro
-        play = &pacman->moves[pacman->current_move % pacman->n_moves];
+        pacman_t* pacman = &game_board->pacmans[0];
+        debug("KEY %c\n", pacman->moves[pacman->current_move % pacman->n_moves].command);
     }
 
-    debug("KEY %c\n", play->command);
-
     // Sair do jogo
-    if (play->command == 'Q')
+    if (play && play->command == 'Q')
         return QUIT_GAME;
 
     // Guardar backup com 'G' (se ainda não existir)
-    if (play->command == 'G') {
+    if (play && play->command == 'G') {
         if (!backup_exists) {
             save_game(game_board); // fork() vai criar backup no processo pai
         }
         return CONTINUE_PLAY;
     }
 
-    // Mover Pacman
-    int result = move_pacman(game_board, 0, play);
+    // Voltar ao checkpoint anterior com 'B'
+    if (play && play->command == 'B') {
+        checkpoint_rewind(game_board);
+        return CONTINUE_PLAY;
+    }
+
+    // Mover todos os Pacmans ao mesmo tempo
+    int result = move_pacmans(game_board, play);
     if (result == REACHED_PORTAL)
         return NEXT_LEVEL;
 
-    // Verificar morte
-    if (result == DEAD_PACMAN || !pacman->alive) {
-        if (backup_exists) {
-            restore_game(); // retoma do backup
-            return CONTINUE_PLAY;
-        }
+    // Verificar morte (nenhum pacman vivo nem com vidas)
+    if (result == DEAD_PACMAN) {
+        if (backup_exists && restore_game(game_board) == 0)
+            return LOAD_BACKUP; // retoma do backup (pode ser de outro nível)
         return QUIT_GAME;
     }
 
     // Mover fantasmas
-    for (int i = 0; i < game_board->n_ghosts; i++) {
-        ghost_t* ghost = &game_board->ghosts[i];
-        move_ghost(game_board, i, &ghost->moves[ghost->current_move % ghost->n_moves]);
-    }
+    move_ghosts(game_board);
 
+    checkpoint_tick(game_board);
+    if (autosave_interval > 0 && ++autosave_plays % autosave_interval == 0)
+        autosave_start(game_board); // não espera pela escrita
     return CONTINUE_PLAY;
 }
 
+// Resultados de reload_changed_files
+#define RELOADED_NOTHING 0
+#define RELOADED_AGENTS 1
+#define RELOADED_LEVEL 2
+
+// Aplica as alterações aos ficheiros dos níveis feitas durante o jogo: cada ficheiro alterado é lido
+// outra vez sozinho. Um .p ou .m muda só os scripts dos agentes que o usam, o .lvl do nível atual
+// recomeça o nível (com os pontos de cada pacman no início do nível, 'start_points') e os outros
+// .lvl só mudam a lista de níveis
+static int reload_changed_files(board_t* game_board, level_manager_t* manager, const int* start_points) {
+    char names[LEVEL_WATCH_MAX_NAMES][MAX_FILENAME];
+    int n_names = level_watch_poll(names);
+    if (n_names == 0) return RELOADED_NOTHING;
+
+    bool levels_changed = false, current_changed = false, agents_changed = false;
+    for (int i = 0; i < n_names; i++) {
+        if (ends_with(names[i], ".lvl")) {
+            levels_changed = true;
+            if (strcmp(names[i], game_board->level_name) == 0) current_changed = true;
+        } else if (reload_behavior_file(game_board, manager, names[i]) > 0) {
+            agents_changed = true;
+        }
+    }
+    if (levels_changed && rescan_levels(manager) != 0)
+        debug("Error: Could not scan %s again\n", manager->directory);
+
+    if (current_changed) {
+        // O nível novo só substitui o atual se for lido sem erros (o ficheiro pode estar a meio de uma edição)
+        board_t reloaded;
+        memset(&reloaded, 0, sizeof(reloaded));
+        if (load_level_from_file(&reloaded, manager, start_points) == 0) {
+            reloaded.rng_state = game_board->rng_state;
+            unload_level(game_board);
+            *game_board = reloaded;
+            debug("RELOAD %s: level restarted\n", game_board->level_name);
+            return RELOADED_LEVEL;
+        }
+        unload_level(&reloaded);
+        debug("Error: %s could not be reloaded, the level goes on as it was\n", game_board->level_name);
+    }
+    return agents_changed ? RELOADED_AGENTS : RELOADED_NOTHING;
+}
+
+// Melhor pontuação do nível para a linha de estado, com o que os outros jogos já registaram
+static void show_best(board_t* game_board, bool scores_enabled) {
+    if (scores_enabled) scores_refresh();
+    game_board->best_points = scores_enabled ? scores_best(game_board->level_name) : 0;
+}
+
+// Guarda os pontos de cada pacman para o próximo nível
+static void keep_points(board_t* game_board, int* accumulated_points) {
+    for (int p = 0; p < game_board->n_pacmans; p++)
+        accumulated_points[p] = game_board->pacmans[p].points;
+}
+
 int main(int argc, char** argv) {
-    if (argc != 2) {
-        printf("Usage: %s <level_directory>\n", argv[0]);
+    const char* spectator_name = NULL;
+    const char* trace_filename = NULL;
+    const char* resume_filename = NULL;
+    const char* latency_filename = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "as:t:r:c:d:S:L:A:")) != -1) {
+        switch (opt) {
+            case 'a': // pacmans sem ficheiro jogados pelo piloto automático
+                autopilot_enabled = true;
+                break;
+            case 's': // publicar o tabuleiro para espectadores
+                spectator_name = optarg;
+                break;
+            case 't': // trace binário de todas as jogadas
+                trace_filename = optarg;
+                break;
+            case 'r': // retomar um jogo guardado com 'G'
+                resume_filename = optarg;
+                break;
+            case 'c': // jogadas entre checkpoints (0 desliga)
+                checkpoint_set_interval(atoi(optarg));
+                break;
+            case 'd': // backend do ecrã: ncurses, ansi ou null
+                if (display_select(optarg) != 0) {
+                    printf("Error: Unknown display %s (ncurses, ansi or null)\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'A': // jogadas entre autosaves
+                autosave_interval = atoi(optarg);
+                break;
+            case 'L': // latência tecla->frame de cada tecla, num ficheiro
+                latency_filename = optarg;
+                break;
+            case 'S': // soak: joga os níveis em ciclo durante 'optarg' segundos
+                soak_enabled = true;
+                soak.seconds = atof(optarg);
+                break;
+            default:
+                printf("Usage: %s [-a] [-s shm_name] [-t trace_file] [-r save_file] [-c checkpoint_ticks] [-d display] [-S soak_seconds] [-L latency_file] [-A autosave_plays] <level_directory>\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if (argc - optind != 1) {
+        printf("Usage: %s [-a] [-s shm_name] [-t trace_file] [-r save_file] [-c checkpoint_ticks] [-d display] [-S soak_seconds] [-L latency_file] [-A autosave_plays] <level_directory>\n", argv[0]);
         return 1;
-        // TODO receive inputs
     }
 
-    open_debug_file("debug.log");
+    if (soak_enabled) {
+        // Sem ecrã e com o piloto; o debug.log cresceria sem limite ao ritmo de uma linha por jogada
+        display_select("null");
+        autopilot_enabled = true;
+        soak.rng = (unsigned int)time(NULL);
+        soak.start = now_ms() / 1000;
+        soak.next_report = soak.start + SOAK_REPORT_SECONDS;
+    } else {
+        open_debug_file("debug.log");
+    }
 
-    const char* level_directory = argv[1];
+    const char* level_directory = argv[optind];
     level_manager_t level_manager;
     if (init_level_manager(&level_manager, level_directory) == -1) {
         printf("Error: Could not initialize level manager\n");
@@ -95,63 +299,213 @@ int main(int argc, char** argv) {
         return 1;
     }
 
-    // Random seed for any random movements
-    srand((unsigned int)time(NULL));
+    // Random seed for any random movements (passa de nível para nível e fica nos saves)
+    unsigned int rng_state = (unsigned int)time(NULL);
+
+    if (spectator_name) {
+        if (spectator_open(spectator_name) != 0) {
+            printf("Error: Could not create shared memory %s\n", spectator_name);
+            close_debug_file();
+            return 1;
+        }
+        spectators_enabled = true;
+    }
+
+    if (trace_filename && trace_open(trace_filename) != 0) {
+        printf("Error: Could not open trace file %s\n", trace_filename);
+        if (spectators_enabled) spectator_close();
+        close_debug_file();
+        return 1;
+    }
+
+    if (latency_filename && latency_open(latency_filename) != 0) {
+        printf("Error: Could not open latency file %s\n", latency_filename);
+        if (spectators_enabled) spectator_close();
+        trace_close();
+        close_debug_file();
+        return 1;
+    }
 
     terminal_init();
-    
-    int accumulated_points = 0;
+    if (renderer_start() != 0) {
+        terminal_cleanup();
+        printf("Error: Could not start render thread\n");
+        if (spectators_enabled) spectator_close();
+        trace_close();
+        latency_close();
+        close_debug_file();
+        return 1;
+    }
+
+    // Os ficheiros dos níveis podem ser alterados durante o jogo (não no soak, que corre sempre os mesmos)
+    bool watching = !soak_enabled && level_watch_open(level_manager.directory) == 0;
+
+    // Pontuações de cada nível e de cada jogo (o soak não as regista, jogaria sempre os mesmos níveis)
+    bool scores_enabled = !soak_enabled && scores_open(SCORES_FILE) == 0;
+    int level_start_points = 0; // pontos de todos os pacmans quando o nível começou
+    int start_points[MAX_PACMANS] = {0}; // e de cada um, com que o nível recomeça se o .lvl mudar
+
+    int accumulated_points[MAX_PACMANS] = {0};
     bool end_game = false;
     board_t game_board;
 
     while (!end_game) {
-        if (load_level_from_file(&game_board, &level_manager, accumulated_points) != 0) {
-            printf("Error: Could not load level %d\n", level_manager.current_level);
-            break;
+        if (resume_filename) {
+            // Retomar o jogo guardado, incluindo o nível em que estava
+            if (load_state_from_file(resume_filename, &game_board) != 0
+                || game_board.level_index < 0 || game_board.level_index >= level_manager.n_levels) {
+                printf("Error: Could not resume from %s\n", resume_filename);
+                break;
+            }
+            level_manager.current_level = game_board.level_index;
+            keep_points(&game_board, accumulated_points);
+            resume_filename = NULL;
+        } else {
+            if (load_level_from_file(&game_board, &level_manager, accumulated_points) != 0) {
+                printf("Error: Could not load level %d\n", level_manager.current_level);
+                break;
+            }
+            game_board.rng_state = rng_state;
         }
+        level_start_points = total_points(&game_board);
+        keep_points(&game_board, start_points);
+        show_best(&game_board, scores_enabled);
+
+        if (checkpoint_reset(&game_board) != 0)
+            debug("Error: Could not start checkpoints for %s\n", game_board.level_name);
+        if (autopilot_enabled)
+            autopilot_level = autopilot_reset(&game_board) == 0;
 
         bool level_completed = false;
 
-        draw_board(&game_board, DRAW_MENU);
-        refresh_screen();
+        if (spectators_enabled)
+            spectator_publish(&game_board, DRAW_MENU);
+        trace_begin_level(&game_board);
+        renderer_publish(&game_board, DRAW_MENU);
 
         while(true) {
+            int reloaded = watching ? reload_changed_files(&game_board, &level_manager, start_points) : RELOADED_NOTHING;
+            if (reloaded != RELOADED_NOTHING) {
+                // Os checkpoints e a previsão do piloto foram feitos com os scripts antigos
+                checkpoint_reset(&game_board);
+                if (autopilot_enabled)
+                    autopilot_level = autopilot_reset(&game_board) == 0;
+                if (reloaded == RELOADED_LEVEL) {
+                    // A tentativa descartada não conta: o nível recomeça com os pontos do início
+                    level_start_points = total_points(&game_board);
+                    keep_points(&game_board, accumulated_points);
+                    show_best(&game_board, scores_enabled);
+                    trace_begin_level(&game_board);
+                    screen_refresh(&game_board, DRAW_MENU);
+                }
+            }
+
             int result = play_board(&game_board); 
+            autosave_poll(); // recolhe o autosave anterior se já acabou
+
+            if (soak_enabled && soak_tick()) {
+                end_game = true;
+                break;
+            }
 
             if(result == NEXT_LEVEL) {
-                accumulated_points = game_board.pacmans[0].points;
+                keep_points(&game_board, accumulated_points);
+                if (scores_enabled)
+                    scores_add(game_board.level_name, total_points(&game_board) - level_start_points);
                 screen_refresh(&game_board, DRAW_WIN);
-                sleep_ms(game_board.tempo);
+                if (!soak_enabled) sleep_ms(game_board.tempo);
                 level_completed = true;
                 break;
             }
 
+            if(result == LOAD_BACKUP) {
+                // O backup pode ter sido guardado noutro nível: os pontos desse nível contam a partir daqui
+                if (game_board.level_index != level_manager.current_level) {
+                    level_start_points = total_points(&game_board);
+                    keep_points(&game_board, start_points);
+                }
+                level_manager.current_level = game_board.level_index;
+                show_best(&game_board, scores_enabled);
+                trace_begin_level(&game_board);
+                checkpoint_reset(&game_board);
+                if (autopilot_enabled)
+                    autopilot_level = autopilot_reset(&game_board) == 0;
+            }
+
             if(result == QUIT_GAME) {
+                if (scores_enabled) {
+                    scores_add(game_board.level_name, total_points(&game_board) - level_start_points);
+                    scores_add(NULL, total_points(&game_board));
+                }
                 screen_refresh(&game_board, DRAW_GAME_OVER); 
-                sleep_ms(game_board.tempo);
+                if (!soak_enabled) sleep_ms(game_board.tempo);
                 end_game = true;
                 break;
             }
     
             screen_refresh(&game_board, DRAW_MENU); 
 
-            accumulated_points = game_board.pacmans[0].points;      
+            keep_points(&game_board, accumulated_points);
         }
         print_board(&game_board);
+        rng_state = game_board.rng_state;
+        int game_points = total_points(&game_board);
         unload_level(&game_board);
 
         if (!end_game && level_completed) {
             if (next_level(&level_manager) == 0) {
+                // Passou o último nível
+                if (scores_enabled) scores_add(NULL, game_points);
                 end_game = true;
             }
         } else {
             end_game = true;
         }
+
+        if (end_game && soak_enabled && !soak.done) {
+            // O jogo acabou antes do tempo do soak: recomeça do primeiro nível
+            level_manager.current_level = 0;
+            for (int p = 0; p < MAX_PACMANS; p++)
+                accumulated_points[p] = 0;
+            free_backup_memory();
+            soak.games++;
+            end_game = false;
+        }
     }    
 
+    level_watch_close();
+    if (scores_enabled) scores_close();
+
+    // Espera pelo último autosave; a paragem do jogo em cada um foi só o fork()
+    autosave_finish();
+    autosave_stats_t autosaves = autosave_stats();
+    if (autosaves.started > 0) {
+        char summary[256];
+        snprintf(summary, sizeof(summary),
+                 "AUTOSAVE %lu started, %lu done, %lu failed, %lu skipped | fork stall mean %.3f ms, max %.3f ms | reaped after %.1f ms\n",
+                 autosaves.started, autosaves.done, autosaves.failed, autosaves.skipped,
+                 autosaves.stall_ms / autosaves.started, autosaves.stall_max_ms,
+                 autosaves.write_ms / (autosaves.done + autosaves.failed > 0 ? autosaves.done + autosaves.failed : 1));
+        if (soak_enabled) fputs(summary, stderr);
+        else debug("%s", summary);
+    }
+    checkpoint_free();
+    autopilot_free();
+    renderer_stop();
     terminal_cleanup();
 
-    close_debug_file();
+    // Histograma da latência tecla->frame, depois de o terminal voltar ao normal
+    latency_report(stderr);
+    latency_close();
+
+    if (spectators_enabled)
+        spectator_close();
+    trace_close();
+
+    if (soak_enabled)
+        soak_report("SOAK END", now_ms() / 1000);
+    else
+        close_debug_file();
 
     return 0;
 }
@@ -0,0 +1,122 @@
+#include "latency.h"
+#include <string.h>
+#include <time.h>
+
+static double pending_key = 0;      // simulation thread
+
+// Render thread
+static latency_histogram_t total;
+static double stage_sums[4];        // play, queue, draw, refresh
+static FILE* stream = NULL;
+
+// Helper private function: bucket of a value in microseconds
+static int bucket_of(double us) {
+    unsigned long v = us < 1 ? 0 : (unsigned long)us;
+    if (v < (1ul << LATENCY_SUB_BITS)) return (int)v;
+    int exponent = 63 - __builtin_clzl(v);
+    int sub = (int)((v >> (exponent - LATENCY_SUB_BITS)) & ((1ul << LATENCY_SUB_BITS) - 1));
+    int bucket = ((exponent - LATENCY_SUB_BITS + 1) << LATENCY_SUB_BITS) + sub;
+    return bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1;
+}
+
+// Helper private function: smallest value of a bucket
+static double bucket_floor(int bucket) {
+    if (bucket < (1 << LATENCY_SUB_BITS)) return bucket;
+    int exponent = (bucket >> LATENCY_SUB_BITS) + LATENCY_SUB_BITS - 1;
+    int sub = bucket & ((1 << LATENCY_SUB_BITS) - 1);
+    return (double)((1ul << exponent) + ((unsigned long)sub << (exponent - LATENCY_SUB_BITS)));
+}
+
+void latency_histogram_add(latency_histogram_t* histogram, double us) {
+    histogram->counts[bucket_of(us)]++;
+    histogram->n++;
+    histogram->sum_us += us;
+    if (us > histogram->max_us) histogram->max_us = us;
+}
+
+double latency_histogram_percentile(const latency_histogram_t* histogram, double fraction) {
+    if (histogram->n == 0) return 0;
+    unsigned long wanted = (unsigned long)(fraction * histogram->n);
+    if (wanted >= histogram->n) wanted = histogram->n - 1;
+    unsigned long seen = 0;
+    for (int b = 0; b < LATENCY_BUCKETS; b++) {
+        seen += histogram->counts[b];
+        if (seen > wanted) {
+            // Upper end of the bucket, never past the largest value seen
+            double top = b + 1 < LATENCY_BUCKETS ? bucket_floor(b + 1) : histogram->max_us;
+            return top < histogram->max_us ? top : histogram->max_us;
+        }
+    }
+    return histogram->max_us;
+}
+
+void latency_histogram_print(const latency_histogram_t* histogram, FILE* out, const char* title) {
+    if (histogram->n == 0) return;
+    fprintf(out, "%s: %lu samples | mean %.2f ms | p50 %.2f ms | p90 %.2f ms | p99 %.2f ms | max %.2f ms\n", title,
+            histogram->n, histogram->sum_us / histogram->n / 1e3, latency_histogram_percentile(histogram, 0.5) / 1e3,
+            latency_histogram_percentile(histogram, 0.9) / 1e3, latency_histogram_percentile(histogram, 0.99) / 1e3,
+            histogram->max_us / 1e3);
+
+    // One line per power of two, the finer buckets are only used for the percentiles
+    unsigned long most = 0;
+    unsigned long rows[LATENCY_BUCKETS >> LATENCY_SUB_BITS] = {0};
+    for (int b = 0; b < LATENCY_BUCKETS; b++) {
+        rows[b >> LATENCY_SUB_BITS] += histogram->counts[b];
+        if (rows[b >> LATENCY_SUB_BITS] > most) most = rows[b >> LATENCY_SUB_BITS];
+    }
+    for (int r = 0; r < LATENCY_BUCKETS >> LATENCY_SUB_BITS; r++) {
+        if (rows[r] == 0) continue;
+        double low = bucket_floor(r << LATENCY_SUB_BITS);
+        char bar[41];
+        int width = (int)(40 * rows[r] / most);
+        memset(bar, '#', width);
+        bar[width] = '\0';
+        fprintf(out, "  >= %9.3f ms %8lu %s\n", low / 1e3, rows[r], bar);
+    }
+}
+
+int latency_open(const char* path) {
+    latency_close();
+    stream = fopen(path, "w");
+    if (!stream) return -1;
+    fprintf(stream, "# total_us play_us queue_us draw_us refresh_us\n");
+    return 0;
+}
+
+double latency_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+void latency_key(void) {
+    if (pending_key == 0) pending_key = latency_now_us();
+}
+
+double latency_take_key(void) {
+    double key = pending_key;
+    pending_key = 0;
+    return key;
+}
+
+void latency_frame(double key_us, double published_us, double draw_us, double drawn_us, double shown_us) {
+    double stages[4] = {published_us - key_us, draw_us - published_us, drawn_us - draw_us, shown_us - drawn_us};
+    for (int s = 0; s < 4; s++)
+        stage_sums[s] += stages[s];
+    latency_histogram_add(&total, shown_us - key_us);
+    if (stream)
+        fprintf(stream, "%.1f %.1f %.1f %.1f %.1f\n", shown_us - key_us, stages[0], stages[1], stages[2], stages[3]);
+}
+
+void latency_report(FILE* out) {
+    if (total.n == 0) return;
+    latency_histogram_print(&total, out, "Key to frame");
+    fprintf(out, "  mean per stage: play %.3f ms | queue %.3f ms | draw_board %.3f ms | refresh_screen %.3f ms\n",
+            stage_sums[0] / total.n / 1e3, stage_sums[1] / total.n / 1e3, stage_sums[2] / total.n / 1e3,
+            stage_sums[3] / total.n / 1e3);
+}
+
+void latency_close(void) {
+    if (stream) fclose(stream);
+    stream = NULL;
+}
@@ -0,0 +1,112 @@
+#include "memstats.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#ifdef __APPLE__
+#include <malloc/malloc.h>
+#define usable_size(ptr) malloc_size(ptr)
+#else
+#include <malloc.h>
+#define usable_size(ptr) malloc_usable_size(ptr)
+#endif
+
+static const char* names[MEM_SUBSYSTEMS] = {"level", "agents", "backups", "logging", "autopilot", "display", "scores", "observations"};
+
+static _Atomic long live[MEM_SUBSYSTEMS];
+static _Atomic long peak[MEM_SUBSYSTEMS];
+static _Atomic long allocs[MEM_SUBSYSTEMS];
+static _Atomic long frees[MEM_SUBSYSTEMS];
+
+// Helper private function: 'bytes' more in 'subsystem', the peak follows
+static void count_in(mem_subsystem_t subsystem, long bytes) {
+    long now = atomic_fetch_add_explicit(&live[subsystem], bytes, memory_order_relaxed) + bytes;
+    long high = atomic_load_explicit(&peak[subsystem], memory_order_relaxed);
+    while (now > high && !atomic_compare_exchange_weak_explicit(&peak[subsystem], &high, now,
+                                                                memory_order_relaxed, memory_order_relaxed)) {
+    }
+    atomic_fetch_add_explicit(&allocs[subsystem], 1, memory_order_relaxed);
+}
+
+// Helper private function: 'bytes' given back by 'subsystem'
+static void count_out(mem_subsystem_t subsystem, long bytes) {
+    atomic_fetch_sub_explicit(&live[subsystem], bytes, memory_order_relaxed);
+    atomic_fetch_add_explicit(&frees[subsystem], 1, memory_order_relaxed);
+}
+
+void* mem_malloc(mem_subsystem_t subsystem, size_t size) {
+    void* ptr = malloc(size);
+    if (ptr) count_in(subsystem, (long)usable_size(ptr));
+    return ptr;
+}
+
+void* mem_calloc(mem_subsystem_t subsystem, size_t n, size_t size) {
+    void* ptr = calloc(n, size);
+    if (ptr) count_in(subsystem, (long)usable_size(ptr));
+    return ptr;
+}
+
+void* mem_realloc(mem_subsystem_t subsystem, void* ptr, size_t size) {
+    long old_size = ptr ? (long)usable_size(ptr) : 0;
+    void* grown = realloc(ptr, size);
+    if (!grown) return NULL; // the old block is still there
+    if (ptr) count_out(subsystem, old_size);
+    count_in(subsystem, (long)usable_size(grown));
+    return grown;
+}
+
+void mem_free(mem_subsystem_t subsystem, void* ptr) {
+    if (!ptr) return;
+    count_out(subsystem, (long)usable_size(ptr));
+    free(ptr);
+}
+
+void mem_mapped(mem_subsystem_t subsystem, long bytes) {
+    if (bytes >= 0)
+        count_in(subsystem, bytes);
+    else
+        count_out(subsystem, -bytes);
+}
+
+mem_stats_t mem_stats(mem_subsystem_t subsystem) {
+    mem_stats_t stats;
+    stats.bytes = atomic_load_explicit(&live[subsystem], memory_order_relaxed);
+    stats.peak = atomic_load_explicit(&peak[subsystem], memory_order_relaxed);
+    stats.allocs = atomic_load_explicit(&allocs[subsystem], memory_order_relaxed);
+    stats.frees = atomic_load_explicit(&frees[subsystem], memory_order_relaxed);
+    return stats;
+}
+
+const char* mem_subsystem_name(mem_subsystem_t subsystem) {
+    return (subsystem >= 0 && subsystem < MEM_SUBSYSTEMS) ? names[subsystem] : "?";
+}
+
+long mem_resident_bytes(void) {
+    long size = 0, resident = 0;
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (!statm) return 0;
+    if (fscanf(statm, "%ld %ld", &size, &resident) != 2) resident = 0;
+    fclose(statm);
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+long mem_heap_bytes(void) {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 info = mallinfo2();
+    return (long)(info.uordblks + info.hblkhd);
+#else
+    return -1;
+#endif
+}
+
+void mem_format(char* out, size_t size) {
+    size_t used = 0;
+    out[0] = '\0';
+    for (int s = 0; s < MEM_SUBSYSTEMS && used < size; s++) {
+        mem_stats_t stats = mem_stats(s);
+        int n = snprintf(out + used, size - used, "%s%s %ld/%ld KB", s > 0 ? "  " : "", names[s],
+                         stats.bytes >> 10, stats.peak >> 10);
+        if (n < 0) break;
+        used += (size_t)n;
+    }
+}
@@ -0,0 +1,190 @@
+#include "pacmanist.h"
+#include "session.h"
+#include "memstats.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct pm_game {
+    session_t session;
+    char path[MAX_FILENAME];
+    unsigned char* planes;  // PM_PLANES planes of width * height bytes
+    size_t planes_size;     // bytes allocated for planes
+    int width, height;
+    int* drawn;             // cell each pacman, then each ghost, was drawn on (-1 if none)
+    int n_drawn;
+    int n_drawn_pacmans;    // the first n_drawn_pacmans entries of drawn are pacmans
+};
+
+// Helper private function: the byte of (x, y) in a plane
+static inline unsigned char* plane_at(pm_game_t* game, int plane, int cell) {
+    return &game->planes[(size_t)plane * game->width * game->height + cell];
+}
+
+// Helper private function to draw the pacmans and ghosts on their planes, remembering where
+static void draw_agents(pm_game_t* game) {
+    board_t* board = &game->session.board;
+    for (int p = 0; p < board->n_pacmans; p++) {
+        pacman_t* pac = &board->pacmans[p];
+        int cell = pac->pos_y * game->width + pac->pos_x;
+        // The pacman ate the dot of the cell it entered, even if a ghost caught it there afterwards
+        *plane_at(game, PM_PLANE_DOTS, cell) = board->board[board_index(board, pac->pos_x, pac->pos_y)].has_dot;
+        game->drawn[p] = -1;
+        if (!pac->alive) continue;
+        *plane_at(game, PM_PLANE_PACMANS, cell) = (unsigned char)(p + 1);
+        game->drawn[p] = cell;
+    }
+    for (int i = 0; i < board->n_ghosts; i++) {
+        ghost_t* ghost = &board->ghosts[i];
+        int cell = ghost->pos_y * game->width + ghost->pos_x;
+        *plane_at(game, PM_PLANE_GHOSTS, cell) = ghost->charged ? 2 : 1;
+        game->drawn[board->n_pacmans + i] = cell;
+    }
+}
+
+// Helper private function to clear the agents from the cells they were drawn on
+static void erase_agents(pm_game_t* game) {
+    for (int a = 0; a < game->n_drawn; a++) {
+        if (game->drawn[a] < 0) continue;
+        *plane_at(game, a < game->n_drawn_pacmans ? PM_PLANE_PACMANS : PM_PLANE_GHOSTS, game->drawn[a]) = 0;
+    }
+}
+
+// Helper private function for a game left without a level (the next one could not be loaded):
+// every plane is cleared and nothing is drawn any more
+static void clear_planes(pm_game_t* game) {
+    if (game->planes) memset(game->planes, 0, game->planes_size);
+    game->n_drawn = 0;
+    game->n_drawn_pacmans = 0;
+}
+
+// Helper private function to fill every plane from the board of the current level
+static int build_planes(pm_game_t* game) {
+    board_t* board = &game->session.board;
+    game->width = board->width;
+    game->height = board->height;
+    size_t size = (size_t)PM_PLANES * board->width * board->height;
+    if (size > game->planes_size) {
+        unsigned char* planes = mem_realloc(MEM_OBSERVATIONS, game->planes, size);
+        if (!planes) {
+            debug("Error: no memory for the observation of %s\n", board->level_name);
+            return -1;
+        }
+        game->planes = planes;
+        game->planes_size = size;
+    }
+    int n_drawn = board->n_pacmans + board->n_ghosts;
+    int* drawn = mem_realloc(MEM_OBSERVATIONS, game->drawn, (n_drawn > 0 ? n_drawn : 1) * sizeof(int));
+    if (!drawn) {
+        debug("Error: no memory for the observation of %s\n", board->level_name);
+        return -1;
+    }
+    game->drawn = drawn;
+    game->n_drawn = n_drawn;
+    game->n_drawn_pacmans = board->n_pacmans;
+
+    memset(game->planes, 0, size);
+    for (int y = 0; y < board->height; y++) {
+        for (int x = 0; x < board->width; x++) {
+            board_pos_t* pos = &board->board[board_index(board, x, y)];
+            int cell = y * board->width + x;
+            *plane_at(game, PM_PLANE_WALLS, cell) = pos->content == 'W' && !pos->has_portal;
+            *plane_at(game, PM_PLANE_DOTS, cell) = pos->has_dot;
+            *plane_at(game, PM_PLANE_PORTAL, cell) = pos->has_portal;
+        }
+    }
+    draw_agents(game);
+    return 0;
+}
+
+// Helper private function: the lives left of every pacman of the level
+static int total_lives(board_t* board) {
+    int lives = 0;
+    for (int p = 0; p < board->n_pacmans; p++)
+        lives += board->pacmans[p].lives;
+    return lives;
+}
+
+// Helper private function: the points of every pacman over the game
+static int game_points(session_t* session) {
+    int points = 0;
+    for (int p = 0; p < MAX_PACMANS; p++)
+        points += session->accumulated_points[p];
+    return points;
+}
+
+pm_game_t* pm_create(const char* path, unsigned int seed) {
+    pm_game_t* game = mem_calloc(MEM_OBSERVATIONS, 1, sizeof(pm_game_t));
+    if (!game) return NULL;
+    strncpy(game->path, path, MAX_FILENAME - 1);
+    if (session_start(&game->session, game->path, seed) != 0 || build_planes(game) != 0) {
+        pm_free(game);
+        return NULL;
+    }
+    return game;
+}
+
+int pm_reset(pm_game_t* game, unsigned int seed) {
+    session_end(&game->session);
+    if (session_start(&game->session, game->path, seed) != 0) {
+        game->session.state = SESSION_OVER; // pm_step must not play on the empty board
+        clear_planes(game);
+        return -1;
+    }
+    return build_planes(game);
+}
+
+int pm_step(pm_game_t* game, const char* actions, pm_step_t* step) {
+    session_t* session = &game->session;
+    memset(step, 0, sizeof(*step));
+    if (session->state != SESSION_PLAYING) {
+        step->done = session->state == SESSION_WON ? PM_WON : PM_LOST;
+        return -1;
+    }
+
+    int points = game_points(session);
+    int lives = total_lives(&session->board);
+    session_step_each(session, actions);
+
+    step->reward = game_points(session) - points;
+    step->level_changed = session->level_changed;
+    if (session->state == SESSION_WON)
+        step->done = PM_WON;
+    else if (session->state == SESSION_OVER)
+        step->done = PM_LOST;
+
+    if (!session->board.board) {
+        // The portal was reached but the next level failed to load: the game ends there
+        debug("Error: level %d of %s could not be loaded, the game is over\n", session->levels.current_level,
+              game->path);
+        clear_planes(game);
+        return -1;
+    }
+    if (step->level_changed) {
+        // Lives are read from the files of the new level
+        if (build_planes(game) != 0)
+            return -1;
+    } else {
+        step->lives_lost = lives - total_lives(&session->board);
+        erase_agents(game);
+        draw_agents(game);
+    }
+    return 0;
+}
+
+int pm_pacmans(const pm_game_t* game) {
+    return game->session.board.n_pacmans;
+}
+
+const unsigned char* pm_observation(const pm_game_t* game, int* width, int* height) {
+    if (width) *width = game->width;
+    if (height) *height = game->height;
+    return game->planes;
+}
+
+void pm_free(pm_game_t* game) {
+    if (!game) return;
+    session_end(&game->session);
+    mem_free(MEM_OBSERVATIONS, game->planes);
+    mem_free(MEM_OBSERVATIONS, game->drawn);
+    mem_free(MEM_OBSERVATIONS, game);
+}
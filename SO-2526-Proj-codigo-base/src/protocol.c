@@ -0,0 +1,92 @@
+#include "protocol.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+// Helper private function to make room for 'size' more bytes, dropping consumed ones first
+static int reserve(proto_buffer_t* buffer, size_t size) {
+    if (buffer->start > 0 && buffer->start == buffer->size) {
+        buffer->start = 0;
+        buffer->size = 0;
+    }
+    if (buffer->size + size <= buffer->capacity) return 0;
+
+    if (buffer->start > 0) {
+        memmove(buffer->data, buffer->data + buffer->start, buffer->size - buffer->start);
+        buffer->size -= buffer->start;
+        buffer->start = 0;
+        if (buffer->size + size <= buffer->capacity) return 0;
+    }
+
+    size_t capacity = buffer->capacity ? buffer->capacity : 256;
+    while (capacity < buffer->size + size) capacity *= 2;
+    unsigned char* data = realloc(buffer->data, capacity);
+    if (!data) return -1;
+    buffer->data = data;
+    buffer->capacity = capacity;
+    return 0;
+}
+
+int proto_put_header(proto_buffer_t* buffer, char type, uint32_t length) {
+    if (reserve(buffer, PROTO_HEADER_SIZE) != 0) return -1;
+    buffer->data[buffer->size] = type;
+    memcpy(buffer->data + buffer->size + 1, &length, sizeof(length));
+    buffer->size += PROTO_HEADER_SIZE;
+    return 0;
+}
+
+int proto_put(proto_buffer_t* buffer, const void* bytes, size_t size) {
+    if (reserve(buffer, size) != 0) return -1;
+    memcpy(buffer->data + buffer->size, bytes, size);
+    buffer->size += size;
+    return 0;
+}
+
+int proto_flush(int fd, proto_buffer_t* buffer) {
+    while (buffer->start < buffer->size) {
+        ssize_t n = write(fd, buffer->data + buffer->start, buffer->size - buffer->start);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        buffer->start += n;
+    }
+    buffer->start = 0;
+    buffer->size = 0;
+    return 1;
+}
+
+int proto_receive(int fd, proto_buffer_t* buffer) {
+    while (1) {
+        if (reserve(buffer, 4096) != 0) return -1;
+        ssize_t n = read(fd, buffer->data + buffer->size, buffer->capacity - buffer->size);
+        if (n == 0) return 0;
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 1;
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        buffer->size += n;
+    }
+}
+
+int proto_next(proto_buffer_t* buffer, char* type, const unsigned char** payload, uint32_t* length) {
+    size_t available = buffer->size - buffer->start;
+    if (available < PROTO_HEADER_SIZE) return 0;
+
+    unsigned char* header = buffer->data + buffer->start;
+    memcpy(length, header + 1, sizeof(*length));
+    if (available < PROTO_HEADER_SIZE + (size_t)*length) return 0;
+
+    *type = header[0];
+    *payload = header + PROTO_HEADER_SIZE;
+    buffer->start += PROTO_HEADER_SIZE + *length;
+    return 1;
+}
+
+void proto_free(proto_buffer_t* buffer) {
+    free(buffer->data);
+    memset(buffer, 0, sizeof(*buffer));
+}
@@ -0,0 +1,233 @@
+#include "renderer.h"
+#include "display.h"
+#include "memstats.h"
+#include "latency.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Triple buffer: the simulation fills 'back', the render thread draws 'front'
+// and 'middle' holds the newest frame not yet taken by the render thread
+static frame_t frames[3];
+static int back = 0, middle = 1, front = 2;
+static bool middle_fresh = false;
+static bool running = false;
+
+static render_stats_t stats;
+static pthread_t render_thread;
+static pthread_mutex_t swap_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t swap_cond = PTHREAD_COND_INITIALIZER;
+
+// ncurses is not thread safe: drawing and reading keys never overlap
+static pthread_mutex_t screen_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Helper private function to grow an array to hold at least 'count' elements
+static void* ensure_capacity(void* ptr, int* capacity, int count, size_t elem_size) {
+    if (count <= *capacity) return ptr;
+    mem_free(MEM_DISPLAY, ptr);
+    *capacity = count;
+    ptr = mem_malloc(MEM_DISPLAY, (size_t)count * elem_size);
+    if (!ptr) exit(1);
+    return ptr;
+}
+
+// Helper private function to copy the cells into a frame: the whole board when it is small,
+// otherwise the window of tiles around the first pacman alive, the one the viewport follows
+static void copy_cells(frame_t* frame, board_t* board) {
+    int tiles_x = board->tiles_x > 0 ? board->tiles_x : 1;
+    int tiles_y = (int)(board_storage_cells(board->width, board->height) / TILE_CELLS / tiles_x);
+    int x0 = 0, y0 = 0, x1 = tiles_x, y1 = tiles_y;
+
+    if (tiles_x > RENDER_WINDOW_TILES_X || tiles_y > RENDER_WINDOW_TILES_Y) {
+        pacman_t* followed = board->n_pacmans > 0 ? &board->pacmans[0] : NULL;
+        for (int p = 0; p < board->n_pacmans; p++) {
+            if (board->pacmans[p].alive) {
+                followed = &board->pacmans[p];
+                break;
+            }
+        }
+        int center_x = followed ? followed->pos_x >> TILE_SHIFT : 0;
+        int center_y = followed ? followed->pos_y >> TILE_SHIFT : 0;
+        if (tiles_x > RENDER_WINDOW_TILES_X) {
+            x0 = center_x - RENDER_WINDOW_TILES_X / 2;
+            if (x0 > tiles_x - RENDER_WINDOW_TILES_X) x0 = tiles_x - RENDER_WINDOW_TILES_X;
+            if (x0 < 0) x0 = 0;
+            x1 = x0 + RENDER_WINDOW_TILES_X;
+        }
+        if (tiles_y > RENDER_WINDOW_TILES_Y) {
+            y0 = center_y - RENDER_WINDOW_TILES_Y / 2;
+            if (y0 > tiles_y - RENDER_WINDOW_TILES_Y) y0 = tiles_y - RENDER_WINDOW_TILES_Y;
+            if (y0 < 0) y0 = 0;
+            y1 = y0 + RENDER_WINDOW_TILES_Y;
+        }
+    }
+
+    // Tiles that left the window give their memory back, only the window stays resident
+    for (int y = frame->window_y0; y < frame->window_y1; y++) {
+        for (int x = frame->window_x0; x < frame->window_x1; x++) {
+            if (x < x0 || x >= x1 || y < y0 || y >= y1)
+                board_drop_tiles(&frame->board, (long)y * tiles_x + x, 1);
+        }
+    }
+    frame->window_x0 = x0;
+    frame->window_y0 = y0;
+    frame->window_x1 = x1;
+    frame->window_y1 = y1;
+
+    // The tiles of a row of the window are contiguous
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++)
+            board_touch(board, x << TILE_SHIFT, y << TILE_SHIFT);
+        long first = ((long)y * tiles_x + x0) * TILE_CELLS;
+        memcpy(frame->board.board + first, board->board + first, (size_t)(x1 - x0) * TILE_CELLS * sizeof(board_pos_t));
+    }
+}
+
+// Helper private function to take a snapshot of the board into a frame
+static void copy_frame(frame_t* frame, board_t* board, int mode) {
+    board_t old = frame->board;
+
+    frame->board = *board;
+    frame->board.stream = NULL; // the copy is only read
+    frame->mode = mode;
+
+    if (old.board && old.width == board->width && old.height == board->height) {
+        frame->board.board = old.board;
+    } else {
+        board_free_cells(&old);
+        if (board_alloc_cells(&frame->board) != 0) exit(1);
+        frame->window_x0 = frame->window_y0 = frame->window_x1 = frame->window_y1 = 0;
+    }
+    frame->board.pacmans = ensure_capacity(old.pacmans, &frame->pacmans_capacity, board->n_pacmans, sizeof(pacman_t));
+    frame->board.ghosts = ensure_capacity(old.ghosts, &frame->ghosts_capacity, board->n_ghosts, sizeof(ghost_t));
+
+    copy_cells(frame, board);
+    memcpy(frame->board.pacmans, board->pacmans, board->n_pacmans * sizeof(pacman_t));
+    memcpy(frame->board.ghosts, board->ghosts, board->n_ghosts * sizeof(ghost_t));
+}
+
+// Helper private function to draw the front frame, closing the latency sample of the key it shows
+static void draw_frame(frame_t* frame) {
+    pthread_mutex_lock(&screen_mutex);
+    double draw_us = frame->key_us > 0 ? latency_now_us() : 0;
+    draw_board(&frame->board, frame->mode);
+    double drawn_us = frame->key_us > 0 ? latency_now_us() : 0;
+    refresh_screen();
+    pthread_mutex_unlock(&screen_mutex);
+    if (frame->key_us > 0) {
+        latency_frame(frame->key_us, frame->published_us, draw_us, drawn_us, latency_now_us());
+        frame->key_us = 0;
+    }
+}
+
+static void* render_loop(void* arg) {
+    (void)arg;
+
+    pthread_mutex_lock(&swap_mutex);
+    while (true) {
+        while (!middle_fresh && running)
+            pthread_cond_wait(&swap_cond, &swap_mutex);
+
+        if (!middle_fresh) break; // stopped and nothing left to draw
+
+        // Take the newest frame
+        int taken = middle;
+        middle = front;
+        front = taken;
+        middle_fresh = false;
+        pthread_mutex_unlock(&swap_mutex);
+
+        draw_frame(&frames[front]);
+
+        pthread_mutex_lock(&swap_mutex);
+        stats.drawn++;
+    }
+    pthread_mutex_unlock(&swap_mutex);
+
+    return NULL;
+}
+
+int renderer_start() {
+    memset(frames, 0, sizeof(frames));
+    memset(&stats, 0, sizeof(stats));
+    back = 0;
+    middle = 1;
+    front = 2;
+    middle_fresh = false;
+    running = true;
+
+    if (pthread_create(&render_thread, NULL, render_loop, NULL) != 0) {
+        debug("Error: Could not create render thread\n");
+        running = false;
+        return -1;
+    }
+    return 0;
+}
+
+void renderer_publish(board_t* board, int mode) {
+    // The back buffer belongs to the simulation, it can be filled without locking
+    copy_frame(&frames[back], board, mode);
+    frames[back].key_us = latency_take_key();
+    frames[back].published_us = latency_now_us();
+
+    pthread_mutex_lock(&swap_mutex);
+    if (middle_fresh) {
+        // The undrawn frame is dropped: the key it was to show is shown by this one
+        stats.dropped++;
+        double dropped_key = frames[middle].key_us;
+        if (dropped_key > 0 && (frames[back].key_us == 0 || dropped_key < frames[back].key_us))
+            frames[back].key_us = dropped_key;
+    }
+    int published = back;
+    back = middle;
+    middle = published;
+    middle_fresh = true;
+    stats.published++;
+    pthread_cond_signal(&swap_cond);
+    pthread_mutex_unlock(&swap_mutex);
+}
+
+char renderer_poll_input() {
+    pthread_mutex_lock(&screen_mutex);
+    char c = get_input();
+    pthread_mutex_unlock(&screen_mutex);
+    if (c != '\0')
+        latency_key();
+    return c;
+}
+
+char renderer_get_input() {
+    while (true) {
+        char c = renderer_poll_input();
+        if (c != '\0')
+            return c;
+        sleep_ms(5);
+    }
+}
+
+void renderer_stop() {
+    pthread_mutex_lock(&swap_mutex);
+    running = false;
+    pthread_cond_signal(&swap_cond);
+    pthread_mutex_unlock(&swap_mutex);
+
+    pthread_join(render_thread, NULL);
+
+    debug("RENDER frames published: %lu drawn: %lu dropped: %lu\n",
+          stats.published, stats.drawn, stats.dropped);
+
+    for (int i = 0; i < 3; i++) {
+        board_free_cells(&frames[i].board);
+        mem_free(MEM_DISPLAY, frames[i].board.pacmans);
+        mem_free(MEM_DISPLAY, frames[i].board.ghosts);
+    }
+    memset(frames, 0, sizeof(frames));
+}
+
+render_stats_t renderer_stats() {
+    pthread_mutex_lock(&swap_mutex);
+    render_stats_t copy = stats;
+    pthread_mutex_unlock(&swap_mutex);
+    return copy;
+}
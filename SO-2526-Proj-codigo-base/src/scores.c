@@ -0,0 +1,283 @@
+#define _DEFAULT_SOURCE // flock
+#include "scores.h"
+#include "board.h"
+#include "memstats.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static int log_fd = -1;
+static char index_path[MAX_FILENAME + 8];
+
+// Index in memory: entries sorted by level name, the first one ("") is whole games
+static score_entry_t* entries = NULL;
+static int n_entries = 0, capacity = 0;
+static uint64_t folded = 0;     // bytes of the log folded into the entries
+
+// Helper private function: the level name as it is kept in records and entries
+static void make_key(char* key, const char* level) {
+    snprintf(key, SCORES_NAME, "%s", level ? level : "");
+}
+
+// Helper private function: position of 'key' in the entries, or where it would go (*found = 0)
+static int search(const char* key, int* found) {
+    int lo = 0, hi = n_entries;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        int cmp = strcmp(entries[mid].level, key);
+        if (cmp == 0) {
+            *found = 1;
+            return mid;
+        }
+        if (cmp < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    *found = 0;
+    return lo;
+}
+
+// Helper private function: the entry of 'key', added when it is new, NULL on error
+static score_entry_t* entry_for(const char* key) {
+    int found;
+    int at = search(key, &found);
+    if (found) return &entries[at];
+    if (n_entries == capacity) {
+        int grown = capacity ? capacity * 2 : 64;
+        score_entry_t* bigger = mem_realloc(MEM_SCORES, entries, grown * sizeof(score_entry_t));
+        if (!bigger) return NULL;
+        entries = bigger;
+        capacity = grown;
+    }
+    memmove(&entries[at + 1], &entries[at], (n_entries - at) * sizeof(score_entry_t));
+    n_entries++;
+    memset(&entries[at], 0, sizeof(score_entry_t));
+    memcpy(entries[at].level, key, SCORES_NAME);
+    return &entries[at];
+}
+
+// Helper private function to put the points of one record in the top of its entry
+static void fold_record(const score_record_t* record) {
+    char key[SCORES_NAME];
+    memcpy(key, record->level, SCORES_NAME);
+    key[SCORES_NAME - 1] = '\0';
+    score_entry_t* entry = entry_for(key);
+    if (!entry) return;
+
+    int kept = entry->count < SCORES_TOP ? entry->count : SCORES_TOP;
+    entry->count++;
+    int at = kept;
+    while (at > 0 && entry->top[at - 1] < record->points) at--;
+    if (at == SCORES_TOP) return; // not among the best
+    int moved = (kept < SCORES_TOP ? kept : SCORES_TOP - 1) - at;
+    memmove(&entry->top[at + 1], &entry->top[at], moved * sizeof(int32_t));
+    entry->top[at] = record->points;
+}
+
+// Helper private function to tell a whole record from the start of one cut by a crash and whatever follows it:
+// records are written zeroed, so the level name ends in zeros and 'reserved' is 0
+static int valid_record(const score_record_t* record) {
+    if (memcmp(record->magic, SCORE_RECORD_MAGIC, 4) != 0 || record->reserved != 0 || record->pid <= 0)
+        return 0;
+    const char* end = memchr(record->level, '\0', SCORES_NAME);
+    if (!end) return 0;
+    for (const char* at = end; at < record->level + SCORES_NAME; at++) {
+        if (*at != '\0') return 0;
+    }
+    return 1;
+}
+
+// Helper private function to fold the records appended after 'folded', read through a mapping of the tail
+// A record cut by a crash is skipped by looking for the next whole one, byte by byte
+static void fold_log(void) {
+    struct stat st;
+    if (log_fd < 0 || fstat(log_fd, &st) != 0 || (uint64_t)st.st_size < folded + sizeof(score_record_t))
+        return;
+
+    uint64_t page = sysconf(_SC_PAGESIZE);
+    uint64_t start = folded & ~(page - 1);
+    size_t length = st.st_size - start;
+    unsigned char* mapped = mmap(NULL, length, PROT_READ, MAP_SHARED, log_fd, start);
+    if (mapped == MAP_FAILED) {
+        debug("Error: Could not map the score log\n");
+        return;
+    }
+    uint64_t offset = folded;
+    while (offset + sizeof(score_record_t) <= (uint64_t)st.st_size) {
+        score_record_t record;
+        memcpy(&record, mapped + (offset - start), sizeof(record));
+        if (!valid_record(&record)) {
+            offset++;
+            continue;
+        }
+        fold_record(&record);
+        offset += sizeof(score_record_t);
+    }
+    munmap(mapped, length);
+    folded = offset;
+}
+
+// Helper private function to read the index file, an index that cannot be read is built again from the log
+static void read_index(void) {
+    n_entries = 0;
+    folded = 0;
+    int fd = open(index_path, O_RDONLY);
+    if (fd < 0) return;
+
+    score_index_header_t header;
+    struct stat st;
+    struct stat log_st;
+    int valid = read(fd, &header, sizeof(header)) == sizeof(header) && memcmp(header.magic, SCORE_INDEX_MAGIC, 4) == 0
+                && header.version == SCORE_INDEX_VERSION && header.top == SCORES_TOP && header.n_levels >= 0
+                && fstat(fd, &st) == 0 && fstat(log_fd, &log_st) == 0 && header.log_offset <= (uint64_t)log_st.st_size
+                && (size_t)st.st_size == sizeof(header) + (size_t)header.n_levels * sizeof(score_entry_t);
+    if (valid && header.n_levels > capacity) {
+        score_entry_t* bigger = mem_realloc(MEM_SCORES, entries, header.n_levels * sizeof(score_entry_t));
+        valid = bigger != NULL;
+        if (bigger) {
+            entries = bigger;
+            capacity = header.n_levels;
+        }
+    }
+    size_t size = (size_t)header.n_levels * sizeof(score_entry_t);
+    if (valid && read(fd, entries, size) == (ssize_t)size) {
+        n_entries = header.n_levels;
+        folded = header.log_offset;
+    } else {
+        debug("Error: %s is not a valid score index, it is built again\n", index_path);
+    }
+    close(fd);
+}
+
+// Helper private function to replace the index file with the index in memory
+static int write_index(void) {
+    char tmp_path[sizeof(index_path) + 16];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%d", index_path, (int)getpid());
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return -1;
+
+    score_index_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SCORE_INDEX_MAGIC, 4);
+    header.version = SCORE_INDEX_VERSION;
+    header.log_offset = folded;
+    header.n_levels = n_entries;
+    header.top = SCORES_TOP;
+    size_t size = (size_t)n_entries * sizeof(score_entry_t);
+    int error = write(fd, &header, sizeof(header)) != sizeof(header) || write(fd, entries, size) != (ssize_t)size;
+    if (close(fd) != 0 || error || rename(tmp_path, index_path) != 0) {
+        unlink(tmp_path);
+        return -1;
+    }
+    return 0;
+}
+
+// Helper private function: offset of the log the index file was built to, 0 if it cannot be read
+static uint64_t index_offset(void) {
+    score_index_header_t header;
+    int fd = open(index_path, O_RDONLY);
+    if (fd < 0) return 0;
+    int ok = read(fd, &header, sizeof(header)) == sizeof(header) && memcmp(header.magic, SCORE_INDEX_MAGIC, 4) == 0;
+    close(fd);
+    return ok ? header.log_offset : 0;
+}
+
+int scores_open(const char* path) {
+    scores_close();
+    log_fd = open(path, O_RDWR | O_APPEND | O_CREAT, 0644);
+    if (log_fd < 0) {
+        debug("Error: Could not open the score log %s\n", path);
+        return -1;
+    }
+    snprintf(index_path, sizeof(index_path), "%s.idx", path);
+
+    // One process at a time reads and replaces the index, appends go on meanwhile
+    flock(log_fd, LOCK_EX);
+    read_index();
+    uint64_t indexed = folded;
+    fold_log();
+    if (!entry_for("")) {
+        flock(log_fd, LOCK_UN);
+        scores_close();
+        return -1;
+    }
+    if (folded > indexed && write_index() != 0)
+        debug("Error: Could not write the score index %s\n", index_path);
+    flock(log_fd, LOCK_UN);
+    debug("SCORES %s: %d levels, %llu bytes of log (%llu new)\n", path, n_entries - 1,
+          (unsigned long long)folded, (unsigned long long)(folded - indexed));
+    return 0;
+}
+
+int scores_add(const char* level, int points) {
+    if (log_fd < 0) return -1;
+    score_record_t record;
+    memset(&record, 0, sizeof(record));
+    memcpy(record.magic, SCORE_RECORD_MAGIC, 4);
+    record.points = points;
+    record.time = (int64_t)time(NULL);
+    record.pid = (int32_t)getpid();
+    make_key(record.level, level);
+
+    // One write with O_APPEND: the record goes whole to the end of the log, whoever else is appending
+    if (write(log_fd, &record, sizeof(record)) != sizeof(record)) {
+        debug("Error: Could not append to the score log\n");
+        return -1;
+    }
+    fold_log();
+    return 0;
+}
+
+void scores_refresh(void) {
+    fold_log();
+}
+
+int scores_best(const char* level) {
+    char key[SCORES_NAME];
+    make_key(key, level);
+    int found;
+    int at = search(key, &found);
+    return (found && entries[at].count > 0) ? entries[at].top[0] : 0;
+}
+
+int scores_top(const char* level, int* points, int k, int* count) {
+    char key[SCORES_NAME];
+    make_key(key, level);
+    int found;
+    int at = search(key, &found);
+    if (count) *count = found ? entries[at].count : 0;
+    if (!found) return 0;
+    int kept = entries[at].count < SCORES_TOP ? entries[at].count : SCORES_TOP;
+    if (k > kept) k = kept;
+    memcpy(points, entries[at].top, k * sizeof(int));
+    return k;
+}
+
+int scores_levels(void) {
+    return n_entries > 0 ? n_entries - 1 : 0;
+}
+
+const score_entry_t* scores_entry(int i) {
+    return (i >= 0 && i < n_entries) ? &entries[i] : NULL;
+}
+
+void scores_close(void) {
+    if (log_fd >= 0) {
+        // The index on disk is only replaced by one built further into the log
+        flock(log_fd, LOCK_EX);
+        fold_log();
+        if (index_offset() < folded && write_index() != 0)
+            debug("Error: Could not write the score index %s\n", index_path);
+        flock(log_fd, LOCK_UN);
+        close(log_fd);
+    }
+    log_fd = -1;
+    mem_free(MEM_SCORES, entries);
+    entries = NULL;
+    n_entries = capacity = 0;
+    folded = 0;
+}
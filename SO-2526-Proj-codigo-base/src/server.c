@@ -0,0 +1,456 @@
+#include "session.h"
+#include "trace.h"
+#include "protocol.h"
+#include "scores.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+
+#define MAX_EVENTS 256
+#define KEY_QUEUE 16                    // keys a client can send ahead of the game
+#define MAX_PENDING_OUTPUT (1 << 20)    // unsent bytes before a client is dropped as too slow
+
+typedef struct client {
+    int fd;
+    session_t session;
+    trace_encoder_t encoder;    // last board sent to this client
+    proto_buffer_t out;         // messages not yet taken by the socket
+    char keys[KEY_QUEUE];
+    int key_head, key_count;
+    double next_play;           // a session plays at most once per tempo (ms)
+    int heap_index;             // position in the timer heap, -1 when not scheduled
+    int waiting_writable;       // EPOLLOUT is armed
+    int dropped;                // closed at the end of the current batch of events
+    struct client* prev;        // connected clients, to close them when the server stops
+    struct client* next;
+} client_t;
+
+// epoll data of the server's own descriptors
+static int listen_tag, timer_tag, signal_tag;
+
+static int epoll_fd = -1;
+static int listen_fd = -1;
+static int timer_fd = -1;
+static const char* level_directory;
+static int scores_ready = 0;    // sessions add their points to SCORES_FILE
+
+// Clients connected and not dropped yet
+static client_t* clients = NULL;
+
+// Clients to free once no event of the current batch can point at them
+static client_t** doomed = NULL;
+static int n_doomed = 0, doomed_capacity = 0;
+
+// Min-heap of the clients with a play due, ordered by next_play
+static client_t** heap = NULL;
+static int heap_size = 0, heap_capacity = 0;
+
+static struct {
+    unsigned long sessions;
+    int active, peak;
+    unsigned long plays;
+    unsigned long bytes;
+    unsigned long dropped;
+} stats;
+
+// Helper function to swap two heap entries keeping their indices up to date
+static void heap_swap(int a, int b) {
+    client_t* tmp = heap[a];
+    heap[a] = heap[b];
+    heap[b] = tmp;
+    heap[a]->heap_index = a;
+    heap[b]->heap_index = b;
+}
+
+static void heap_up(int i) {
+    while (i > 0 && heap[(i - 1) / 2]->next_play > heap[i]->next_play) {
+        heap_swap(i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+static void heap_down(int i) {
+    while (1) {
+        int smallest = i, left = 2 * i + 1, right = 2 * i + 2;
+        if (left < heap_size && heap[left]->next_play < heap[smallest]->next_play) smallest = left;
+        if (right < heap_size && heap[right]->next_play < heap[smallest]->next_play) smallest = right;
+        if (smallest == i) return;
+        heap_swap(i, smallest);
+        i = smallest;
+    }
+}
+
+// Helper function to schedule a client's next play at client->next_play
+static void schedule(client_t* client) {
+    if (client->heap_index >= 0) return;
+    if (heap_size == heap_capacity) {
+        heap_capacity = heap_capacity ? heap_capacity * 2 : 64;
+        heap = realloc(heap, heap_capacity * sizeof(client_t*));
+        if (!heap) exit(1);
+    }
+    client->heap_index = heap_size;
+    heap[heap_size++] = client;
+    heap_up(client->heap_index);
+}
+
+static void unschedule(client_t* client) {
+    int i = client->heap_index;
+    if (i < 0) return;
+    heap_swap(i, heap_size - 1);
+    heap_size--;
+    client->heap_index = -1;
+    if (i < heap_size) {
+        heap_up(i);
+        heap_down(i);
+    }
+}
+
+// Helper function to arm the timer for the earliest scheduled play
+static void arm_timer() {
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    if (heap_size > 0) {
+        double due = heap[0]->next_play;
+        if (due < 0.001) due = 0.001; // a zero value would disarm the timer
+        spec.it_value.tv_sec = (time_t)(due / 1000);
+        spec.it_value.tv_nsec = (long)((due - spec.it_value.tv_sec * 1000.0) * 1e6);
+    }
+    timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, NULL);
+}
+
+// Helper function to disconnect a client, its memory is freed by free_dropped_clients
+static void drop_client(client_t* client) {
+    if (client->dropped) return;
+    client->dropped = 1;
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+    close(client->fd);
+    unschedule(client);
+    stats.active--;
+    if (client->prev) client->prev->next = client->next;
+    else clients = client->next;
+    if (client->next) client->next->prev = client->prev;
+
+    if (n_doomed == doomed_capacity) {
+        doomed_capacity = doomed_capacity ? doomed_capacity * 2 : 64;
+        doomed = realloc(doomed, doomed_capacity * sizeof(client_t*));
+        if (!doomed) exit(1);
+    }
+    doomed[n_doomed++] = client;
+}
+
+static void free_dropped_clients() {
+    for (int i = 0; i < n_doomed; i++) {
+        session_end(&doomed[i]->session);
+        trace_encoder_free(&doomed[i]->encoder);
+        proto_free(&doomed[i]->out);
+        free(doomed[i]);
+    }
+    n_doomed = 0;
+}
+
+// Helper function to send what the socket takes, waiting for EPOLLOUT for the rest
+// Returns -1 if the client must be closed
+static int flush_client(client_t* client) {
+    int result = proto_flush(client->fd, &client->out);
+    if (result < 0) return -1;
+
+    int want_writable = (result == 0);
+    if (want_writable != client->waiting_writable) {
+        struct epoll_event event = {.events = EPOLLIN | (want_writable ? EPOLLOUT : 0), .data.ptr = client};
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, client->fd, &event);
+        client->waiting_writable = want_writable;
+    }
+    return 0;
+}
+
+// Helper function to queue the board of a session as a frame (with the level name on a new level)
+// Returns -1 if the client must be closed
+static int send_frame(client_t* client) {
+    board_t* board = &client->session.board;
+    if (client->session.level_changed || !client->encoder.last.cells) {
+        proto_put_header(&client->out, PROTO_MSG_LEVEL, sizeof(board->level_name));
+        proto_put(&client->out, board->level_name, sizeof(board->level_name));
+        trace_encode_keyframe(&client->encoder, board);
+    } else {
+        trace_encode_record(&client->encoder, board);
+    }
+
+    int32_t state = client->session.state;
+    proto_put_header(&client->out, PROTO_MSG_FRAME, sizeof(state) + client->encoder.size);
+    proto_put(&client->out, &state, sizeof(state));
+    if (proto_put(&client->out, client->encoder.data, client->encoder.size) != 0)
+        return -1;
+    stats.bytes += PROTO_HEADER_SIZE + sizeof(state) + client->encoder.size;
+
+    if (client->out.size - client->out.start > MAX_PENDING_OUTPUT) {
+        stats.dropped++;
+        return -1;
+    }
+    return flush_client(client);
+}
+
+// Helper function to set when a session can play again after a play
+// Sessions with no manual pacman play on their own every tempo (at least every ms)
+static void after_play(client_t* client, double now) {
+    int tempo = client->session.board.tempo;
+    client->next_play = now + tempo;
+    if (!client->session.manual && client->session.state == SESSION_PLAYING) {
+        if (tempo <= 0) client->next_play = now + 1;
+        schedule(client);
+    }
+}
+
+// Helper function to play every queued key whose turn has come
+// Returns -1 if the client must be closed
+static int play_keys(client_t* client, double now) {
+    while (client->key_count > 0 && now >= client->next_play
+           && client->session.state == SESSION_PLAYING) {
+        char key = client->keys[client->key_head];
+        client->key_head = (client->key_head + 1) % KEY_QUEUE;
+        client->key_count--;
+
+        if (!session_step(&client->session, key)) continue;
+        stats.plays++;
+        after_play(client, now);
+        if (send_frame(client) != 0) return -1;
+    }
+    if (client->session.manual && client->key_count > 0 && client->session.state == SESSION_PLAYING)
+        schedule(client);
+    return 0;
+}
+
+static void accept_clients() {
+    while (1) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) return; // EAGAIN, or out of descriptors
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+        client_t* client = calloc(1, sizeof(client_t));
+        unsigned int seed = (unsigned int)time(NULL) ^ (unsigned int)(stats.sessions * 2654435761u);
+        if (!client || session_start(&client->session, level_directory, seed) != 0) {
+            fprintf(stderr, "Error: Could not start a session for %s\n", level_directory);
+            free(client);
+            close(fd);
+            continue;
+        }
+        if (scores_ready) session_record_scores(&client->session);
+        client->fd = fd;
+        client->heap_index = -1;
+
+        struct epoll_event event = {.events = EPOLLIN, .data.ptr = client};
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+            session_end(&client->session);
+            free(client);
+            close(fd);
+            continue;
+        }
+        stats.sessions++;
+        if (++stats.active > stats.peak) stats.peak = stats.active;
+        client->next = clients;
+        if (clients) clients->prev = client;
+        clients = client;
+
+        if (send_frame(client) != 0) {
+            drop_client(client);
+            continue;
+        }
+        // A manual session plays the first key right away
+        client->next_play = now_ms();
+        if (!client->session.manual)
+            after_play(client, client->next_play);
+    }
+}
+
+// Helper function to queue the keys sent by a client
+// Returns -1 if the client must be closed
+static int read_keys(client_t* client) {
+    char keys[256];
+    while (1) {
+        ssize_t n = read(client->fd, keys, sizeof(keys));
+        if (n == 0) return -1;
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        for (ssize_t i = 0; i < n; i++) {
+            char key = toupper((unsigned char)keys[i]);
+            if (key == 'Q') {
+                session_step(&client->session, 'Q'); // ends the game, its points are recorded
+                return -1;
+            }
+            if (!client->session.manual || client->key_count == KEY_QUEUE) continue;
+            client->keys[(client->key_head + client->key_count) % KEY_QUEUE] = key;
+            client->key_count++;
+        }
+    }
+    return play_keys(client, now_ms());
+}
+
+// Helper function to run every play that is due
+static void run_due_plays() {
+    uint64_t expirations;
+    if (read(timer_fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN) return;
+
+    double now = now_ms();
+    while (heap_size > 0 && heap[0]->next_play <= now) {
+        client_t* client = heap[0];
+        unschedule(client);
+
+        int result;
+        if (client->session.manual) {
+            result = play_keys(client, now);
+        } else {
+            session_step(&client->session, '\0');
+            stats.plays++;
+            after_play(client, now);
+            result = send_frame(client);
+        }
+        if (result != 0)
+            drop_client(client);
+    }
+}
+
+// Helper function to create the listening socket
+static int open_listen_socket(const char* path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    unlink(path);
+
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+// Hosts any number of game sessions on one epoll loop, one session per connected client
+int main(int argc, char** argv) {
+    const char* socket_path = PROTO_DEFAULT_SOCKET;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:")) != -1) {
+        if (opt == 's') {
+            socket_path = optarg;
+        } else {
+            printf("Usage: %s [-s socket_path] <level_directory>\n", argv[0]);
+            return 1;
+        }
+    }
+    if (argc - optind != 1) {
+        printf("Usage: %s [-s socket_path] <level_directory>\n", argv[0]);
+        return 1;
+    }
+    level_directory = argv[optind];
+
+    // One descriptor per session: use every descriptor the system allows
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    // Clients that leave must not kill the server, SIGINT/SIGTERM are read from a signalfd
+    signal(SIGPIPE, SIG_IGN);
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigprocmask(SIG_BLOCK, &signals, NULL);
+
+    listen_fd = open_listen_socket(socket_path);
+    if (listen_fd < 0) {
+        printf("Error: Could not listen on %s\n", socket_path);
+        return 1;
+    }
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    int signal_fd = signalfd(-1, &signals, SFD_NONBLOCK);
+    epoll_fd = epoll_create1(0);
+    if (timer_fd < 0 || signal_fd < 0 || epoll_fd < 0) {
+        printf("Error: Could not set up the event loop\n");
+        return 1;
+    }
+
+    struct epoll_event event = {.events = EPOLLIN};
+    event.data.ptr = &listen_tag;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &event);
+    event.data.ptr = &timer_tag;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &event);
+    event.data.ptr = &signal_tag;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, signal_fd, &event);
+
+    // Every session adds to the same score log as the games played in a terminal
+    scores_ready = scores_open(SCORES_FILE) == 0;
+    if (!scores_ready)
+        fprintf(stderr, "Error: Could not open %s, scores are not recorded\n", SCORES_FILE);
+
+    printf("Serving %s on %s\n", level_directory, socket_path);
+    fflush(stdout);
+
+    int running = 1;
+    struct epoll_event events[MAX_EVENTS];
+    while (running) {
+        int n = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+        if (n < 0 && errno != EINTR) break;
+
+        for (int i = 0; i < n; i++) {
+            void* tag = events[i].data.ptr;
+            if (tag == &listen_tag) {
+                accept_clients();
+            } else if (tag == &timer_tag) {
+                run_due_plays();
+            } else if (tag == &signal_tag) {
+                running = 0;
+            } else {
+                client_t* client = tag;
+                if (client->dropped) continue;
+                int result = 0;
+                if (events[i].events & (EPOLLERR | EPOLLHUP))
+                    result = -1;
+                if (result == 0 && (events[i].events & EPOLLOUT))
+                    result = flush_client(client);
+                if (result == 0 && (events[i].events & EPOLLIN))
+                    result = read_keys(client);
+                if (result != 0)
+                    drop_client(client);
+            }
+        }
+        free_dropped_clients();
+        arm_timer();
+    }
+
+    printf("Sessions: %lu (peak %d concurrent) | plays: %lu | sent: %lu bytes | dropped slow clients: %lu\n",
+           stats.sessions, stats.peak, stats.plays, stats.bytes, stats.dropped);
+
+    // Sessions still connected end with the server: sockets, boards and buffers
+    while (clients)
+        drop_client(clients);
+    free_dropped_clients();
+
+    if (scores_ready) scores_close();
+    close(listen_fd);
+    unlink(socket_path);
+    close(timer_fd);
+    close(signal_fd);
+    close(epoll_fd);
+    free(heap);
+    free(doomed);
+    return 0;
+}
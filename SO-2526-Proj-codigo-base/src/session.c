@@ -0,0 +1,137 @@
+#include "session.h"
+#include "scores.h"
+#include <string.h>
+
+// Helper private function to find out if any pacman of the level reads keys
+static int has_manual_pacman(board_t* board) {
+    for (int p = 0; p < board->n_pacmans; p++) {
+        if (board->pacmans[p].n_moves == 0)
+            return 1;
+    }
+    return 0;
+}
+
+// Helper private function to load the level the level manager points at
+// On error the board is left empty (no cells, no agents), as after session_end
+static int load_current_level(session_t* session, unsigned int seed) {
+    if (load_level_from_file(&session->board, &session->levels, session->accumulated_points) != 0) {
+        unload_level(&session->board);
+        memset(&session->board, 0, sizeof(session->board));
+        return -1;
+    }
+    if (session->board.stream) {
+        // Clients get keyframes of the whole board, a streamed world does not fit in one
+        debug("Error: %s is a streamed world, it is not served\n", session->board.level_name);
+        unload_level(&session->board);
+        memset(&session->board, 0, sizeof(session->board));
+        return -1;
+    }
+    session->board.rng_state = seed;
+    session->manual = has_manual_pacman(&session->board);
+    session->level_changed = 1;
+    session->level_start_points = total_points(&session->board);
+    if (session->record_scores) {
+        scores_refresh();
+        session->board.best_points = scores_best(session->board.level_name);
+    }
+    return 0;
+}
+
+// Helper private function to add the points of the level that just ended, and of the game if it ended too
+static void record_scores(session_t* session, int game_ended) {
+    if (!session->record_scores) return;
+    int points = total_points(&session->board);
+    scores_add(session->board.level_name, points - session->level_start_points);
+    if (game_ended)
+        scores_add(NULL, points);
+}
+
+int session_start(session_t* session, const char* directory, unsigned int seed) {
+    memset(session, 0, sizeof(*session));
+    if (init_level_manager(&session->levels, directory) != 0)
+        return -1;
+    session->state = SESSION_PLAYING;
+    return load_current_level(session, seed);
+}
+
+// Helper private function for the rest of a step once the pacmans moved: next level, end of the game or ghosts
+static int finish_step(session_t* session, int result) {
+    board_t* board = &session->board;
+    for (int p = 0; p < board->n_pacmans; p++)
+        session->accumulated_points[p] = board->pacmans[p].points;
+
+    if (result == REACHED_PORTAL) {
+        int last = !next_level(&session->levels);
+        record_scores(session, last);
+        if (last) {
+            session->state = SESSION_WON;
+            return 1;
+        }
+        unsigned int seed = board->rng_state;
+        unload_level(board);
+        memset(board, 0, sizeof(*board));
+        if (load_current_level(session, seed) != 0)
+            session->state = SESSION_OVER;
+        return 1;
+    }
+
+    if (result == DEAD_PACMAN) {
+        record_scores(session, 1);
+        session->state = SESSION_OVER;
+        return 1;
+    }
+
+    move_ghosts(board);
+    return 1;
+}
+
+int session_step(session_t* session, char key) {
+    session->level_changed = 0;
+    if (session->state != SESSION_PLAYING)
+        return 0;
+
+    if (key == 'Q') {
+        record_scores(session, 1);
+        session->state = SESSION_OVER;
+        return 1;
+    }
+
+    command_t input = {key, 1, 1};
+    command_t* play = NULL;
+    if (session->manual) {
+        if (key != 'W' && key != 'A' && key != 'S' && key != 'D')
+            return 0;
+        play = &input;
+    }
+
+    return finish_step(session, move_pacmans(&session->board, play));
+}
+
+int session_step_each(session_t* session, const char* keys) {
+    session->level_changed = 0;
+    if (session->state != SESSION_PLAYING)
+        return 0;
+
+    board_t* board = &session->board;
+    command_t inputs[MAX_PACMANS];
+    for (int p = 0; p < board->n_pacmans; p++) {
+        char key = keys ? keys[p] : '\0';
+        if (key != 'W' && key != 'A' && key != 'S' && key != 'D' && key != 'T')
+            key = '\0';
+        inputs[p] = (command_t){key, 1, 1};
+    }
+    return finish_step(session, move_pacmans_each(board, inputs));
+}
+
+void session_record_scores(session_t* session) {
+    session->record_scores = 1;
+    if (session->board.board) {
+        scores_refresh();
+        session->board.best_points = scores_best(session->board.level_name);
+    }
+}
+
+void session_end(session_t* session) {
+    if (session->board.board)
+        unload_level(&session->board);
+}
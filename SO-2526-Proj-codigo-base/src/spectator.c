@@ -0,0 +1,239 @@
+#include "spectator.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static spectator_header_t* header = NULL; // start of the mapped segment
+static size_t mapped_size = 0;            // bytes mapped by this process
+static int shm_fd = -1;
+static char shm_name[MAX_FILENAME];
+
+// Helper private function for the number of bytes a board needs in the segment
+static size_t segment_size(int width, int height, int n_pacmans, int n_ghosts) {
+    return sizeof(spectator_header_t)
+         + (size_t)board_storage_cells(width, height) * sizeof(board_pos_t)
+         + (size_t)(n_pacmans + n_ghosts) * sizeof(spectator_agent_t);
+}
+
+// Helper private function to (re)map 'size' bytes of the segment
+static int map_segment(size_t size, int prot) {
+    if (header) munmap(header, mapped_size);
+    header = mmap(NULL, size, prot, MAP_SHARED, shm_fd, 0);
+    if (header == MAP_FAILED) {
+        header = NULL;
+        mapped_size = 0;
+        return -1;
+    }
+    mapped_size = size;
+    return 0;
+}
+
+int spectator_open(const char* name) {
+    strncpy(shm_name, name, MAX_FILENAME - 1);
+    shm_fd = shm_open(shm_name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (shm_fd < 0) {
+        debug("Error: Could not create shared memory %s\n", shm_name);
+        return -1;
+    }
+
+    size_t size = segment_size(0, 0, 0, 0);
+    if (ftruncate(shm_fd, size) != 0 || map_segment(size, PROT_READ | PROT_WRITE) != 0) {
+        debug("Error: Could not map shared memory %s\n", shm_name);
+        close(shm_fd);
+        shm_unlink(shm_name);
+        shm_fd = -1;
+        return -1;
+    }
+
+    memset(header, 0, size);
+    return 0;
+}
+
+void spectator_publish(board_t* board, int mode) {
+    if (!header || board->stream) return; // a streamed world does not fit in the segment
+
+    size_t needed = segment_size(board->width, board->height, board->n_pacmans, board->n_ghosts);
+    if (needed > mapped_size) {
+        // Growing keeps the header in place, spectators remap on their next read
+        if (ftruncate(shm_fd, needed) != 0 || map_segment(needed, PROT_READ | PROT_WRITE) != 0) {
+            debug("Error: Could not grow shared memory to %zu bytes\n", needed);
+            return;
+        }
+    }
+
+    // Seqlock write side: odd sequence while the frame is being copied
+    unsigned int seq = atomic_load_explicit(&header->seq, memory_order_relaxed);
+    atomic_store_explicit(&header->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    header->width = board->width;
+    header->height = board->height;
+    header->n_pacmans = board->n_pacmans;
+    header->n_ghosts = board->n_ghosts;
+    header->mode = mode;
+    header->tick++;
+    memcpy(header->level_name, board->level_name, sizeof(header->level_name));
+
+    // Cells in the layout of the board, tiles included
+    long n_cells = board_storage_cells(board->width, board->height);
+    board_pos_t* cells = (board_pos_t*)(header + 1);
+    memcpy(cells, board->board, (size_t)n_cells * sizeof(board_pos_t));
+
+    spectator_agent_t* agents = (spectator_agent_t*)(cells + n_cells);
+    for (int p = 0; p < board->n_pacmans; p++) {
+        agents[p].pos_x = board->pacmans[p].pos_x;
+        agents[p].pos_y = board->pacmans[p].pos_y;
+        agents[p].state = board->pacmans[p].alive;
+        agents[p].points = board->pacmans[p].points;
+        agents[p].lives = board->pacmans[p].lives;
+    }
+    agents += board->n_pacmans;
+    for (int g = 0; g < board->n_ghosts; g++) {
+        agents[g].pos_x = board->ghosts[g].pos_x;
+        agents[g].pos_y = board->ghosts[g].pos_y;
+        agents[g].state = board->ghosts[g].charged;
+        agents[g].points = 0;
+        agents[g].lives = 0;
+    }
+
+    atomic_store_explicit(&header->seq, seq + 2, memory_order_release);
+}
+
+void spectator_close() {
+    if (!header) return;
+    atomic_store(&header->closed, 1);
+    munmap(header, mapped_size);
+    header = NULL;
+    mapped_size = 0;
+    close(shm_fd);
+    shm_fd = -1;
+    shm_unlink(shm_name);
+}
+
+int spectator_attach(const char* name) {
+    strncpy(shm_name, name, MAX_FILENAME - 1);
+    shm_fd = shm_open(shm_name, O_RDONLY, 0);
+    if (shm_fd < 0) return -1;
+
+    if (map_segment(sizeof(spectator_header_t), PROT_READ) != 0) {
+        close(shm_fd);
+        shm_fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+// Helper private function to resize the spectator's private copy of the board
+// Returns 0 on success, -1 on error (the board is then left empty)
+static int resize_board(board_t* board, int width, int height, int n_pacmans, int n_ghosts) {
+    if (board->board && board->width == width && board->height == height
+        && board->n_pacmans == n_pacmans && board->n_ghosts == n_ghosts)
+        return 0;
+
+    spectator_free_board(board);
+    board->width = width;
+    board->height = height;
+    board->n_pacmans = n_pacmans;
+    board->n_ghosts = n_ghosts;
+    int error = board_alloc_cells(board);
+    board->pacmans = calloc(n_pacmans > 0 ? n_pacmans : 1, sizeof(pacman_t));
+    board->ghosts = calloc(n_ghosts > 0 ? n_ghosts : 1, sizeof(ghost_t));
+    if (error || !board->board || !board->pacmans || !board->ghosts) {
+        spectator_free_board(board);
+        return -1;
+    }
+    return 0;
+}
+
+// Helper private function: the game started another publish since 'seq' was read
+static int seq_changed(unsigned int seq) {
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&header->seq, memory_order_relaxed) != seq;
+}
+
+int spectator_read(board_t* board, int* mode, int* tick) {
+    if (!header) return -1;
+
+    while (1) {
+        // Seqlock read side: retry until the sequence is even and unchanged around the copy
+        unsigned int seq = atomic_load_explicit(&header->seq, memory_order_acquire);
+        if (seq & 1) {
+            sleep_ms(1);
+            continue;
+        }
+        if (atomic_load(&header->closed)) return -1;
+        if (header->tick == *tick) return 0;
+
+        // The header may be torn by a publish that started meanwhile: values that make no sense
+        // (or a segment too small for them) only count once the sequence shows they were whole
+        int width = header->width, height = header->height;
+        int n_pacmans = header->n_pacmans, n_ghosts = header->n_ghosts;
+        if (width <= 0 || height <= 0 || n_pacmans < 0 || n_ghosts < 0) {
+            if (seq_changed(seq)) continue;
+            return -1;
+        }
+        size_t needed = segment_size(width, height, n_pacmans, n_ghosts);
+        if (needed > mapped_size) {
+            struct stat st;
+            if (fstat(shm_fd, &st) != 0) return -1;
+            if ((size_t)st.st_size < needed) {
+                if (seq_changed(seq)) continue;
+                return -1;
+            }
+            if (map_segment(st.st_size, PROT_READ) != 0) return -1;
+            continue;
+        }
+
+        if (resize_board(board, width, height, n_pacmans, n_ghosts) != 0) {
+            if (seq_changed(seq)) continue;
+            return -1;
+        }
+        int new_tick = header->tick;
+        *mode = header->mode;
+        memcpy(board->level_name, header->level_name, sizeof(board->level_name));
+
+        long n_cells = board_storage_cells(width, height);
+        board_pos_t* cells = (board_pos_t*)(header + 1);
+        memcpy(board->board, cells, (size_t)n_cells * sizeof(board_pos_t));
+
+        spectator_agent_t* agents = (spectator_agent_t*)(cells + n_cells);
+        for (int p = 0; p < n_pacmans; p++) {
+            board->pacmans[p].pos_x = agents[p].pos_x;
+            board->pacmans[p].pos_y = agents[p].pos_y;
+            board->pacmans[p].alive = agents[p].state;
+            board->pacmans[p].points = agents[p].points;
+            board->pacmans[p].lives = agents[p].lives;
+        }
+        agents += n_pacmans;
+        for (int g = 0; g < n_ghosts; g++) {
+            board->ghosts[g].pos_x = agents[g].pos_x;
+            board->ghosts[g].pos_y = agents[g].pos_y;
+            board->ghosts[g].charged = agents[g].state;
+        }
+
+        if (!seq_changed(seq)) {
+            *tick = new_tick;
+            return 1;
+        }
+    }
+}
+
+void spectator_free_board(board_t* board) {
+    board_free_cells(board);
+    free(board->pacmans);
+    free(board->ghosts);
+    board->board = NULL;
+    board->pacmans = NULL;
+    board->ghosts = NULL;
+}
+
+void spectator_detach() {
+    if (header) munmap(header, mapped_size);
+    header = NULL;
+    mapped_size = 0;
+    if (shm_fd >= 0) close(shm_fd);
+    shm_fd = -1;
+}
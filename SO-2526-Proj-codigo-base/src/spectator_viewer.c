@@ -0,0 +1,44 @@
+#include "board.h"
+#include "display.h"
+#include "spectator.h"
+#include <stdio.h>
+#include <string.h>
+
+// Read-only viewer: renders the board published by a running Pacmanist (-s option)
+int main(int argc, char** argv) {
+    if (argc > 2) {
+        printf("Usage: %s [shm_name]\n", argv[0]);
+        return 1;
+    }
+
+    const char* name = (argc == 2) ? argv[1] : SPECTATOR_DEFAULT_NAME;
+    if (spectator_attach(name) != 0) {
+        printf("Error: Could not attach to shared memory %s\n", name);
+        return 1;
+    }
+
+    terminal_init();
+
+    board_t board;
+    memset(&board, 0, sizeof(board));
+    int mode = DRAW_MENU;
+    int tick = 0;
+
+    while (get_input() != 'Q') {
+        int result = spectator_read(&board, &mode, &tick);
+        if (result < 0)
+            break;
+
+        if (result > 0) {
+            draw_board(&board, mode);
+            refresh_screen();
+        }
+        sleep_ms(10);
+    }
+
+    terminal_cleanup();
+    spectator_free_board(&board);
+    spectator_detach();
+
+    return 0;
+}
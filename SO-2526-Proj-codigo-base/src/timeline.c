@@ -0,0 +1,180 @@
+#include "timeline.h"
+#include "memstats.h"
+#include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+static int enabled = 1;
+
+typedef struct {
+    board_t* board;
+    ghost_timeline_t* lines;
+    int from, to;   // ghosts [from, to) precomputed by this worker
+} timeline_worker_t;
+
+// Helper private function: acts taken by a command
+static inline int command_steps(const command_t* command) {
+    return command->command == 'T' ? command->turns : 1;
+}
+
+// Helper private function: only moves and waits with turns can be followed from a table
+static int plain_script(const ghost_t* ghost) {
+    if (ghost->n_moves <= 0 || ghost->charged) return 0;
+    long steps = 0;
+    for (int m = 0; m < ghost->n_moves; m++) {
+        char c = ghost->moves[m].command;
+        if (c == 'T' && ghost->moves[m].turns < 1) return 0;
+        if (c != 'T' && c != 'W' && c != 'A' && c != 'S' && c != 'D') return 0;
+        steps += command_steps(&ghost->moves[m]);
+    }
+    return steps <= INT_MAX / TIMELINE_MAX_CYCLES;
+}
+
+// Helper private function to move (x, y) one cell in 'direction' unless a wall or the edge is in the way
+static int try_move(board_t* board, char direction, int* x, int* y) {
+    int new_x = *x, new_y = *y;
+    switch (direction) {
+        case 'W': new_y--; break;
+        case 'S': new_y++; break;
+        case 'A': new_x--; break;
+        case 'D': new_x++; break;
+        default: return 0;
+    }
+    if (new_x < 0 || new_x >= board->width || new_y < 0 || new_y >= board->height) return 0;
+    if (board->board[board_index(board, new_x, new_y)].content == 'W') return 0;
+    *x = new_x;
+    *y = new_y;
+    return 1;
+}
+
+// Helper private function to play one pass of the script from (x, y), the acts start at 'step'
+// Moves are written to 'events' when it is not NULL, returns the number of moves
+static int play_cycle(board_t* board, const ghost_t* ghost, int* x, int* y, long step, timeline_event_t* events) {
+    int n_events = 0;
+    for (int m = 0; m < ghost->n_moves; m++) {
+        const command_t* command = &ghost->moves[m];
+        if (command->command != 'T' && try_move(board, command->command, x, y)) {
+            if (events) events[n_events] = (timeline_event_t){(int)step, *x, *y};
+            n_events++;
+        }
+        step += command_steps(command);
+    }
+    return n_events;
+}
+
+// Helper private function to precompute the timeline of one ghost
+static void build_line(board_t* board, int ghost_index, ghost_timeline_t* line) {
+    const ghost_t* ghost = &board->ghosts[ghost_index];
+    line->events = NULL;
+    if (!plain_script(ghost)) return;
+
+    // Origin: where the ghost gets to at the start of its script
+    int x = ghost->pos_x, y = ghost->pos_y;
+    int current = ghost->current_move % ghost->n_moves;
+    const command_t* command = &ghost->moves[current];
+    if (current != 0 || command->turns_left != command->turns) {
+        for (int m = current; m < ghost->n_moves; m++) {
+            if (ghost->moves[m].command != 'T')
+                try_move(board, ghost->moves[m].command, &x, &y);
+        }
+    }
+    line->origin_x = x;
+    line->origin_y = y;
+    line->cycle_steps = 0;
+    for (int m = 0; m < ghost->n_moves; m++)
+        line->cycle_steps += command_steps(&ghost->moves[m]);
+
+    // Period: passes of the script until the ghost is back at the origin
+    int n_events = 0, cycles = 0;
+    while (cycles < TIMELINE_MAX_CYCLES) {
+        n_events += play_cycle(board, ghost, &x, &y, 0, NULL);
+        cycles++;
+        if (x == line->origin_x && y == line->origin_y) break;
+    }
+    if (x != line->origin_x || y != line->origin_y) return; // drifts away, stays live
+
+    line->period_steps = cycles * line->cycle_steps;
+    line->n_events = n_events;
+    // A ghost that never moves still gets a timeline: it is never scheduled while following it
+    line->events = mem_malloc(MEM_AGENTS, (n_events > 0 ? n_events : 1) * sizeof(timeline_event_t));
+    if (!line->events) return;
+    n_events = 0;
+    for (int c = 0; c < cycles; c++)
+        n_events += play_cycle(board, ghost, &x, &y, (long)c * line->cycle_steps, line->events + n_events);
+}
+
+static void* build_lines(void* arg) {
+    timeline_worker_t* worker = arg;
+    for (int i = worker->from; i < worker->to; i++)
+        build_line(worker->board, i, &worker->lines[i]);
+    return NULL;
+}
+
+ghost_timeline_t* timeline_build(board_t* board) {
+    // Streamed worlds generate their tiles on the first touch, which the workers cannot do
+    if (!enabled || board->n_ghosts == 0 || board->stream) return NULL;
+    ghost_timeline_t* lines = mem_calloc(MEM_AGENTS, board->n_ghosts, sizeof(ghost_timeline_t));
+    if (!lines) return NULL;
+
+    double start = now_ms();
+    int n_threads = 1;
+    if (board->n_ghosts >= TIMELINE_MIN_PARALLEL) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        n_threads = cpus < 1 ? 1 : (cpus > TIMELINE_MAX_THREADS ? TIMELINE_MAX_THREADS : (int)cpus);
+    }
+
+    // Ghosts are independent: each worker takes a contiguous range, the walls are only read
+    pthread_t threads[TIMELINE_MAX_THREADS];
+    timeline_worker_t workers[TIMELINE_MAX_THREADS];
+    int started[TIMELINE_MAX_THREADS] = {0};
+    for (int t = 0; t < n_threads; t++) {
+        workers[t] = (timeline_worker_t){board, lines,
+                                         (int)((long)board->n_ghosts * t / n_threads),
+                                         (int)((long)board->n_ghosts * (t + 1) / n_threads)};
+    }
+    for (int t = 1; t < n_threads; t++)
+        started[t] = pthread_create(&threads[t], NULL, build_lines, &workers[t]) == 0;
+    build_lines(&workers[0]);
+    for (int t = 1; t < n_threads; t++) {
+        if (started[t])
+            pthread_join(threads[t], NULL);
+        else
+            build_lines(&workers[t]); // the thread could not be started, done here
+    }
+
+    int with_line = 0;
+    long n_events = 0;
+    for (int i = 0; i < board->n_ghosts; i++) {
+        if (!lines[i].events) continue;
+        with_line++;
+        n_events += lines[i].n_events;
+    }
+    debug("TIMELINES %d of %d ghosts, %ld events in %.1f ms (%d threads)\n",
+          with_line, board->n_ghosts, n_events, now_ms() - start, n_threads);
+    return lines;
+}
+
+void timeline_free(ghost_timeline_t* lines, int n) {
+    if (!lines) return;
+    for (int i = 0; i < n; i++)
+        mem_free(MEM_AGENTS, lines[i].events);
+    mem_free(MEM_AGENTS, lines);
+}
+
+void timeline_cursor(const ghost_t* ghost, const ghost_timeline_t* line, long steps, int* moves, int* turns_left) {
+    long laps = steps / line->cycle_steps;
+    long rest = steps % line->cycle_steps;
+    int m = 0;
+    while (rest >= command_steps(&ghost->moves[m])) {
+        rest -= command_steps(&ghost->moves[m]);
+        m++;
+    }
+    *moves = (int)(laps * ghost->n_moves + m);
+    *turns_left = ghost->moves[m].turns - (int)rest;
+}
+
+void timeline_enable(int on) {
+    enabled = on;
+}
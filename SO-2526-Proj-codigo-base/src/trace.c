@@ -0,0 +1,260 @@
+#include "trace.h"
+#include "memstats.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define TRACE_BUFFER_SIZE (1 << 20)
+
+static FILE* trace_file = NULL;
+static trace_encoder_t file_encoder;    // encoder of the trace file
+
+// Helper private function to grow the encoded record of an encoder
+static void reserve_data(trace_encoder_t* encoder, size_t size) {
+    if (size <= encoder->capacity) return;
+    encoder->capacity = size * 2;
+    encoder->data = mem_realloc(MEM_LOGGING, encoder->data, encoder->capacity);
+    if (!encoder->data) exit(1);
+}
+
+// Helper private function to append bytes to the encoded record
+static void put_data(trace_encoder_t* encoder, const void* bytes, size_t size) {
+    reserve_data(encoder, encoder->size + size);
+    memcpy(encoder->data + encoder->size, bytes, size);
+    encoder->size += size;
+}
+
+// Helper private function to take the agents of the board in trace format
+static void snapshot_agent(board_t* board, int index, trace_agent_t* agent) {
+    if (index < board->n_pacmans) {
+        pacman_t* pac = &board->pacmans[index];
+        agent->pos_x = pac->pos_x;
+        agent->pos_y = pac->pos_y;
+        agent->state = pac->alive;
+        agent->points = pac->points;
+        agent->lives = pac->lives;
+    } else {
+        ghost_t* ghost = &board->ghosts[index - board->n_pacmans];
+        agent->pos_x = ghost->pos_x;
+        agent->pos_y = ghost->pos_y;
+        agent->state = ghost->charged;
+        agent->points = 0;
+        agent->lives = 0;
+    }
+}
+
+void trace_encode_keyframe(trace_encoder_t* encoder, board_t* board) {
+    trace_state_t* last = &encoder->last;
+    int total = board->width * board->height;
+    int n_agents = board->n_pacmans + board->n_ghosts;
+
+    trace_free_state(last);
+    last->tick = encoder->tick;
+    last->width = board->width;
+    last->height = board->height;
+    last->n_pacmans = board->n_pacmans;
+    last->n_ghosts = board->n_ghosts;
+    last->cells = mem_malloc(MEM_LOGGING, total > 0 ? total : 1);
+    last->agents = mem_malloc(MEM_LOGGING, (n_agents > 0 ? n_agents : 1) * sizeof(trace_agent_t));
+    if (!last->cells || !last->agents) exit(1);
+
+    // Row-major in the trace, whatever the layout of the board
+    int i = 0;
+    for (int y = 0; y < board->height; y++)
+        for (int x = 0; x < board->width; x++)
+            last->cells[i++] = pack_cell(&board->board[board_index(board, x, y)]);
+    for (int a = 0; a < n_agents; a++)
+        snapshot_agent(board, a, &last->agents[a]);
+
+    int32_t dims[4] = {last->width, last->height, last->n_pacmans, last->n_ghosts};
+    encoder->size = 0;
+    put_data(encoder, "K", 1);
+    put_data(encoder, &encoder->tick, sizeof(encoder->tick));
+    put_data(encoder, dims, sizeof(dims));
+    put_data(encoder, last->cells, total);
+    put_data(encoder, last->agents, n_agents * sizeof(trace_agent_t));
+
+    encoder->last_keyframe = encoder->tick;
+    encoder->tick++;
+}
+
+void trace_encode_record(trace_encoder_t* encoder, board_t* board) {
+    trace_state_t* last = &encoder->last;
+    if (!last->cells || board->width != last->width || board->height != last->height
+        || board->n_pacmans != last->n_pacmans || board->n_ghosts != last->n_ghosts
+        || encoder->tick - encoder->last_keyframe >= TRACE_KEYFRAME_INTERVAL) {
+        trace_encode_keyframe(encoder, board);
+        return;
+    }
+
+    int n_agents = board->n_pacmans + board->n_ghosts;
+    uint32_t n_cells = 0, n_changed_agents = 0;
+
+    // The counts are filled in once the changes are known
+    encoder->size = 0;
+    put_data(encoder, "D", 1);
+    size_t counts_offset = encoder->size;
+    uint32_t counts[3] = {encoder->tick, 0, 0};
+    put_data(encoder, counts, sizeof(counts));
+
+    // Changed cells: uint32 row-major index + packed cell
+    uint32_t i = 0;
+    for (int y = 0; y < board->height; y++) {
+        for (int x = 0; x < board->width; x++, i++) {
+            unsigned char packed = pack_cell(&board->board[board_index(board, x, y)]);
+            if (packed == last->cells[i]) continue;
+
+            last->cells[i] = packed;
+            put_data(encoder, &i, sizeof(i));
+            put_data(encoder, &packed, 1);
+            n_cells++;
+        }
+    }
+
+    // Changed agents: uint32 index + agent
+    for (int a = 0; a < n_agents; a++) {
+        trace_agent_t agent;
+        snapshot_agent(board, a, &agent);
+        if (memcmp(&agent, &last->agents[a], sizeof(agent)) == 0) continue;
+
+        last->agents[a] = agent;
+        uint32_t index = a;
+        put_data(encoder, &index, sizeof(index));
+        put_data(encoder, &agent, sizeof(agent));
+        n_changed_agents++;
+    }
+
+    counts[1] = n_cells;
+    counts[2] = n_changed_agents;
+    memcpy(encoder->data + counts_offset, counts, sizeof(counts));
+
+    encoder->tick++;
+}
+
+void trace_encoder_free(trace_encoder_t* encoder) {
+    trace_free_state(&encoder->last);
+    mem_free(MEM_LOGGING, encoder->data);
+    encoder->data = NULL;
+    encoder->size = 0;
+    encoder->capacity = 0;
+}
+
+int trace_open(const char* filename) {
+    trace_file = fopen(filename, "wb");
+    if (!trace_file) {
+        debug("Error: Could not open trace file %s\n", filename);
+        return -1;
+    }
+    setvbuf(trace_file, NULL, _IOFBF, TRACE_BUFFER_SIZE);
+
+    uint32_t version = TRACE_VERSION;
+    fwrite(TRACE_MAGIC, 1, 4, trace_file);
+    fwrite(&version, sizeof(version), 1, trace_file);
+
+    memset(&file_encoder, 0, sizeof(file_encoder));
+    return 0;
+}
+
+void trace_begin_level(board_t* board) {
+    if (!trace_file) return;
+    if (board->stream) {
+        debug("TRACE skipped: %s is a streamed world\n", board->level_name);
+        return;
+    }
+    trace_encode_keyframe(&file_encoder, board);
+    fwrite(file_encoder.data, 1, file_encoder.size, trace_file);
+}
+
+void trace_record(board_t* board) {
+    if (!trace_file || board->stream) return;
+    trace_encode_record(&file_encoder, board);
+    fwrite(file_encoder.data, 1, file_encoder.size, trace_file);
+}
+
+void trace_close() {
+    if (!trace_file) return;
+    fclose(trace_file);
+    trace_file = NULL;
+    trace_encoder_free(&file_encoder);
+}
+
+int trace_read_header(FILE* file) {
+    char magic[4];
+    uint32_t version;
+    if (fread(magic, 1, 4, file) != 4 || memcmp(magic, TRACE_MAGIC, 4) != 0)
+        return -1;
+    if (fread(&version, sizeof(version), 1, file) != 1 || version != TRACE_VERSION)
+        return -1;
+    return 0;
+}
+
+// Helper private function to read a keyframe into the state
+static int read_keyframe(FILE* file, trace_state_t* state) {
+    int32_t dims[4];
+    uint32_t frame_tick;
+    if (fread(&frame_tick, sizeof(frame_tick), 1, file) != 1 || fread(dims, sizeof(dims), 1, file) != 1)
+        return -1;
+    if (dims[0] < 0 || dims[1] < 0 || dims[2] < 0 || dims[3] < 0)
+        return -1;
+
+    size_t total = (size_t)dims[0] * dims[1];
+    int n_agents = dims[2] + dims[3];
+
+    trace_free_state(state);
+    state->tick = frame_tick;
+    state->width = dims[0];
+    state->height = dims[1];
+    state->n_pacmans = dims[2];
+    state->n_ghosts = dims[3];
+    state->cells = mem_malloc(MEM_LOGGING, total > 0 ? total : 1);
+    state->agents = mem_malloc(MEM_LOGGING, (n_agents > 0 ? n_agents : 1) * sizeof(trace_agent_t));
+    if (!state->cells || !state->agents) return -1;
+
+    if (fread(state->cells, 1, total, file) != total
+        || fread(state->agents, sizeof(trace_agent_t), n_agents, file) != (size_t)n_agents)
+        return -1;
+    return 1;
+}
+
+// Helper private function to apply a delta to the state
+static int read_delta(FILE* file, trace_state_t* state) {
+    uint32_t counts[3];
+    if (fread(counts, sizeof(counts), 1, file) != 1 || !state->cells)
+        return -1;
+
+    uint32_t total = state->width * state->height;
+    uint32_t n_agents = state->n_pacmans + state->n_ghosts;
+
+    for (uint32_t c = 0; c < counts[1]; c++) {
+        uint32_t index;
+        unsigned char packed;
+        if (fread(&index, sizeof(index), 1, file) != 1 || fread(&packed, 1, 1, file) != 1 || index >= total)
+            return -1;
+        state->cells[index] = packed;
+    }
+    for (uint32_t a = 0; a < counts[2]; a++) {
+        uint32_t index;
+        trace_agent_t agent;
+        if (fread(&index, sizeof(index), 1, file) != 1 || fread(&agent, sizeof(agent), 1, file) != 1
+            || index >= n_agents)
+            return -1;
+        state->agents[index] = agent;
+    }
+
+    state->tick = counts[0];
+    return 1;
+}
+
+int trace_read_record(FILE* file, trace_state_t* state) {
+    int type = fgetc(file);
+    if (type == EOF) return 0;
+    if (type == 'K') return read_keyframe(file, state);
+    if (type == 'D') return read_delta(file, state);
+    return -1;
+}
+
+void trace_free_state(trace_state_t* state) {
+    mem_free(MEM_LOGGING, state->cells);
+    mem_free(MEM_LOGGING, state->agents);
+    state->cells = NULL;
+    state->agents = NULL;
+}
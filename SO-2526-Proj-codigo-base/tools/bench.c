@@ -0,0 +1,795 @@
+#include "board.h"
+#include "display.h"
+#include "timeline.h"
+#include "memstats.h"
+#include "file_loader.h"
+#include "autopilot.h"
+#include "pacmanist.h"
+#include "scores.h"
+#include "game_backup.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+// Helper function for a monotonic clock in nanoseconds
+static double now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Helper function to build an open board with a border of walls and a dot in every free cell
+static void build_board(board_t* board, int width, int height, int n_pacmans, int n_ghosts) {
+    memset(board, 0, sizeof(*board));
+    board->width = width;
+    board->height = height;
+    board->n_pacmans = n_pacmans;
+    board->n_ghosts = n_ghosts;
+    board_alloc_cells(board);
+    board->pacmans = mem_calloc(MEM_AGENTS, n_pacmans, sizeof(pacman_t));
+    if (!board->board || !board->pacmans || allocate_ghosts(board, n_ghosts) != 0) exit(1);
+    snprintf(board->level_name, sizeof(board->level_name), "bench");
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            board_pos_t* pos = &board->board[board_index(board, x, y)];
+            if (x == 0 || y == 0 || x == width - 1 || y == height - 1) {
+                pos->content = 'W';
+            } else {
+                pos->content = ' ';
+                pos->has_dot = 1;
+            }
+        }
+    }
+}
+
+// Helper function to place an agent on a free cell, scanning from a random position
+static void place(board_t* board, int* pos_x, int* pos_y, char content) {
+    long total = (long)board->width * board->height;
+    long cell = rand() % total;
+    while (board->board[board_index(board, cell % board->width, cell / board->width)].content != ' ')
+        cell = (cell + 1) % total;
+    *pos_x = cell % board->width;
+    *pos_y = cell / board->width;
+    board->board[board_index(board, *pos_x, *pos_y)].content = content;
+}
+
+// Helper function to add pacmans and ghosts that move randomly
+static void add_agents(board_t* board) {
+    for (int p = 0; p < board->n_pacmans; p++) {
+        pacman_t* pac = &board->pacmans[p];
+        place(board, &pac->pos_x, &pac->pos_y, 'P');
+        pac->start_x = pac->pos_x;
+        pac->start_y = pac->pos_y;
+        pac->alive = 1;
+        pac->lives = 1 << 30; // never leave the game
+        pac->n_moves = 1;
+        pac->moves[0] = (command_t){'R', 1, 1};
+    }
+    for (int g = 0; g < board->n_ghosts; g++) {
+        ghost_t* ghost = &board->ghosts[g];
+        place(board, &ghost->pos_x, &ghost->pos_y, 'M');
+        ghost->n_moves = 1;
+        ghost->moves[0] = (command_t){'R', 1, 1};
+    }
+}
+
+// Helper function for one play as in game.c: pacmans first, then every ghost
+static void play(board_t* board) {
+    move_pacmans(board, NULL);
+    move_ghosts(board);
+}
+
+// Helper function to give every ghost a patrol script with waits and a random passo
+static void add_patrols(board_t* board) {
+    const char directions[] = {'W', 'A', 'S', 'D'};
+    for (int g = 0; g < board->n_ghosts; g++) {
+        ghost_t* ghost = &board->ghosts[g];
+        ghost->passo = rand() % 4;
+        board->ghost_waiting[g] = ghost->passo;
+        ghost->n_moves = 4 + rand() % (MAX_MOVES - 4);
+        for (int m = 0; m < ghost->n_moves; m++) {
+            if (rand() % 4 == 0) {
+                int turns = 1 + rand() % 8;
+                ghost->moves[m] = (command_t){'T', turns, turns};
+            } else {
+                ghost->moves[m] = (command_t){directions[rand() % 4], 1, 1};
+            }
+        }
+    }
+}
+
+// Time per play as the number of pacmans grows
+static void bench_pacmans(int ticks) {
+    printf("%-10s %-10s %-14s\n", "pacmans", "ghosts", "ns/play");
+    for (int n = 1; n <= 4096; n *= 4) {
+        board_t board;
+        build_board(&board, 256, 256, n, 32);
+        add_agents(&board);
+
+        double start = now_ns();
+        for (int t = 0; t < ticks; t++)
+            play(&board);
+        double elapsed = now_ns() - start;
+
+        printf("%-10d %-10d %-14.0f\n", n, board.n_ghosts, elapsed / ticks);
+        unload_level(&board);
+    }
+}
+
+// Time per play with 100000 ghosts as they act less often: large passo values and long 'T' waits
+// Only the ghosts due in a play are visited, so the cost follows the ghosts that act
+static void bench_sparse(int ticks) {
+    int n = 100000;
+    int side = 2;
+    while ((side - 2) * (side - 2) < n * 8) side++;
+
+    printf("%-10s %-10s %-14s %-10s\n", "max passo", "max T", "ns/play", "ns/ghost");
+    for (int slow = 1; slow <= 256; slow *= 16) {
+        board_t board;
+        build_board(&board, side, side, 1, n);
+        add_agents(&board);
+        board.pacmans[0].n_moves = 0; // stands still
+
+        const char directions[] = {'W', 'A', 'S', 'D'};
+        for (int g = 0; g < n; g++) {
+            ghost_t* ghost = &board.ghosts[g];
+            ghost->passo = rand() % slow;
+            board.ghost_waiting[g] = ghost->passo;
+            ghost->n_moves = 4;
+            for (int m = 0; m < 4; m++) {
+                int turns = 1 + rand() % (4 * slow);
+                ghost->moves[m] = (m % 2) ? (command_t){'T', turns, turns} : (command_t){directions[rand() % 4], 1, 1};
+            }
+        }
+
+        double start = now_ns();
+        for (int t = 0; t < ticks; t++)
+            play(&board);
+        double elapsed = now_ns() - start;
+
+        printf("%-10d %-10d %-14.0f %-10.2f\n", slow - 1, 4 * slow, elapsed / ticks, elapsed / ticks / n);
+        unload_level(&board);
+    }
+}
+
+// Time per play with ghosts patrolling closed loops, simulated live and then from precomputed timelines
+// (about one ghost per 32 cells, so most of them are never in each other's way)
+static void bench_patrol(int ticks) {
+    const char* loops[] = {"DDSSAAWW", "DSAW", "WWTSS", "ADTDA"};
+    printf("%-10s %-10s %-14s %-14s %-10s\n", "ghosts", "timelines", "ns/play", "ns/ghost", "following");
+    for (int n = 1000; n <= 100000; n *= 10) {
+        for (int on = 0; on <= 1; on++) {
+            int side = 2;
+            while ((side - 2) * (side - 2) < n * 32) side++;
+
+            srand(n);
+            board_t board;
+            build_board(&board, side, side, 1, n);
+            add_agents(&board);
+            board.pacmans[0].n_moves = 0; // stands still
+            for (int g = 0; g < n; g++) {
+                ghost_t* ghost = &board.ghosts[g];
+                const char* loop = loops[rand() % 4];
+                ghost->passo = rand() % 2;
+                board.ghost_waiting[g] = ghost->passo;
+                ghost->n_moves = strlen(loop);
+                for (int m = 0; m < ghost->n_moves; m++) {
+                    int turns = loop[m] == 'T' ? 1 + rand() % 4 : 1;
+                    ghost->moves[m] = (command_t){loop[m], turns, turns};
+                }
+            }
+
+            timeline_enable(on);
+            play(&board); // timelines are precomputed in the first play
+            double start = now_ns();
+            for (int t = 0; t < ticks; t++)
+                play(&board);
+            double elapsed = now_ns() - start;
+
+            int following = 0;
+            for (int g = 0; on && g < n; g++)
+                following += board.wheel->lines[g].following;
+            printf("%-10d %-10s %-14.0f %-14.1f %-10d\n", n, on ? "on" : "off", elapsed / ticks,
+                   elapsed / ticks / n, following);
+            unload_level(&board);
+        }
+    }
+    timeline_enable(1);
+}
+
+// Time per play with many scripted ghosts (about one ghost per 8 cells)
+static void bench_ghosts(int ticks) {
+    printf("%-10s %-12s %-14s %-10s\n", "ghosts", "board", "ns/play", "ns/ghost");
+    for (int n = 1000; n <= 100000; n *= 10) {
+        int side = 2;
+        while ((side - 2) * (side - 2) < n * 8) side++;
+
+        board_t board;
+        build_board(&board, side, side, 1, n);
+        add_agents(&board);
+        add_patrols(&board);
+        board.pacmans[0].n_moves = 0; // stands still
+
+        double start = now_ns();
+        for (int t = 0; t < ticks; t++)
+            play(&board);
+        double elapsed = now_ns() - start;
+
+        printf("%-10d %4dx%-7d %-14.0f %-10.1f\n", n, side, side, elapsed / ticks, elapsed / ticks / n);
+        unload_level(&board);
+    }
+}
+
+// Frames per second of every display backend while the agents move on a terminal-sized board
+// The frames go to stdout and the results to stderr: run with stdout sent to a terminal or /dev/null
+static void bench_render(int ticks) {
+    const char* backends[] = {"ncurses", "ansi", "null"};
+    double fps[3];
+    for (int b = 0; b < 3; b++) {
+        board_t board;
+        build_board(&board, 60, 20, 1, 16);
+        add_agents(&board);
+        display_select(backends[b]);
+
+        terminal_init();
+        for (int t = 0; t < ticks; t++) {
+            play(&board);
+            draw_board(&board, DRAW_MENU);
+            refresh_screen();
+        }
+        terminal_cleanup();
+
+        display_stats_t stats = display_stats();
+        fps[b] = stats.draw_ms > 0 ? stats.frames * 1000.0 / stats.draw_ms : 0;
+        unload_level(&board);
+    }
+
+    fprintf(stderr, "%-10s %-14s\n", "display", "frames/s");
+    for (int b = 0; b < 3; b++)
+        fprintf(stderr, "%-10s %-14.0f\n", backends[b], fps[b]);
+}
+
+// Time per frame as the board grows past the terminal: only the viewport is drawn, so it should stay flat
+// Uses the ansi backend, run with stdout sent to a terminal or /dev/null, the results go to stderr
+static void bench_viewport(int ticks) {
+    int sides[] = {64, 1000, 10000};
+    double us[3];
+    display_select("ansi");
+    for (int s = 0; s < 3; s++) {
+        board_t board;
+        build_board(&board, sides[s], sides[s], 1, 16);
+        add_agents(&board);
+
+        terminal_init();
+        for (int t = 0; t < ticks; t++) {
+            play(&board);
+            draw_board(&board, DRAW_MENU);
+            refresh_screen();
+        }
+        terminal_cleanup();
+
+        display_stats_t stats = display_stats();
+        us[s] = stats.frames > 0 ? stats.draw_ms * 1000.0 / stats.frames : 0;
+        unload_level(&board);
+    }
+
+    fprintf(stderr, "%-14s %-14s\n", "board", "us/frame");
+    for (int s = 0; s < 3; s++)
+        fprintf(stderr, "%5dx%-8d %-14.1f\n", sides[s], sides[s], us[s]);
+}
+
+// Time the autopilot takes per play, with more and more patrolling ghosts (one per 32 cells),
+// and how well it plays: dots eaten and lives lost
+static void bench_autopilot(int ticks) {
+    printf("%-10s %-12s %-14s %-14s %-10s %-10s\n", "ghosts", "board", "ms/play", "max ms/play", "points", "deaths");
+    for (int n = 100; n <= 10000; n *= 10) {
+        int side = 2;
+        while ((side - 2) * (side - 2) < n * 32) side++;
+
+        srand(n);
+        board_t board;
+        build_board(&board, side, side, 1, n);
+        add_agents(&board);
+        add_patrols(&board);
+        pacman_t* pac = &board.pacmans[0];
+        pac->n_moves = 0; // played by the autopilot
+        if (autopilot_reset(&board) != 0) exit(1);
+
+        double planning = 0, slowest = 0;
+        for (int t = 0; t < ticks; t++) {
+            double start = now_ns();
+            command_t input = {autopilot_next(&board), 1, 1};
+            double elapsed = now_ns() - start;
+            planning += elapsed;
+            if (elapsed > slowest) slowest = elapsed;
+            move_pacmans(&board, &input);
+            move_ghosts(&board);
+        }
+
+        printf("%-10d %4dx%-7d %-14.3f %-14.3f %-10d %-10d\n", n, side, side, planning / ticks / 1e6,
+               slowest / 1e6, pac->points, (1 << 30) - pac->lives);
+        autopilot_free();
+        unload_level(&board);
+    }
+}
+
+// Helper function for the resident memory of the process in MB
+static double resident_mb() {
+    long size = 0, resident = 0;
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (statm) {
+        if (fscanf(statm, "%ld %ld", &size, &resident) != 2) resident = 0;
+        fclose(statm);
+    }
+    return resident * (double)sysconf(_SC_PAGESIZE) / (1 << 20);
+}
+
+// Time per play of a manual pacman walking on a corridor of a streamed 100000x100000 world, by how
+// often it crosses into another tile and whether that tile is resident, evicted or never generated,
+// and the resident memory once the walk is over
+static void bench_tiles(int ticks) {
+    struct {
+        const char* name;
+        int start_x;    // on row 1, a corridor of the generated world
+        int span;       // cells walked right before turning back
+    } walks[] = {
+        {"inside", 8, 1},                   // two cells of the same tile
+        {"resident", TILE_SIDE - 1, 1},     // across a tile boundary, both tiles stay resident
+        {"evicted", 1, 64 * TILE_SIDE},     // back over tiles evicted since the last pass
+        {"new", 1, 1 << 30},                // a new tile every TILE_SIDE plays
+    };
+    int side = 100000;
+    double inside_ns = 0;
+
+    printf("%-10s %-10s %-12s %-14s %-10s %-10s %-10s\n",
+           "walk", "ns/play", "crossings", "ns/crossing", "generated", "resident", "RSS MB");
+    for (int w = 0; w < 4; w++) {
+        board_t board;
+        memset(&board, 0, sizeof(board));
+        board.width = board.height = side;
+        board.n_pacmans = 1;
+        board.pacmans = mem_calloc(MEM_AGENTS, 1, sizeof(pacman_t));
+        if (board_stream_cells(&board, 1) != 0 || !board.pacmans || allocate_ghosts(&board, 0) != 0) {
+            printf("Could not map a streamed world (TMPDIR or /var/tmp)\n");
+            exit(1);
+        }
+        snprintf(board.level_name, sizeof(board.level_name), "bench");
+        pacman_t* pac = &board.pacmans[0];
+        pac->pos_x = pac->start_x = walks[w].start_x;
+        pac->pos_y = pac->start_y = 1;
+        pac->alive = 1;
+        pac->lives = 1 << 30;
+        board_touch(&board, pac->pos_x, pac->pos_y);
+        board.board[board_index(&board, pac->pos_x, pac->pos_y)].content = 'P';
+
+        long crossings = 0;
+        double start = now_ns();
+        for (int t = 0; t < ticks; t++) {
+            command_t command = {((t / walks[w].span) % 2) ? 'A' : 'D', 1, 1};
+            int tile = pac->pos_x >> TILE_SHIFT;
+            move_pacmans(&board, &command);
+            move_ghosts(&board);
+            crossings += (pac->pos_x >> TILE_SHIFT) != tile;
+        }
+        double elapsed = now_ns() - start;
+
+        if (w == 0) inside_ns = elapsed / ticks;
+        long generated, resident;
+        stream_stats(&board, &generated, &resident);
+        printf("%-10s %-10.0f %-12ld %-14.0f %-10ld %-10ld %-10.1f\n", walks[w].name, elapsed / ticks, crossings,
+               crossings > 0 ? (elapsed - inside_ns * ticks) / crossings : 0, generated, resident, resident_mb());
+        unload_level(&board);
+    }
+    printf("(the whole board would take %.0f MB)\n",
+           board_storage_cells(side, side) * (double)sizeof(board_pos_t) / (1 << 20));
+}
+
+// Helper function to drop the cached pages of a file, so the next read goes to the disk
+static void drop_cache(const char* directory, const char* name) {
+    char path[MAX_FILENAME * 2];
+    snprintf(path, sizeof(path), "%s/%s", directory, name);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return;
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+// Time to load a level as its number of ghost files grows, with one loader thread and with the
+// default pool, from a cold page cache (every file dropped with posix_fadvise) and from a warm one
+static void bench_load(int n_max) {
+    char directory[] = "/var/tmp/pacmanist-load-XXXXXX";
+    if (!mkdtemp(directory)) {
+        printf("Could not create a directory in /var/tmp\n");
+        exit(1);
+    }
+
+    printf("%-10s %-10s %-12s %-12s\n", "ghosts", "threads", "cold ms", "warm ms");
+    for (int n = 100; n <= n_max; n *= 10) {
+        // One ghost per row of the board, each with its own patrol file
+        char path[MAX_FILENAME * 2];
+        snprintf(path, sizeof(path), "%s/a.lvl", directory);
+        FILE* level = fopen(path, "w");
+        if (!level) exit(1);
+        int side = n + 2;
+        fprintf(level, "DIM %d %d\nTEMPO 10\nMON", side, 8);
+        for (int g = 0; g < n; g++) {
+            char name[32];
+            snprintf(name, sizeof(name), "g%d.m", g);
+            fprintf(level, " %s", name);
+            snprintf(path, sizeof(path), "%s/%s", directory, name);
+            FILE* ghost = fopen(path, "w");
+            if (!ghost) exit(1);
+            fprintf(ghost, "# ghost %d\nPASSO %d\nPOS %d %d\nD\nD\nT 3\nA\nA\nR\nC\nT 1\n", g, g % 3, g + 1, 1 + g % 5);
+            fclose(ghost);
+        }
+        fprintf(level, "\n");
+        for (int y = 0; y < side; y++) {
+            for (int x = 0; x < 8; x++)
+                fputc((y == 0 || x == 0 || y == side - 1 || x == 7) ? 'X' : 'o', level);
+            fputc('\n', level);
+        }
+        fclose(level);
+
+        for (int threads = 1; threads <= LOADER_MAX_THREADS; threads *= LOADER_MAX_THREADS) {
+            double ms[2];
+            for (int warm = 0; warm <= 1; warm++) {
+                if (!warm) {
+                    drop_cache(directory, "a.lvl");
+                    for (int g = 0; g < n; g++) {
+                        char name[32];
+                        snprintf(name, sizeof(name), "g%d.m", g);
+                        drop_cache(directory, name);
+                    }
+                }
+                level_manager_t manager;
+                int points[MAX_PACMANS] = {0};
+                board_t board;
+                memset(&board, 0, sizeof(board));
+                loader_set_threads(threads);
+                if (init_level_manager(&manager, directory) != 0) exit(1);
+                double start = now_ns();
+                if (load_level_from_file(&board, &manager, points) != 0) exit(1);
+                ms[warm] = (now_ns() - start) / 1e6;
+                unload_level(&board);
+            }
+            printf("%-10d %-10d %-12.1f %-12.1f\n", n, threads, ms[0], ms[1]);
+        }
+
+        for (int g = 0; g < n; g++) {
+            snprintf(path, sizeof(path), "%s/g%d.m", directory, g);
+            unlink(path);
+        }
+    }
+    char level_path[MAX_FILENAME * 2];
+    snprintf(level_path, sizeof(level_path), "%s/a.lvl", directory);
+    unlink(level_path);
+    rmdir(directory);
+    loader_set_threads(LOADER_MAX_THREADS);
+}
+
+// Load time, time per play and time per frame (ansi backend) of every level of a directory,
+// e.g. the sets written by LevelGen. Run with stdout sent to a terminal or /dev/null, the results go to stderr
+static void bench_level(int ticks, const char* directory) {
+    level_manager_t manager;
+    if (init_level_manager(&manager, directory) != 0) {
+        printf("Could not read the levels of %s\n", directory);
+        exit(1);
+    }
+    display_select("ansi");
+
+    fprintf(stderr, "%-16s %-14s %-10s %-10s %-10s %-12s %-12s\n", "level", "board", "ghosts", "load ms", "plays",
+            "us/play", "us/frame");
+    for (; manager.current_level < manager.n_levels; manager.current_level++) {
+        int points[MAX_PACMANS] = {0};
+        board_t board;
+        memset(&board, 0, sizeof(board));
+        double start = now_ns();
+        if (load_level_from_file(&board, &manager, points) != 0) exit(1);
+        double load_ms = (now_ns() - start) / 1e6;
+        board.rng_state = 1;
+
+        // Pacmans played with the keys stay in place, the ghosts keep moving after the last pacman
+        // dies so they are still measured, only the portal ends the level early
+        double playing = 0;
+        int plays = 0;
+        terminal_init();
+        for (; plays < ticks; plays++) {
+            start = now_ns();
+            int result = move_pacmans(&board, NULL);
+            if (result != REACHED_PORTAL) move_ghosts(&board);
+            playing += now_ns() - start;
+            draw_board(&board, DRAW_MENU);
+            refresh_screen();
+            if (result == REACHED_PORTAL) break;
+        }
+        terminal_cleanup();
+
+        display_stats_t stats = display_stats();
+        char size[32];
+        snprintf(size, sizeof(size), "%dx%d", board.width, board.height);
+        fprintf(stderr, "%-16s %-14s %-10d %-10.1f %-10d %-12.2f %-12.1f\n", board.level_name, size, board.n_ghosts,
+                load_ms, plays, plays > 0 ? playing / 1e3 / plays : 0,
+                stats.frames > 0 ? stats.draw_ms * 1000.0 / stats.frames : 0);
+        unload_level(&board);
+    }
+}
+
+// Steps per millisecond through the library (pacmanist.h) on square levels of growing side,
+// four pacmans played with random keys and a ghost every two rows, the game restarts when it ends
+static void bench_library(int ticks) {
+    char directory[] = "/var/tmp/pacmanist-library-XXXXXX";
+    if (!mkdtemp(directory)) {
+        printf("Could not create a directory in /var/tmp\n");
+        exit(1);
+    }
+    char path[MAX_FILENAME * 2];
+    char actions[] = "WASDT";
+
+    printf("%-10s %-10s %-10s %-12s %-12s %-12s\n", "board", "ghosts", "games", "steps/ms", "us/step", "us/reset");
+    for (int side = 16; side <= 1024; side *= 4) {
+        int n_ghosts = side / 2 - 1;
+        snprintf(path, sizeof(path), "%s/a.lvl", directory);
+        FILE* level = fopen(path, "w");
+        if (!level) exit(1);
+        fprintf(level, "DIM %d %d\nTEMPO 10\nPAC p0.p p1.p p2.p p3.p\nMON", side, side);
+        for (int g = 0; g < n_ghosts; g++) {
+            fprintf(level, " g%d.m", g);
+            snprintf(path, sizeof(path), "%s/g%d.m", directory, g);
+            FILE* ghost = fopen(path, "w");
+            if (!ghost) exit(1);
+            fprintf(ghost, "PASSO %d\nPOS %d %d\nD\nR\nA\nT 2\n", g % 3, 2 * g + 1, side / 2);
+            fclose(ghost);
+        }
+        fprintf(level, "\n");
+        for (int y = 0; y < side; y++) {
+            for (int x = 0; x < side; x++)
+                fputc((y == 0 || x == 0 || y == side - 1 || x == side - 1) ? 'X' : 'o', level);
+            fputc('\n', level);
+        }
+        fclose(level);
+        for (int p = 0; p < 4; p++) {
+            snprintf(path, sizeof(path), "%s/p%d.p", directory, p);
+            FILE* pacman = fopen(path, "w");
+            if (!pacman) exit(1);
+            fprintf(pacman, "POS %d %d\nVIDAS 3\n", 1 + (p / 2) * (side - 3), 1 + (p % 2) * (side - 3));
+            fclose(pacman);
+        }
+
+        pm_game_t* game = pm_create(directory, 1);
+        if (!game) exit(1);
+        unsigned int seed = 1;
+        int games = 1;
+        char keys[4];
+        pm_step_t step;
+        double stepping = 0, resetting = 0;
+        for (int i = 0; i < ticks; i++) {
+            for (int p = 0; p < 4; p++)
+                keys[p] = actions[rand_r(&seed) % 5];
+            double start = now_ns();
+            pm_step(game, keys, &step);
+            stepping += now_ns() - start;
+            if (step.done != PM_PLAYING) {
+                start = now_ns();
+                if (pm_reset(game, seed) != 0) exit(1);
+                resetting += now_ns() - start;
+                games++;
+            }
+        }
+        pm_free(game);
+
+        char size[32];
+        snprintf(size, sizeof(size), "%dx%d", side, side);
+        printf("%-10s %-10d %-10d %-12.1f %-12.3f %-12.1f\n", size, n_ghosts, games, ticks / (stepping / 1e6),
+               stepping / 1e3 / ticks, resetting / 1e3 / games);
+
+        for (int g = 0; g < n_ghosts; g++) {
+            snprintf(path, sizeof(path), "%s/g%d.m", directory, g);
+            unlink(path);
+        }
+        for (int p = 0; p < 4; p++) {
+            snprintf(path, sizeof(path), "%s/p%d.p", directory, p);
+            unlink(path);
+        }
+    }
+    snprintf(path, sizeof(path), "%s/a.lvl", directory);
+    unlink(path);
+    rmdir(directory);
+}
+
+// Score log (scores.h) written by SCORE_WRITERS processes at once, 'ticks' records each over
+// SCORE_LEVELS levels: every record must be in the index afterwards. Then the time to open it
+// with the index up to date and with the index built again from the log, and the cost of the queries
+#define SCORE_WRITERS 8
+#define SCORE_LEVELS 50
+static void bench_scores(int ticks) {
+    char directory[] = "/var/tmp/pacmanist-scores-XXXXXX";
+    if (!mkdtemp(directory)) {
+        printf("Could not create a directory in /var/tmp\n");
+        exit(1);
+    }
+    char path[MAX_FILENAME], index_path[MAX_FILENAME + 8];
+    snprintf(path, sizeof(path), "%s/scores.pms", directory);
+    snprintf(index_path, sizeof(index_path), "%s.idx", path);
+
+    double start = now_ns();
+    for (int w = 0; w < SCORE_WRITERS; w++) {
+        pid_t pid = fork();
+        if (pid < 0) exit(1);
+        if (pid == 0) {
+            unsigned int seed = w + 1;
+            if (scores_open(path) != 0) _exit(1);
+            for (int i = 0; i < ticks; i++) {
+                char level[32];
+                snprintf(level, sizeof(level), "%d.lvl", rand_r(&seed) % SCORE_LEVELS);
+                if (scores_add(i % SCORE_LEVELS == 0 ? NULL : level, rand_r(&seed) % 100000) != 0) _exit(1);
+            }
+            scores_close();
+            _exit(0);
+        }
+    }
+    int failed = 0, status;
+    while (wait(&status) > 0)
+        failed |= !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+    double writing = now_ns() - start;
+
+    start = now_ns();
+    if (scores_open(path) != 0) exit(1);
+    double opening = now_ns() - start;
+    long records = 0;
+    int sorted = 1;
+    for (int i = 0; scores_entry(i); i++) {
+        const score_entry_t* entry = scores_entry(i);
+        records += entry->count;
+        for (int t = 1; t < entry->count && t < SCORES_TOP; t++)
+            sorted &= entry->top[t - 1] >= entry->top[t];
+    }
+    long expected = (long)SCORE_WRITERS * ticks;
+    printf("%d writers x %d records: %.2f us/record, %ld of %ld records in the index, tops %s%s\n", SCORE_WRITERS,
+           ticks, writing / 1e3 / expected, records, expected, sorted ? "sorted" : "NOT SORTED",
+           failed ? ", A WRITER FAILED" : "");
+
+    int queries = 1000000, best = 0;
+    start = now_ns();
+    for (int q = 0; q < queries; q++) {
+        char level[32];
+        snprintf(level, sizeof(level), "%d.lvl", q % SCORE_LEVELS);
+        best += scores_best(level) & 1;
+    }
+    double querying = now_ns() - start;
+    start = now_ns();
+    for (int q = 0; q < queries; q++)
+        scores_refresh();
+    double refreshing = now_ns() - start;
+    scores_close();
+
+    unlink(index_path);
+    start = now_ns();
+    if (scores_open(path) != 0) exit(1);
+    double rebuilding = now_ns() - start;
+    scores_close();
+    printf("open: %.1f us with the index, %.1f ms building it from the log | best: %.3f us | refresh: %.3f us (%d)\n",
+           opening / 1e3, rebuilding / 1e6, querying / 1e3 / queries, refreshing / 1e3 / queries, best);
+
+    unlink(index_path);
+    unlink(path);
+    rmdir(directory);
+}
+
+// Autosaves written by a forked child (game_backup.h) on boards of growing side, one every
+// 'ticks' / 10 plays: the save written in the game's own process for comparison, the stall of
+// each fork() in the game, the time the child took, and the slowest play without and with autosaves
+// (the plays after a fork() pay for copying the pages they write while the child still shares them)
+static void bench_autosave(int ticks) {
+    char directory[] = "/var/tmp/pacmanist-autosave-XXXXXX";
+    char previous[MAX_FILENAME];
+    if (!mkdtemp(directory) || !getcwd(previous, sizeof(previous)) || chdir(directory) != 0) {
+        printf("Could not create a directory in /var/tmp\n");
+        exit(1);
+    }
+    int interval = ticks / 10 > 0 ? ticks / 10 : 1;
+
+    printf("%-12s %-10s %-10s %-14s %-13s %-10s %-10s %-14s %-14s\n", "board", "cells MB", "inline ms",
+           "stall mean ms", "stall max ms", "child ms", "us/play", "max play ms", "(no autosave)");
+    for (int side = 256; side <= 8192; side *= 4) {
+        board_t board;
+        build_board(&board, side, side, 4, side / 4);
+        board.ghosts_files = mem_calloc(MEM_LEVEL, board.n_ghosts, sizeof(*board.ghosts_files));
+        if (!board.ghosts_files) exit(1);
+        add_agents(&board);
+
+        double start = now_ns();
+        if (save_state_to_file("inline.pms", &board) != 0) exit(1);
+        double inline_ms = (now_ns() - start) / 1e6;
+
+        double alone = 0;
+        for (int t = 1; t <= ticks; t++) {
+            start = now_ns();
+            play(&board);
+            double elapsed = now_ns() - start;
+            if (elapsed > alone) alone = elapsed;
+        }
+
+        autosave_stats_t before = autosave_stats();
+        double playing = 0, slowest = 0, stall_max = 0;
+        for (int t = 1; t <= ticks; t++) {
+            start = now_ns();
+            play(&board);
+            if (t % interval == 0) {
+                double forking = now_ns();
+                if (autosave_start(&board) == 0 && now_ns() - forking > stall_max) stall_max = now_ns() - forking;
+            }
+            autosave_poll();
+            double elapsed = now_ns() - start;
+            playing += elapsed;
+            if (elapsed > slowest) slowest = elapsed;
+        }
+        autosave_finish();
+        autosave_stats_t after = autosave_stats();
+        unsigned long started = after.started - before.started;
+        unsigned long reaped = (after.done + after.failed) - (before.done + before.failed);
+
+        char size[32];
+        snprintf(size, sizeof(size), "%dx%d", side, side);
+        printf("%-12s %-10.1f %-10.1f %-14.3f %-13.3f %-10.1f %-10.2f %-14.3f %-14.3f", size,
+               board_storage_cells(side, side) * (double)sizeof(board_pos_t) / (1 << 20), inline_ms,
+               started ? (after.stall_ms - before.stall_ms) / started : 0, stall_max / 1e6,
+               reaped ? (after.write_ms - before.write_ms) / reaped : 0, playing / 1e3 / ticks, slowest / 1e6,
+               alone / 1e6);
+        printf(" (%lu saves, %lu skipped, %lu failed)\n", started, after.skipped - before.skipped,
+               after.failed - before.failed);
+        unload_level(&board);
+    }
+    unlink("inline.pms");
+    unlink(AUTOSAVE_FILE);
+    if (chdir(previous) != 0) exit(1);
+    rmdir(directory);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printf("Usage: %s pacmans|ghosts|sparse|patrol|render|viewport|tiles|load|autopilot|library|scores|autosave [ticks]\n"
+               "       %s level <ticks> <level_directory>\n", argv[0], argv[0]);
+        return 1;
+    }
+
+    int ticks = (argc > 2) ? atoi(argv[2]) : 1000;
+    srand(1);
+
+    if (strcmp(argv[1], "pacmans") == 0) {
+        bench_pacmans(ticks);
+    } else if (strcmp(argv[1], "ghosts") == 0) {
+        bench_ghosts(ticks);
+    } else if (strcmp(argv[1], "sparse") == 0) {
+        bench_sparse(ticks);
+    } else if (strcmp(argv[1], "patrol") == 0) {
+        bench_patrol(ticks);
+    } else if (strcmp(argv[1], "render") == 0) {
+        bench_render(ticks);
+    } else if (strcmp(argv[1], "viewport") == 0) {
+        bench_viewport(ticks);
+    } else if (strcmp(argv[1], "tiles") == 0) {
+        bench_tiles(ticks);
+    } else if (strcmp(argv[1], "autopilot") == 0) {
+        bench_autopilot(ticks);
+    } else if (strcmp(argv[1], "load") == 0) {
+        bench_load(argc > 2 ? ticks : 10000); // most ghost files
+    } else if (strcmp(argv[1], "library") == 0) {
+        bench_library(ticks);
+    } else if (strcmp(argv[1], "scores") == 0) {
+        bench_scores(ticks);
+    } else if (strcmp(argv[1], "autosave") == 0) {
+        bench_autosave(ticks);
+    } else if (strcmp(argv[1], "level") == 0 && argc > 3) {
+        bench_level(ticks, argv[3]);
+    } else {
+        printf("Unknown benchmark %s\n", argv[1]);
+        return 1;
+    }
+    return 0;
+}
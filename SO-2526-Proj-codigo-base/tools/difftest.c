@@ -0,0 +1,635 @@
+#include "board.h"
+#include "timeline.h"
+#include "memstats.h"
+#include "file_loader.h"
+#include "reference.h"
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+Differential harness: plays the same game on the engine of board.c and on the
+reference engine (reference.h), one play at a time as game.c does, and compares the
+whole state after every play: every cell, every pacman, the ghosts' positions and
+the generator of the 'R' moves. The ghosts' countdowns and script cursors are
+compared every few plays, after sync_ghosts, since the timing wheel only writes
+them back on demand.
+Games are random levels made from a seed (size, walls, portal, scripts with every
+command), or the levels of a directory. The first play that differs is reported,
+then the game is shrunk (fewer agents, shorter scripts, smaller board) while it
+still diverges, and written as a level directory that replays the divergence.
+*/
+#define DEFAULT_CASES 1000
+#define DEFAULT_PLAYS 400
+#define MAX_CASE_GHOSTS 48
+#define KEY_SEED_MIX 0x5bd1e995u // keys of a manual pacman come from their own generator
+
+static const char pacman_commands[] = "WASDWASDWASDRT";
+static const char ghost_commands[] = "WASDWASDWASDRCT";
+static const char plain_commands[] = "WASDWASDT";
+static const char keys[] = "WASDTR";
+
+typedef struct {
+    int passo;
+    int pos_x, pos_y;
+    int lives;
+    int n_moves;
+    command_t moves[MAX_MOVES];
+} agent_spec_t;
+
+// A game played on both engines: a level, the seed of its 'R' moves and keys, and how it is checked
+typedef struct {
+    int width, height;
+    char* cells;            // 'X', 'o' or '@' as in the .lvl files, row-major
+    int manual;             // a single pacman played with keys, at (1, 1)
+    int n_pacmans;
+    agent_spec_t pacmans[MAX_PACMANS];
+    int n_ghosts;
+    agent_spec_t* ghosts;
+    unsigned int seed;
+    int timelines;          // ghosts with plain scripts follow their timelines
+    int sync_every;         // plays between comparisons of the ghosts' counters, 0 for never
+} game_case_t;
+
+// Helper function to write the divergence found, always returns 1
+static int report(char* what, size_t size, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    vsnprintf(what, size, format, args);
+    va_end(args);
+    return 1;
+}
+
+static void free_case(game_case_t* c) {
+    free(c->cells);
+    free(c->ghosts);
+    c->cells = NULL;
+    c->ghosts = NULL;
+}
+
+static void copy_case(game_case_t* dst, const game_case_t* src) {
+    *dst = *src;
+    dst->cells = malloc((size_t)src->width * src->height);
+    dst->ghosts = malloc((src->n_ghosts > 0 ? src->n_ghosts : 1) * sizeof(agent_spec_t));
+    if (!dst->cells || !dst->ghosts) exit(1);
+    memcpy(dst->cells, src->cells, (size_t)src->width * src->height);
+    memcpy(dst->ghosts, src->ghosts, src->n_ghosts * sizeof(agent_spec_t));
+}
+
+// Helper function for a random script of n commands taken from 'commands'
+static void random_script(agent_spec_t* agent, const char* commands, unsigned int* rng) {
+    agent->n_moves = 1 + rand_r(rng) % MAX_MOVES;
+    for (int m = 0; m < agent->n_moves; m++) {
+        char command = commands[rand_r(rng) % strlen(commands)];
+        int turns = 1;
+        if (command == 'T')
+            turns = (rand_r(rng) % 16 == 0) ? 0 : 1 + rand_r(rng) % 5; // 'T 0' never ends
+        agent->moves[m] = (command_t){command, turns, turns};
+    }
+}
+
+// Helper function for a random level and its agents, everything drawn from 'seed'
+static void random_case(game_case_t* c, unsigned int seed) {
+    unsigned int rng = seed;
+    memset(c, 0, sizeof(*c));
+    c->seed = seed;
+    c->width = 4 + rand_r(&rng) % 29;
+    c->height = 4 + rand_r(&rng) % 21;
+    c->cells = malloc((size_t)c->width * c->height);
+    c->ghosts = malloc(MAX_CASE_GHOSTS * sizeof(agent_spec_t));
+    int* free_cells = malloc((size_t)c->width * c->height * sizeof(int));
+    if (!c->cells || !c->ghosts || !free_cells) exit(1);
+
+    // Walls: with or without a border, charged ghosts must also meet the edge of the board
+    int border = rand_r(&rng) % 2;
+    int wall_percent = rand_r(&rng) % 36;
+    for (int y = 0; y < c->height; y++) {
+        for (int x = 0; x < c->width; x++) {
+            int edge = x == 0 || y == 0 || x == c->width - 1 || y == c->height - 1;
+            c->cells[y * c->width + x] = ((border && edge) || rand_r(&rng) % 100 < wall_percent) ? 'X' : 'o';
+        }
+    }
+    c->manual = rand_r(&rng) % 4 == 0;
+    if (c->manual)
+        c->cells[1 * c->width + 1] = 'o';
+
+    int n_free = 0;
+    for (int i = 0; i < c->width * c->height; i++) {
+        if (c->cells[i] == 'o' && !(c->manual && i == 1 * c->width + 1))
+            free_cells[n_free++] = i;
+    }
+    for (int i = n_free - 1; i > 0; i--) {
+        int j = rand_r(&rng) % (i + 1);
+        int swap = free_cells[i];
+        free_cells[i] = free_cells[j];
+        free_cells[j] = swap;
+    }
+    int next = 0;
+    if (n_free > 0 && rand_r(&rng) % 5 != 0)
+        c->cells[free_cells[next++]] = '@';
+
+    if (c->manual) {
+        c->n_pacmans = 1;
+        c->pacmans[0] = (agent_spec_t){0, 1, 1, 1, 0, {{0}}};
+    } else {
+        int wanted = 1 + rand_r(&rng) % 4;
+        for (c->n_pacmans = 0; c->n_pacmans < wanted && next < n_free; c->n_pacmans++) {
+            agent_spec_t* pac = &c->pacmans[c->n_pacmans];
+            pac->passo = rand_r(&rng) % 3;
+            pac->lives = 1 + rand_r(&rng) % 3;
+            pac->pos_x = free_cells[next] % c->width;
+            pac->pos_y = free_cells[next++] / c->width;
+            random_script(pac, pacman_commands, &rng);
+        }
+    }
+
+    int wanted = rand_r(&rng) % (MAX_CASE_GHOSTS + 1);
+    for (c->n_ghosts = 0; c->n_ghosts < wanted && next < n_free; c->n_ghosts++) {
+        agent_spec_t* ghost = &c->ghosts[c->n_ghosts];
+        ghost->passo = rand_r(&rng) % 4;
+        ghost->lives = 0;
+        ghost->pos_x = free_cells[next] % c->width;
+        ghost->pos_y = free_cells[next++] / c->width;
+        // Half of the ghosts only walk and wait, so they get timelines
+        random_script(ghost, rand_r(&rng) % 2 ? plain_commands : ghost_commands, &rng);
+    }
+
+    static const int sync_choices[] = {0, 1, 1, 3, 16};
+    c->timelines = rand_r(&rng) % 4 != 0;
+    c->sync_every = sync_choices[rand_r(&rng) % 5];
+    free(free_cells);
+}
+
+// Helper function to set a board up from a case, as load_level_from_file does
+static void build_board(const game_case_t* c, board_t* board) {
+    memset(board, 0, sizeof(*board));
+    board->width = c->width;
+    board->height = c->height;
+    board->n_pacmans = c->n_pacmans;
+    board->pacmans = mem_calloc(MEM_AGENTS, c->n_pacmans, sizeof(pacman_t));
+    if (board_alloc_cells(board) != 0 || !board->pacmans || allocate_ghosts(board, c->n_ghosts) != 0) exit(1);
+    snprintf(board->level_name, sizeof(board->level_name), "difftest");
+    board->rng_state = c->seed;
+
+    for (int y = 0; y < c->height; y++) {
+        for (int x = 0; x < c->width; x++) {
+            board_pos_t* pos = &board->board[board_index(board, x, y)];
+            char cell = c->cells[y * c->width + x];
+            *pos = (board_pos_t){cell == 'X' ? 'W' : ' ', cell == 'o', cell == '@'};
+        }
+    }
+    for (int p = 0; p < c->n_pacmans; p++) {
+        const agent_spec_t* spec = &c->pacmans[p];
+        pacman_t* pac = &board->pacmans[p];
+        pac->n_moves = spec->n_moves;
+        memcpy(pac->moves, spec->moves, sizeof(pac->moves));
+        pac->passo = spec->passo;
+        pac->waiting = spec->passo;
+        pac->lives = spec->lives;
+        pac->pos_x = pac->start_x = spec->pos_x;
+        pac->pos_y = pac->start_y = spec->pos_y;
+        pac->alive = 1;
+        board->board[board_index(board, pac->pos_x, pac->pos_y)].content = 'P';
+    }
+    for (int g = 0; g < c->n_ghosts; g++) {
+        const agent_spec_t* spec = &c->ghosts[g];
+        ghost_t* ghost = &board->ghosts[g];
+        ghost->n_moves = spec->n_moves;
+        memcpy(ghost->moves, spec->moves, MAX_MOVES * sizeof(command_t));
+        ghost->passo = spec->passo;
+        board->ghost_waiting[g] = spec->passo;
+        ghost->pos_x = spec->pos_x;
+        ghost->pos_y = spec->pos_y;
+        board->board[board_index(board, ghost->pos_x, ghost->pos_y)].content = 'M';
+    }
+}
+
+// Helper function to turn a level just loaded into a case
+static void case_from_board(game_case_t* c, board_t* board, unsigned int seed) {
+    memset(c, 0, sizeof(*c));
+    c->width = board->width;
+    c->height = board->height;
+    c->seed = seed;
+    c->timelines = 1;
+    c->sync_every = 1;
+    c->cells = malloc((size_t)c->width * c->height);
+    c->ghosts = malloc((board->n_ghosts > 0 ? board->n_ghosts : 1) * sizeof(agent_spec_t));
+    if (!c->cells || !c->ghosts) exit(1);
+    for (int y = 0; y < c->height; y++) {
+        for (int x = 0; x < c->width; x++) {
+            board_pos_t* pos = &board->board[board_index(board, x, y)];
+            c->cells[y * c->width + x] = pos->has_portal ? '@' : (pos->content == 'W' ? 'X' : 'o');
+        }
+    }
+    c->n_pacmans = board->n_pacmans;
+    c->manual = board->n_pacmans == 1 && board->pacmans[0].n_moves == 0;
+    for (int p = 0; p < board->n_pacmans; p++) {
+        pacman_t* pac = &board->pacmans[p];
+        c->pacmans[p] = (agent_spec_t){pac->passo, pac->pos_x, pac->pos_y, pac->lives, pac->n_moves, {{0}}};
+        memcpy(c->pacmans[p].moves, pac->moves, sizeof(pac->moves));
+    }
+    c->n_ghosts = board->n_ghosts;
+    for (int g = 0; g < board->n_ghosts; g++) {
+        ghost_t* ghost = &board->ghosts[g];
+        c->ghosts[g] = (agent_spec_t){ghost->passo, ghost->pos_x, ghost->pos_y, 0, ghost->n_moves, {{0}}};
+        memcpy(c->ghosts[g].moves, ghost->moves, MAX_MOVES * sizeof(command_t));
+    }
+}
+
+// Helper function to compare both engines, returns 1 and describes the first difference
+// Positions are written as line and column, as in the POS of the behavior files
+static int compare(board_t* board, ref_board_t* ref, int counters, char* what, size_t size) {
+    if (board->rng_state != ref->rng_state)
+        return report(what, size, "generator state %u, reference %u", board->rng_state, ref->rng_state);
+
+    for (int y = 0; y < board->height; y++) {
+        for (int x = 0; x < board->width; x++) {
+            board_pos_t* a = &board->board[board_index(board, x, y)];
+            board_pos_t* b = &ref->cells[y * ref->width + x];
+            if (a->content != b->content || a->has_dot != b->has_dot || a->has_portal != b->has_portal)
+                return report(what, size, "cell (%d, %d) '%c' dot %d portal %d, reference '%c' dot %d portal %d", y, x,
+                              a->content, a->has_dot, a->has_portal, b->content, b->has_dot, b->has_portal);
+        }
+    }
+
+    for (int p = 0; p < board->n_pacmans; p++) {
+        pacman_t* a = &board->pacmans[p];
+        pacman_t* b = &ref->pacmans[p];
+        if (a->pos_x != b->pos_x || a->pos_y != b->pos_y || a->alive != b->alive || a->lives != b->lives)
+            return report(what, size, "pacman %d at (%d, %d) alive %d lives %d, reference (%d, %d) alive %d lives %d", p,
+                          a->pos_y, a->pos_x, a->alive, a->lives, b->pos_y, b->pos_x, b->alive, b->lives);
+        if (a->points != b->points || a->waiting != b->waiting || a->current_move != b->current_move)
+            return report(what, size, "pacman %d points %d waiting %d move %d, reference %d, %d, %d", p,
+                          a->points, a->waiting, a->current_move, b->points, b->waiting, b->current_move);
+        for (int m = 0; m < a->n_moves; m++) {
+            if (a->moves[m].turns_left != b->moves[m].turns_left)
+                return report(what, size, "pacman %d command %d turns left %d, reference %d", p, m,
+                              a->moves[m].turns_left, b->moves[m].turns_left);
+        }
+    }
+
+    for (int g = 0; g < board->n_ghosts; g++) {
+        ghost_t* a = &board->ghosts[g];
+        ref_ghost_t* b = &ref->ghosts[g];
+        if (a->pos_x != b->pos_x || a->pos_y != b->pos_y || a->charged != b->charged)
+            return report(what, size, "ghost %d at (%d, %d) charged %d, reference (%d, %d) charged %d", g,
+                          a->pos_y, a->pos_x, a->charged, b->pos_y, b->pos_x, b->charged);
+        if (!counters) continue;
+        if (board->ghost_waiting[g] != b->waiting || a->current_move != b->current_move)
+            return report(what, size, "ghost %d waiting %d move %d, reference %d, %d", g,
+                          board->ghost_waiting[g], a->current_move, b->waiting, b->current_move);
+        for (int m = 0; m < a->n_moves; m++) {
+            if (a->moves[m].turns_left != b->moves[m].turns_left)
+                return report(what, size, "ghost %d command %d turns left %d, reference %d", g, m,
+                              a->moves[m].turns_left, b->moves[m].turns_left);
+        }
+    }
+    return 0;
+}
+
+// Plays up to 'plays' plays of a case on both engines, as play_board does
+// Returns the first play after which they differ (described in 'what'), 0 if none
+static long run_case(const game_case_t* c, long plays, char* what, size_t size) {
+    board_t board;
+    ref_board_t ref;
+    build_board(c, &board);
+    timeline_enable(c->timelines);
+    if (ref_from_board(&ref, &board) != 0) exit(1);
+
+    unsigned int key_rng = c->seed ^ KEY_SEED_MIX;
+    long diverged = 0;
+    for (long play = 1; play <= plays && !diverged; play++) {
+        command_t input = {keys[rand_r(&key_rng) % (sizeof(keys) - 1)], 1, 1};
+        command_t ref_input = input;
+        int result = move_pacmans(&board, c->manual ? &input : NULL);
+        int ref_result = ref_move_pacmans(&ref, c->manual ? &ref_input : NULL);
+        if (result != ref_result) {
+            report(what, size, "move_pacmans returned %d, reference %d", result, ref_result);
+            diverged = play;
+            break;
+        }
+        if (result == VALID_MOVE) {
+            move_ghosts(&board);
+            ref_move_ghosts(&ref);
+        }
+
+        int counters = c->sync_every > 0 && play % c->sync_every == 0;
+        if (counters) sync_ghosts(&board);
+        if (compare(&board, &ref, counters, what, size)) diverged = play;
+        if (result != VALID_MOVE) break; // the level ends: portal or no pacman left
+    }
+
+    unload_level(&board);
+    ref_free(&ref);
+    return diverged;
+}
+
+// Helper function for a fixed game: pacman 0 steps onto the portal while pacman 1 steps onto a dot
+// in the same play. The level ends, but pacman 1's move must still be made on both engines
+// Returns 1 and describes what is wrong, 0 if both engines made it
+static int portal_case(char* what, size_t size) {
+    char cells[] = "XXXX"
+                   "Xo@X"
+                   "XooX"
+                   "XXXX";
+    game_case_t c;
+    memset(&c, 0, sizeof(c));
+    c.width = c.height = 4;
+    c.cells = cells;
+    c.n_pacmans = 2;
+    c.pacmans[0] = (agent_spec_t){0, 1, 1, 1, 1, {{'D', 1, 1}}};
+    c.pacmans[1] = (agent_spec_t){0, 1, 2, 1, 1, {{'D', 1, 1}}};
+
+    board_t board;
+    ref_board_t ref;
+    build_board(&c, &board);
+    if (ref_from_board(&ref, &board) != 0) exit(1);
+    int result = move_pacmans(&board, NULL);
+    int ref_result = ref_move_pacmans(&ref, NULL);
+
+    int failed = 0;
+    pacman_t* a = &board.pacmans[1];
+    pacman_t* b = &ref.pacmans[1];
+    board_pos_t* cell = &board.board[board_index(&board, 2, 2)];
+    board_pos_t* ref_cell = &ref.cells[2 * ref.width + 2];
+    if (result != REACHED_PORTAL || ref_result != REACHED_PORTAL)
+        failed = report(what, size, "portal case: move_pacmans returned %d, reference %d", result, ref_result);
+    else if (a->pos_x != 2 || a->points != 1 || cell->content != 'P' || cell->has_dot)
+        failed = report(what, size, "portal case: pacman 1 at (%d, %d) with %d points, its cell '%c' dot %d",
+                        a->pos_y, a->pos_x, a->points, cell->content, cell->has_dot);
+    else if (b->pos_x != 2 || b->points != 1 || ref_cell->content != 'P' || ref_cell->has_dot)
+        failed = report(what, size, "portal case: reference pacman 1 at (%d, %d) with %d points, its cell '%c' dot %d",
+                        b->pos_y, b->pos_x, b->points, ref_cell->content, ref_cell->has_dot);
+    else
+        failed = compare(&board, &ref, 0, what, size);
+
+    unload_level(&board);
+    ref_free(&ref);
+    return failed;
+}
+
+// Helper function: keeps 'candidate' in place of 'c' when it still diverges, in fewer plays or the same
+static int try_candidate(game_case_t* c, game_case_t* candidate, long* plays, char* what, size_t size) {
+    long diverged = run_case(candidate, *plays, what, size);
+    if (!diverged) {
+        free_case(candidate);
+        return 0;
+    }
+    free_case(c);
+    *c = *candidate;
+    *plays = diverged;
+    return 1;
+}
+
+// Helper function: the agent stands on line 'row' or column 'col', or is moved back past them
+static int shift_agent(agent_spec_t* agent, int row, int col) {
+    if (agent->pos_y == row || agent->pos_x == col) return 0;
+    if (row >= 0 && agent->pos_y > row) agent->pos_y--;
+    if (col >= 0 && agent->pos_x > col) agent->pos_x--;
+    return 1;
+}
+
+// Helper function to take line 'row' (or column 'col', the other one is -1) out of the board
+// Returns 0 when an agent stands there
+static int crop(game_case_t* c, int row, int col) {
+    for (int p = 0; p < c->n_pacmans; p++) {
+        if (!shift_agent(&c->pacmans[p], row, col)) return 0;
+    }
+    for (int g = 0; g < c->n_ghosts; g++) {
+        if (!shift_agent(&c->ghosts[g], row, col)) return 0;
+    }
+
+    int width = c->width - (col >= 0), height = c->height - (row >= 0);
+    char* cells = malloc((size_t)width * height);
+    if (!cells) exit(1);
+    for (int y = 0, ny = 0; y < c->height; y++) {
+        if (y == row) continue;
+        for (int x = 0, nx = 0; x < c->width; x++) {
+            if (x != col) cells[ny * width + nx++] = c->cells[y * c->width + x];
+        }
+        ny++;
+    }
+    free(c->cells);
+    c->cells = cells;
+    c->width = width;
+    c->height = height;
+    return 1;
+}
+
+// Helper function to shrink a script: command m out, or plainer turns
+static int shrink_script(agent_spec_t* agent, int m) {
+    if (agent->moves[m].command == 'T' && agent->moves[m].turns > 1) {
+        agent->moves[m].turns = agent->moves[m].turns_left = 1;
+        return 1;
+    }
+    if (agent->n_moves <= 1) return 0;
+    memmove(&agent->moves[m], &agent->moves[m + 1], (agent->n_moves - m - 1) * sizeof(command_t));
+    agent->n_moves--;
+    return 1;
+}
+
+// Shrinks a diverging case while it still diverges: fewer ghosts and pacmans, shorter
+// scripts, no passo, smaller board. Any divergence is kept, not only the first one found
+// Returns the play of the divergence of the smaller case
+static long shrink_case(game_case_t* c, long plays, char* what, size_t size) {
+    game_case_t candidate;
+    int progress = 1;
+    while (progress) {
+        progress = 0;
+        for (int g = c->n_ghosts - 1; g >= 0; g--) {
+            copy_case(&candidate, c);
+            memmove(&candidate.ghosts[g], &candidate.ghosts[g + 1], (candidate.n_ghosts - g - 1) * sizeof(agent_spec_t));
+            candidate.n_ghosts--;
+            progress |= try_candidate(c, &candidate, &plays, what, size);
+        }
+        for (int p = c->n_pacmans - 1; p >= 0 && c->n_pacmans > 1; p--) {
+            copy_case(&candidate, c);
+            memmove(&candidate.pacmans[p], &candidate.pacmans[p + 1], (candidate.n_pacmans - p - 1) * sizeof(agent_spec_t));
+            candidate.n_pacmans--;
+            progress |= try_candidate(c, &candidate, &plays, what, size);
+        }
+        for (int a = 0; a < c->n_pacmans + c->n_ghosts; a++) {
+            for (int m = MAX_MOVES - 1; m >= 0; m--) {
+                agent_spec_t* agent = a < c->n_pacmans ? &c->pacmans[a] : &c->ghosts[a - c->n_pacmans];
+                if (m >= agent->n_moves) continue;
+                copy_case(&candidate, c);
+                agent = a < c->n_pacmans ? &candidate.pacmans[a] : &candidate.ghosts[a - candidate.n_pacmans];
+                if (!shrink_script(agent, m)) {
+                    free_case(&candidate);
+                    continue;
+                }
+                progress |= try_candidate(c, &candidate, &plays, what, size);
+            }
+            agent_spec_t* agent = a < c->n_pacmans ? &c->pacmans[a] : &c->ghosts[a - c->n_pacmans];
+            if (agent->passo == 0 && agent->lives <= 1) continue;
+            copy_case(&candidate, c);
+            agent = a < c->n_pacmans ? &candidate.pacmans[a] : &candidate.ghosts[a - candidate.n_pacmans];
+            agent->passo = 0;
+            if (agent->lives > 1) agent->lives = 1;
+            progress |= try_candidate(c, &candidate, &plays, what, size);
+        }
+        // The manual pacman always starts at (1, 1): only the last lines and columns go then
+        for (int side = 0; side < 4; side++) {
+            int last = side >= 2;
+            if ((side % 2 == 0 ? c->height : c->width) <= 2 || (c->manual && !last)) continue;
+            copy_case(&candidate, c);
+            int row = side % 2 == 0 ? (last ? c->height - 1 : 0) : -1;
+            int col = side % 2 == 1 ? (last ? c->width - 1 : 0) : -1;
+            if (!crop(&candidate, row, col)) {
+                free_case(&candidate);
+                continue;
+            }
+            progress |= try_candidate(c, &candidate, &plays, what, size);
+        }
+    }
+    return run_case(c, plays, what, size);
+}
+
+// Helper function to write the script of an agent in the format of the behavior files
+static void write_agent(FILE* file, const agent_spec_t* agent, int pacman) {
+    fprintf(file, "PASSO %d\nPOS %d %d\n", agent->passo, agent->pos_y, agent->pos_x);
+    if (pacman) fprintf(file, "VIDAS %d\n", agent->lives);
+    for (int m = 0; m < agent->n_moves; m++) {
+        if (agent->moves[m].command == 'T')
+            fprintf(file, "T %d\n", agent->moves[m].turns);
+        else
+            fprintf(file, "%c\n", agent->moves[m].command);
+    }
+}
+
+// Writes a case as a level directory (difftest.lvl, p<n>.p, m<n>.m)
+// Returns 0 on success, -1 on error
+static int write_case(const game_case_t* c, const char* directory, long plays) {
+    if (mkdir(directory, 0755) != 0 && errno != EEXIST) return -1;
+
+    char path[MAX_FILENAME * 2];
+    snprintf(path, sizeof(path), "%s/difftest.lvl", directory);
+    FILE* level = fopen(path, "w");
+    if (!level) return -1;
+    fprintf(level, "# DiffTest: seed %u, diverges at play %ld\n", c->seed, plays);
+    fprintf(level, "DIM %d %d\nTEMPO 0\n", c->height, c->width);
+    if (!c->manual) {
+        fprintf(level, "PAC");
+        for (int p = 0; p < c->n_pacmans; p++) fprintf(level, " p%d.p", p + 1);
+        fprintf(level, "\n");
+    }
+    if (c->n_ghosts > 0) {
+        fprintf(level, "MON");
+        for (int g = 0; g < c->n_ghosts; g++) fprintf(level, " m%d.m", g + 1);
+        fprintf(level, "\n");
+    }
+    for (int y = 0; y < c->height; y++)
+        fprintf(level, "%.*s\n", c->width, &c->cells[y * c->width]);
+    int failed = fclose(level) != 0;
+
+    for (int a = 0; a < (c->manual ? 0 : c->n_pacmans) + c->n_ghosts && !failed; a++) {
+        int pacman = a < (c->manual ? 0 : c->n_pacmans);
+        int index = pacman ? a : a - (c->manual ? 0 : c->n_pacmans);
+        snprintf(path, sizeof(path), "%s/%c%d.%c", directory, pacman ? 'p' : 'm', index + 1, pacman ? 'p' : 'm');
+        FILE* file = fopen(path, "w");
+        if (!file) return -1;
+        write_agent(file, pacman ? &c->pacmans[index] : &c->ghosts[index], pacman);
+        failed = fclose(file) != 0;
+    }
+    return failed ? -1 : 0;
+}
+
+// Helper function for a diverging case: report it, shrink it and write it out
+static void diverged(game_case_t* c, const char* name, long play, char* what, size_t size, const char* repro) {
+    printf("%s (seed %u): engines diverge after play %ld: %s\n", name, c->seed, play, what);
+    play = shrink_case(c, play, what, size);
+    printf("Shrunk to %d x %d, %d pacmans, %d ghosts: after play %ld: %s\n",
+           c->width, c->height, c->n_pacmans, c->n_ghosts, play, what);
+    if (write_case(c, repro, play) != 0) {
+        printf("Error: Could not write the reproduction to %s\n", repro);
+        return;
+    }
+    printf("Replay: ./bin/DiffTest -l %s -S %u -p %ld -y %d%s\n", repro, c->seed, play, c->sync_every,
+           c->timelines ? "" : " -w");
+}
+
+int main(int argc, char** argv) {
+    int n_cases = DEFAULT_CASES;
+    long plays = DEFAULT_PLAYS;
+    unsigned int seed = 1;
+    int sync_every = -1; // from the case
+    int timelines = 1;
+    const char* level_directory = NULL;
+    const char* repro = "difftest-repro";
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:p:S:y:wl:o:")) != -1) {
+        switch (opt) {
+            case 'n': n_cases = atoi(optarg); break;             // random games
+            case 'p': plays = atol(optarg); break;               // plays per game
+            case 'S': seed = strtoul(optarg, NULL, 10); break;   // first seed
+            case 'y': sync_every = atoi(optarg); break;          // plays between counter checks
+            case 'w': timelines = 0; break;                      // no timelines in replays
+            case 'l': level_directory = optarg; break;           // replay the levels of a directory
+            case 'o': repro = optarg; break;                     // where the shrunk game is written
+            default:
+                printf("Usage: %s [-n cases] [-p plays] [-S seed] [-y sync_every] [-w] [-l level_directory] [-o repro_directory]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    char what[256];
+    int n_run = 0, failures = 0;
+    game_case_t c;
+
+    if (level_directory) {
+        level_manager_t manager;
+        if (init_level_manager(&manager, level_directory) != 0) {
+            printf("Error: Could not read the levels of %s\n", level_directory);
+            return 1;
+        }
+        int points[MAX_PACMANS] = {0};
+        for (; manager.current_level < manager.n_levels; manager.current_level++) {
+            board_t board;
+            if (load_level_from_file(&board, &manager, points) != 0) {
+                printf("Error: Could not load %s\n", manager.level_files[manager.current_level]);
+                return 1;
+            }
+            case_from_board(&c, &board, seed);
+            unload_level(&board);
+            c.timelines = timelines;
+            if (sync_every >= 0) c.sync_every = sync_every;
+
+            long play = run_case(&c, plays, what, sizeof(what));
+            n_run++;
+            if (play) {
+                failures++;
+                diverged(&c, manager.level_files[manager.current_level], play, what, sizeof(what), repro);
+            }
+            free_case(&c);
+        }
+    } else {
+        // Fixed games first, for rules the random ones rarely reach
+        n_run++;
+        if (portal_case(what, sizeof(what))) {
+            printf("%s\n", what);
+            failures++;
+        }
+        for (int i = 0; i < n_cases && !failures; i++) {
+            random_case(&c, seed + i);
+            if (sync_every >= 0) c.sync_every = sync_every;
+            long play = run_case(&c, plays, what, sizeof(what));
+            n_run++;
+            if (play) {
+                char name[64];
+                snprintf(name, sizeof(name), "Game %d", i);
+                failures++;
+                diverged(&c, name, play, what, sizeof(what), repro);
+            }
+            free_case(&c);
+        }
+    }
+
+    if (failures == 0)
+        printf("%d games, up to %ld plays each: both engines agree\n", n_run, plays);
+    return failures ? 1 : 0;
+}
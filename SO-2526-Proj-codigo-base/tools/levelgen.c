@@ -0,0 +1,296 @@
+#include "board.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+Level generator: writes .lvl, .p and .m files in the format read by file_loader.c,
+everything drawn from one seed so the same options always give the same files.
+Boards are either open (walls scattered with a given density, with free corridors
+every GEN_CORRIDOR lines and columns joining the whole board) or mazes carved with
+a depth-first search, with a share of the inner walls knocked down for loops.
+In this format every free cell holds a dot, so the dots follow the walls.
+*/
+#define GEN_CORRIDOR 8
+#define GEN_MAX_TURNS 5      // longest 'T n' of the scripts
+#define GEN_FILE_BUFFER (1 << 20)
+
+typedef struct {
+    int width, height;
+    int wall_percent;       // open boards: walls among the cells off the corridors
+    int maze;               // carve a maze instead
+    int open_percent;       // mazes: inner walls knocked down
+    int n_pacmans;          // 0 for a single pacman played with the keys, at (1, 1)
+    int lives;
+    int n_ghosts;
+    int script_length;
+    int random_percent, charge_percent, wait_percent; // mix of R, C and T in the ghosts' scripts
+    int max_passo;
+    int tempo;
+    char portal;            // 'c' bottom right corner, 'r' random cell, 'n' none
+    int n_levels;
+    unsigned int seed;
+} gen_options_t;
+
+// Marks of the agents while they are placed, written out as 'o'
+#define CELL_PACMAN 'p'
+#define CELL_GHOST 'm'
+
+// Helper function for a random number in [0, n), large enough for any board
+static inline long draw(unsigned int* rng, long n) {
+    return ((long)rand_r(rng) * ((long)RAND_MAX + 1) + rand_r(rng)) % n;
+}
+
+// Helper function: scattered walls, a border and free corridors
+static void open_board(const gen_options_t* options, char* cells, unsigned int* rng) {
+    int width = options->width, height = options->height;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            char cell = 'o';
+            if (x == 0 || y == 0 || x == width - 1 || y == height - 1)
+                cell = 'X';
+            else if (x % GEN_CORRIDOR != 1 && y % GEN_CORRIDOR != 1 && draw(rng, 100) < options->wall_percent)
+                cell = 'X';
+            cells[(long)y * width + x] = cell;
+        }
+    }
+}
+
+// Helper function: a maze over the cells with odd coordinates, carved with an explicit stack
+static int maze_board(const gen_options_t* options, char* cells, unsigned int* rng) {
+    int width = options->width, height = options->height;
+    memset(cells, 'X', (size_t)width * height);
+    int rooms_x = (width - 1) / 2, rooms_y = (height - 1) / 2;
+    long* stack = malloc((size_t)rooms_x * rooms_y * sizeof(long));
+    if (!stack) return -1;
+
+    static const int dx[] = {0, 0, -1, 1}, dy[] = {-1, 1, 0, 0};
+    long top = 0;
+    cells[1L * width + 1] = 'o';
+    stack[top++] = 1L * width + 1;
+    while (top > 0) {
+        long cell = stack[top - 1];
+        int x = cell % width, y = cell / width;
+        int options_left[4], n = 0;
+        for (int d = 0; d < 4; d++) {
+            int nx = x + 2 * dx[d], ny = y + 2 * dy[d];
+            if (nx > 0 && ny > 0 && nx < width - 1 && ny < height - 1 && cells[(long)ny * width + nx] == 'X')
+                options_left[n++] = d;
+        }
+        if (n == 0) {
+            top--;
+            continue;
+        }
+        int d = options_left[draw(rng, n)];
+        cells[(long)(y + dy[d]) * width + x + dx[d]] = 'o';
+        cells[(long)(y + 2 * dy[d]) * width + x + 2 * dx[d]] = 'o';
+        stack[top++] = (long)(y + 2 * dy[d]) * width + x + 2 * dx[d];
+    }
+    free(stack);
+
+    // Loops: walls between two corridors knocked down
+    for (int y = 1; y < height - 1; y++) {
+        for (int x = 1; x < width - 1; x++) {
+            char* cell = &cells[(long)y * width + x];
+            if (*cell != 'X' || (x % 2 == 1 && y % 2 == 1)) continue;
+            int across = (x % 2 == 0) ? cells[(long)y * width + x - 1] == 'o' && cells[(long)y * width + x + 1] == 'o'
+                                      : cells[(long)(y - 1) * width + x] == 'o' && cells[(long)(y + 1) * width + x] == 'o';
+            if (across && draw(rng, 100) < options->open_percent)
+                *cell = 'o';
+        }
+    }
+    return 0;
+}
+
+// Helper function to take a random free cell for an agent, there must be one left
+static long take_cell(const gen_options_t* options, char* cells, unsigned int* rng, char mark) {
+    long total = (long)options->width * options->height;
+    long cell = draw(rng, total);
+    while (cells[cell] != 'o')
+        cell = (cell + 1) % total;
+    cells[cell] = mark;
+    return cell;
+}
+
+// Helper function for one command of a script, following the mix of the options (pacmans do not charge)
+static void write_command(FILE* file, const gen_options_t* options, unsigned int* rng, int ghost) {
+    static const char directions[] = "WASD";
+    long roll = draw(rng, 100);
+    if (roll < options->random_percent)
+        fprintf(file, "R\n");
+    else if (ghost && roll < options->random_percent + options->charge_percent)
+        fprintf(file, "C\n");
+    else if (roll >= options->random_percent + options->charge_percent &&
+             roll < options->random_percent + options->charge_percent + options->wait_percent)
+        fprintf(file, "T %ld\n", 1 + draw(rng, GEN_MAX_TURNS));
+    else
+        fprintf(file, "%c\n", directions[draw(rng, 4)]);
+}
+
+// Helper function to write the behavior file of an agent standing on 'cell'
+static int write_agent(const char* directory, const char* name, const gen_options_t* options, long cell,
+                       unsigned int* rng, int ghost) {
+    char path[MAX_FILENAME * 2];
+    snprintf(path, sizeof(path), "%s/%s", directory, name);
+    FILE* file = fopen(path, "w");
+    if (!file) return -1;
+    fprintf(file, "PASSO %ld\nPOS %ld %ld\n", draw(rng, options->max_passo + 1), cell / options->width,
+            cell % options->width);
+    if (!ghost) fprintf(file, "VIDAS %d\n", options->lives);
+    for (int m = 0; m < options->script_length; m++)
+        write_command(file, options, rng, ghost);
+    return fclose(file) == 0 ? 0 : -1;
+}
+
+// Helper function to write level 'index' of the set
+static int write_level(const char* directory, const gen_options_t* options, int index, unsigned int* rng) {
+    int width = options->width, height = options->height;
+    long total = (long)width * height;
+    char* cells = malloc(total);
+    if (!cells) return -1;
+    if (!options->maze) {
+        open_board(options, cells, rng);
+    } else if (maze_board(options, cells, rng) != 0) {
+        free(cells);
+        return -1;
+    }
+    if (options->n_pacmans == 0)
+        cells[1L * width + 1] = CELL_PACMAN; // where the loader puts the manual pacman
+
+    long n_free = 0;
+    for (long i = 0; i < total; i++)
+        n_free += cells[i] == 'o';
+    long wanted = options->n_ghosts + options->n_pacmans + (options->portal != 'n');
+    if (n_free < wanted) {
+        printf("Error: %ld free cells for %ld agents and portal\n", n_free, wanted);
+        free(cells);
+        return -1;
+    }
+
+    long portal = -1;
+    if (options->portal == 'c') {
+        for (portal = total - 1; cells[portal] != 'o'; portal--);
+        cells[portal] = '@';
+    } else if (options->portal == 'r') {
+        portal = take_cell(options, cells, rng, '@');
+    }
+
+    char name[MAX_FILENAME];
+    char path[MAX_FILENAME * 2];
+    snprintf(path, sizeof(path), "%s/level%02d.lvl", directory, index + 1);
+    FILE* level = fopen(path, "w");
+    if (!level) {
+        free(cells);
+        return -1;
+    }
+    setvbuf(level, NULL, _IOFBF, GEN_FILE_BUFFER);
+    fprintf(level, "# LevelGen: seed %u\nDIM %d %d\nTEMPO %d\n", options->seed, height, width, options->tempo);
+
+    int failed = 0;
+    if (options->n_pacmans > 0) {
+        fprintf(level, "PAC");
+        for (int p = 0; p < options->n_pacmans && !failed; p++) {
+            snprintf(name, sizeof(name), "level%02d-p%d.p", index + 1, p + 1);
+            fprintf(level, " %s", name);
+            failed = write_agent(directory, name, options, take_cell(options, cells, rng, CELL_PACMAN), rng, 0);
+        }
+        fprintf(level, "\n");
+    }
+    if (options->n_ghosts > 0) {
+        fprintf(level, "MON");
+        for (int g = 0; g < options->n_ghosts && !failed; g++) {
+            snprintf(name, sizeof(name), "level%02d-m%d.m", index + 1, g + 1);
+            fprintf(level, " %s", name);
+            failed = write_agent(directory, name, options, take_cell(options, cells, rng, CELL_GHOST), rng, 1);
+        }
+        fprintf(level, "\n");
+    }
+
+    long walls = 0;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            char cell = cells[(long)y * width + x];
+            walls += cell == 'X';
+            fputc(cell == CELL_PACMAN || cell == CELL_GHOST ? 'o' : cell, level);
+        }
+        fputc('\n', level);
+    }
+    failed |= fclose(level) != 0;
+    free(cells);
+
+    if (!failed) {
+        printf("level%02d.lvl: %d x %d, %.1f%% walls, %d pacmans%s, %d ghosts", index + 1, height, width,
+               100.0 * walls / total, options->n_pacmans ? options->n_pacmans : 1,
+               options->n_pacmans ? "" : " (keys)", options->n_ghosts);
+        if (portal >= 0) printf(", portal at (%ld, %ld)", portal / width, portal % width);
+        printf("\n");
+    }
+    return failed ? -1 : 0;
+}
+
+static void usage(const char* name) {
+    printf("Usage: %s [-W width] [-H height] [-w wall_percent | -m [-o open_percent]] [-p pacmans] [-v lives]\n"
+           "          [-g ghosts] [-l script_length] [-r R_percent] [-c C_percent] [-t T_percent] [-s max_passo]\n"
+           "          [-T tempo] [-P corner|random|none] [-L levels] [-S seed] <level_directory>\n", name);
+}
+
+int main(int argc, char** argv) {
+    gen_options_t options = {40, 20, 15, 0, 10, 0, 1, 4, 8, 10, 5, 10, 2, 10, 'c', 1, 1};
+    int opt;
+
+    while ((opt = getopt(argc, argv, "W:H:w:mo:p:v:g:l:r:c:t:s:T:P:L:S:")) != -1) {
+        switch (opt) {
+            case 'W': options.width = atoi(optarg); break;
+            case 'H': options.height = atoi(optarg); break;
+            case 'w': options.wall_percent = atoi(optarg); break;
+            case 'm': options.maze = 1; break;
+            case 'o': options.open_percent = atoi(optarg); break;
+            case 'p': options.n_pacmans = atoi(optarg); break;
+            case 'v': options.lives = atoi(optarg); break;
+            case 'g': options.n_ghosts = atoi(optarg); break;
+            case 'l': options.script_length = atoi(optarg); break;
+            case 'r': options.random_percent = atoi(optarg); break;
+            case 'c': options.charge_percent = atoi(optarg); break;
+            case 't': options.wait_percent = atoi(optarg); break;
+            case 's': options.max_passo = atoi(optarg); break;
+            case 'T': options.tempo = atoi(optarg); break;
+            case 'P': options.portal = optarg[0]; break;
+            case 'L': options.n_levels = atoi(optarg); break;
+            case 'S': options.seed = strtoul(optarg, NULL, 10); break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (argc - optind != 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (options.width < 3 || options.height < 3 || options.n_pacmans < 0 || options.n_pacmans > MAX_PACMANS ||
+        options.n_ghosts < 0 || options.script_length < 1 || options.script_length > MAX_MOVES ||
+        options.random_percent + options.charge_percent + options.wait_percent > 100 || options.max_passo < 0 ||
+        options.n_levels < 1 || options.n_levels > MAX_LEVELS || !strchr("crn", options.portal)) {
+        printf("Error: Invalid options (3x3 boards or larger, up to %d pacmans, scripts of 1 to %d commands,\n"
+               "R + C + T up to 100%%, up to %d levels)\n", MAX_PACMANS, MAX_MOVES, MAX_LEVELS);
+        return 1;
+    }
+
+    const char* directory = argv[optind];
+    if (mkdir(directory, 0755) != 0 && errno != EEXIST) {
+        printf("Error: Could not create %s\n", directory);
+        return 1;
+    }
+
+    unsigned int rng = options.seed;
+    for (int l = 0; l < options.n_levels; l++) {
+        if (write_level(directory, &options, l, &rng) != 0) {
+            printf("Error: Could not write level %d in %s\n", l + 1, directory);
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,196 @@
+#include "protocol.h"
+#include "session.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define MAX_EVENTS 256
+
+// A simulated player: sends a key, waits for the frame it produces, sends the next one
+typedef struct {
+    int fd;
+    proto_buffer_t in;
+    double sent_at;     // when the pending key was sent
+    int started;        // the first frame (the level keyframe) arrived
+} player_t;
+
+static const char* socket_path = PROTO_DEFAULT_SOCKET;
+static int epoll_fd;
+
+static double* latencies = NULL;
+static size_t n_latencies = 0, latencies_capacity = 0;
+static unsigned long reconnects = 0;
+
+static void add_latency(double ms) {
+    if (n_latencies == latencies_capacity) {
+        latencies_capacity = latencies_capacity ? latencies_capacity * 2 : 4096;
+        latencies = realloc(latencies, latencies_capacity * sizeof(double));
+        if (!latencies) exit(1);
+    }
+    latencies[n_latencies++] = ms;
+}
+
+static int compare_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Helper function to open a session for a player
+static int connect_player(player_t* player) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", socket_path);
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    struct epoll_event event = {.events = EPOLLIN, .data.ptr = player};
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+        close(fd);
+        return -1;
+    }
+    player->fd = fd;
+    player->in.start = player->in.size = 0;
+    player->started = 0;
+    return 0;
+}
+
+static void disconnect_player(player_t* player) {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, player->fd, NULL);
+    close(player->fd);
+    player->fd = -1;
+}
+
+static int send_key(player_t* player) {
+    char key = "WASD"[rand() % 4];
+    player->sent_at = now_ms();
+    return write(player->fd, &key, 1) == 1 ? 0 : -1;
+}
+
+// Helper function to handle the frames a player received
+// Returns -1 if the player could not go on
+static int handle_player(player_t* player) {
+    if (proto_receive(player->fd, &player->in) <= 0) return -1;
+
+    char type;
+    const unsigned char* payload;
+    uint32_t length;
+    while (proto_next(&player->in, &type, &payload, &length)) {
+        if (type != PROTO_MSG_FRAME || length < sizeof(int32_t)) continue;
+
+        int32_t state;
+        memcpy(&state, payload, sizeof(state));
+        if (player->started)
+            add_latency(now_ms() - player->sent_at);
+        player->started = 1;
+
+        // A finished game is replaced by a new session
+        if (state != SESSION_PLAYING) {
+            disconnect_player(player);
+            reconnects++;
+            return connect_player(player);
+        }
+        if (send_key(player) != 0) return -1;
+    }
+    return 0;
+}
+
+// Measures plays per second and key-to-frame latency while doubling the number of sessions
+int main(int argc, char** argv) {
+    int max_sessions = 4096;
+    double seconds = 2;
+    double limit_ms = 50;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:n:d:l:")) != -1) {
+        switch (opt) {
+            case 's': socket_path = optarg; break;
+            case 'n': max_sessions = atoi(optarg); break;
+            case 'd': seconds = atof(optarg); break;
+            case 'l': limit_ms = atof(optarg); break;
+            default:
+                printf("Usage: %s [-s socket_path] [-n max_sessions] [-d seconds_per_step] [-l p99_limit_ms]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    epoll_fd = epoll_create1(0);
+    player_t* players = calloc(max_sessions, sizeof(player_t));
+    if (epoll_fd < 0 || !players) return 1;
+    srand(1);
+
+    printf("%-10s %-12s %-10s %-10s %-10s\n", "sessions", "plays/s", "p50 ms", "p99 ms", "max ms");
+    int active = 0, best = 0;
+    struct epoll_event events[MAX_EVENTS];
+
+    for (int target = 16; target <= max_sessions; target *= 2) {
+        while (active < target) {
+            if (connect_player(&players[active]) != 0) {
+                printf("Could not open session %d: %s\n", active + 1, strerror(errno));
+                break;
+            }
+            active++;
+        }
+        if (active < target) break;
+
+        n_latencies = 0;
+        double start = now_ms();
+        while (now_ms() - start < seconds * 1000) {
+            int n = epoll_wait(epoll_fd, events, MAX_EVENTS, 100);
+            for (int i = 0; i < n; i++) {
+                player_t* player = events[i].data.ptr;
+                if (player->fd >= 0 && handle_player(player) != 0) {
+                    printf("Session lost by the server\n");
+                    if (player->fd >= 0) disconnect_player(player);
+                    if (connect_player(player) != 0) goto done;
+                }
+            }
+        }
+
+        double elapsed = (now_ms() - start) / 1000;
+        if (n_latencies == 0) {
+            printf("%-10d no frames (is the level controlled by keys?)\n", active);
+            break;
+        }
+        qsort(latencies, n_latencies, sizeof(double), compare_double);
+        double p50 = latencies[n_latencies / 2];
+        double p99 = latencies[(size_t)(n_latencies * 0.99)];
+        printf("%-10d %-12.0f %-10.3f %-10.3f %-10.3f\n", active, n_latencies / elapsed,
+               p50, p99, latencies[n_latencies - 1]);
+        fflush(stdout);
+
+        if (p99 > limit_ms) break;
+        best = active;
+    }
+
+done:
+    printf("Max sessions with p99 under %.1f ms: %d (%lu finished games restarted)\n", limit_ms, best, reconnects);
+    for (int i = 0; i < active; i++) {
+        if (players[i].fd >= 0) disconnect_player(&players[i]);
+        proto_free(&players[i].in);
+    }
+    free(players);
+    free(latencies);
+    close(epoll_fd);
+    return 0;
+}
@@ -0,0 +1,185 @@
+#define _XOPEN_SOURCE 700 // posix_openpt
+#define _DEFAULT_SOURCE   // TIOCSCTTY, TIOCSWINSZ
+#include "latency.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+
+/*
+Scripted input replayer: runs a command (the game) on a pseudo-terminal of a given
+size and types a list of keys into it, one every interval, as a player would, so
+runs with the ncurses display can be measured without a person at the keyboard.
+For every key it takes the time from the write until the first byte the command
+writes back, which covers the terminal, the game's input polling, the play and the
+drawing. The game itself measures from get_input to refresh_screen (its -L option
+and the histogram it writes to stderr at exit); the command keeps this program's
+stderr, so that histogram shows up here too.
+A '.' in the keys types nothing for one interval, whitespace is ignored.
+*/
+
+#define MAX_KEYS 65536
+
+// Helper private function to start 'argv' on a new pseudo-terminal of 'rows' x 'cols'
+// Returns the pid, with the master side in *master, or -1 on error
+static pid_t spawn(char** argv, int rows, int cols, int* master) {
+    *master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (*master < 0 || grantpt(*master) != 0 || unlockpt(*master) != 0) return -1;
+    char* slave_name = ptsname(*master);
+    if (!slave_name) return -1;
+
+    pid_t pid = fork();
+    if (pid != 0) return pid;
+
+    // Child: a session of its own with the slave side as controlling terminal, stdin and stdout
+    setsid();
+    int slave = open(slave_name, O_RDWR);
+    if (slave < 0) _exit(127);
+    ioctl(slave, TIOCSCTTY, 0);
+    struct winsize size = {.ws_row = (unsigned short)rows, .ws_col = (unsigned short)cols};
+    ioctl(slave, TIOCSWINSZ, &size);
+    dup2(slave, STDIN_FILENO);
+    dup2(slave, STDOUT_FILENO);
+    if (slave > STDOUT_FILENO) close(slave);
+    close(*master);
+    if (!getenv("TERM")) setenv("TERM", "xterm", 1);
+    execvp(argv[0], argv);
+    _exit(127);
+}
+
+// Helper private function to read what the command writes until 'until_us', into 'out' if not NULL
+// The time of the first byte goes to *first_us when it is 0
+// Returns -1 once the command closed the terminal, 0 otherwise
+static int drain(int master, FILE* out, double until_us, double* first_us) {
+    char buffer[65536];
+    while (1) {
+        double left_ms = (until_us - latency_now_us()) / 1e3;
+        if (left_ms < 0) return 0;
+        struct pollfd pfd = {.fd = master, .events = POLLIN};
+        int ready = poll(&pfd, 1, (int)left_ms + 1);
+        if (ready < 0 && errno == EINTR) continue;
+        if (ready <= 0) return 0;
+        ssize_t n = read(master, buffer, sizeof(buffer));
+        if (n <= 0) return -1; // EIO: no process holds the slave side any more
+        if (first_us && *first_us == 0) *first_us = latency_now_us();
+        if (out) fwrite(buffer, 1, n, out);
+    }
+}
+
+// Helper private function to read the keys of a file, whitespace is dropped later
+static int read_keys(const char* path, char* keys, int size) {
+    FILE* file = fopen(path, "r");
+    if (!file) return -1;
+    int n = (int)fread(keys, 1, size - 1, file);
+    keys[n] = '\0';
+    fclose(file);
+    return 0;
+}
+
+static void usage(const char* name) {
+    printf("Usage: %s [-k keys | -f key_file] [-i interval_ms] [-w warmup_ms] [-g grace_ms] [-r rows] [-c cols]\n"
+           "          [-o output_file] -- command [args]\n", name);
+}
+
+int main(int argc, char** argv) {
+    static char keys[MAX_KEYS];
+    double interval_ms = 100, warmup_ms = 500, grace_ms = 2000;
+    int rows = 50, cols = 200;
+    const char* output_filename = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "k:f:i:w:g:r:c:o:")) != -1) {
+        switch (opt) {
+            case 'k':
+                snprintf(keys, sizeof(keys), "%s", optarg);
+                break;
+            case 'f':
+                if (read_keys(optarg, keys, sizeof(keys)) != 0) {
+                    printf("Error: Could not read %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'i':
+                interval_ms = atof(optarg);
+                break;
+            case 'w':
+                warmup_ms = atof(optarg);
+                break;
+            case 'g':
+                grace_ms = atof(optarg);
+                break;
+            case 'r':
+                rows = atoi(optarg);
+                break;
+            case 'c':
+                cols = atoi(optarg);
+                break;
+            case 'o':
+                output_filename = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (optind >= argc || keys[0] == '\0') {
+        usage(argv[0]);
+        return 1;
+    }
+
+    FILE* output = NULL;
+    if (output_filename && !(output = fopen(output_filename, "w"))) {
+        printf("Error: Could not open %s\n", output_filename);
+        return 1;
+    }
+    int master;
+    pid_t pid = spawn(&argv[optind], rows, cols, &master);
+    if (pid < 0) {
+        printf("Error: Could not start %s on a pseudo-terminal\n", argv[optind]);
+        return 1;
+    }
+
+    latency_histogram_t histogram;
+    memset(&histogram, 0, sizeof(histogram));
+    int sent = 0, silent = 0;
+    int closed = drain(master, output, latency_now_us() + warmup_ms * 1e3, NULL);
+    for (const char* key = keys; *key && !closed; key++) {
+        if (*key == ' ' || *key == '\n' || *key == '\t' || *key == '\r') continue;
+        double start = latency_now_us();
+        if (*key == '.') {
+            closed = drain(master, output, start + interval_ms * 1e3, NULL);
+            continue;
+        }
+        if (write(master, key, 1) != 1) break;
+        sent++;
+        double first = 0;
+        closed = drain(master, output, start + interval_ms * 1e3, &first);
+        if (first > 0)
+            latency_histogram_add(&histogram, first - start);
+        else
+            silent++;
+    }
+
+    // The keys are over: the command has 'grace_ms' to finish on its own
+    if (!closed) closed = drain(master, output, latency_now_us() + grace_ms * 1e3, NULL);
+    int status;
+    if (closed) {
+        waitpid(pid, &status, 0);
+    } else if (waitpid(pid, &status, WNOHANG) == 0) {
+        kill(pid, SIGTERM);
+        waitpid(pid, &status, 0);
+    }
+    close(master);
+    if (output) fclose(output);
+
+    printf("Keys typed: %d | without output within %.0f ms: %d | command %s %d\n", sent, interval_ms, silent,
+           WIFEXITED(status) ? "exited with" : "killed by signal",
+           WIFEXITED(status) ? WEXITSTATUS(status) : WTERMSIG(status));
+    latency_histogram_print(&histogram, stdout, "Key to first output");
+    return 0;
+}
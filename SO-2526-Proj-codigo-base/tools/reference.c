@@ -0,0 +1,330 @@
+#include "reference.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Result of ref_plan when the pacman wants to enter another cell
+#define PLANNED_MOVE 2
+
+static inline board_pos_t* cell_at(ref_board_t* ref, int x, int y) {
+    return &ref->cells[y * ref->width + x];
+}
+
+static inline int inside(ref_board_t* ref, int x, int y) {
+    return x >= 0 && x < ref->width && y >= 0 && y < ref->height;
+}
+
+// Helper private function: cell offset of a direction, 0 for anything else
+static int step_of(char direction, int* dx, int* dy) {
+    *dx = *dy = 0;
+    switch (direction) {
+        case 'W': *dy = -1; return 1;
+        case 'S': *dy = 1; return 1;
+        case 'A': *dx = -1; return 1;
+        case 'D': *dx = 1; return 1;
+        default: return 0;
+    }
+}
+
+// Helper private function: the same draw of the same generator as board.c
+static char random_direction(ref_board_t* ref) {
+    char directions[] = {'W', 'S', 'A', 'D'};
+    return directions[rand_r(&ref->rng_state) % 4];
+}
+
+// Helper private function for a pacman losing a life, its cell is cleared
+static void kill_at(ref_board_t* ref, int p) {
+    pacman_t* pac = &ref->pacmans[p];
+    cell_at(ref, pac->pos_x, pac->pos_y)->content = ' ';
+    pac->alive = 0;
+    if (pac->lives > 0)
+        pac->lives--;
+}
+
+// Helper private function: the first living pacman (by index) on (x, y) dies
+static int kill_pacman_on(ref_board_t* ref, int x, int y) {
+    for (int p = 0; p < ref->n_pacmans; p++) {
+        pacman_t* pac = &ref->pacmans[p];
+        if (pac->alive && pac->pos_x == x && pac->pos_y == y) {
+            kill_at(ref, p);
+            return DEAD_PACMAN;
+        }
+    }
+    return VALID_MOVE;
+}
+
+int ref_from_board(ref_board_t* ref, board_t* board) {
+    memset(ref, 0, sizeof(*ref));
+    sync_ghosts(board);
+    ref->width = board->width;
+    ref->height = board->height;
+    ref->n_pacmans = board->n_pacmans;
+    ref->n_ghosts = board->n_ghosts;
+    ref->rng_state = board->rng_state;
+    ref->cells = malloc((size_t)board->width * board->height * sizeof(board_pos_t));
+    ref->pacmans = malloc((board->n_pacmans > 0 ? board->n_pacmans : 1) * sizeof(pacman_t));
+    ref->ghosts = malloc((board->n_ghosts > 0 ? board->n_ghosts : 1) * sizeof(ref_ghost_t));
+    if (!ref->cells || !ref->pacmans || !ref->ghosts) {
+        ref_free(ref);
+        return -1;
+    }
+
+    for (int y = 0; y < board->height; y++) {
+        for (int x = 0; x < board->width; x++) {
+            board_touch(board, x, y);
+            *cell_at(ref, x, y) = board->board[board_index(board, x, y)];
+        }
+    }
+    memcpy(ref->pacmans, board->pacmans, board->n_pacmans * sizeof(pacman_t));
+    for (int i = 0; i < board->n_ghosts; i++) {
+        ghost_t* ghost = &board->ghosts[i];
+        ref_ghost_t* copy = &ref->ghosts[i];
+        copy->pos_x = ghost->pos_x;
+        copy->pos_y = ghost->pos_y;
+        copy->passo = ghost->passo;
+        copy->waiting = board->ghost_waiting[i];
+        copy->n_moves = ghost->n_moves;
+        copy->current_move = ghost->current_move;
+        copy->charged = ghost->charged;
+        memcpy(copy->moves, ghost->moves, MAX_MOVES * sizeof(command_t));
+    }
+    return 0;
+}
+
+void ref_free(ref_board_t* ref) {
+    free(ref->cells);
+    free(ref->pacmans);
+    free(ref->ghosts);
+    memset(ref, 0, sizeof(*ref));
+}
+
+// Helper private function: consumes the pacman's command, PLANNED_MOVE when it wants (x, y)
+static int ref_plan(ref_board_t* ref, pacman_t* pac, command_t* command, int* x, int* y) {
+    *x = pac->pos_x;
+    *y = pac->pos_y;
+    if (pac->waiting > 0) {
+        pac->waiting--;
+        return VALID_MOVE;
+    }
+    pac->waiting = pac->passo;
+
+    char direction = command->command;
+    if (direction == 'R')
+        direction = random_direction(ref);
+    if (direction == 'T') {
+        if (command->turns_left == 1) {
+            pac->current_move++;
+            command->turns_left = command->turns;
+        } else {
+            command->turns_left--;
+        }
+        return VALID_MOVE;
+    }
+    int dx, dy;
+    if (!step_of(direction, &dx, &dy))
+        return INVALID_MOVE;
+
+    pac->current_move++;
+    *x += dx;
+    *y += dy;
+    if (!inside(ref, *x, *y))
+        return INVALID_MOVE;
+    board_pos_t* target = cell_at(ref, *x, *y);
+    if (target->content == 'W' && !target->has_portal)
+        return INVALID_MOVE;
+    return PLANNED_MOVE;
+}
+
+// Helper private function: the pacman enters (x, y), its old cell is already cleared
+static int ref_enter(ref_board_t* ref, int p, int x, int y) {
+    pacman_t* pac = &ref->pacmans[p];
+    board_pos_t* target = cell_at(ref, x, y);
+    if (target->has_portal) {
+        target->content = 'P';
+        return REACHED_PORTAL;
+    }
+    if (target->content == 'M') {
+        pac->alive = 0;
+        if (pac->lives > 0)
+            pac->lives--;
+        return DEAD_PACMAN;
+    }
+    if (target->has_dot) {
+        pac->points++;
+        target->has_dot = 0;
+    }
+    pac->pos_x = x;
+    pac->pos_y = y;
+    target->content = 'P';
+    return VALID_MOVE;
+}
+
+int ref_move_pacmans(ref_board_t* ref, command_t* input) {
+    int n = ref->n_pacmans;
+    int* from = malloc((n > 0 ? n : 1) * sizeof(int));   // cell of each pacman
+    int* want = malloc((n > 0 ? n : 1) * sizeof(int));   // cell it wants, -1 if none or not playing
+    int* want_x = malloc((n > 0 ? n : 1) * sizeof(int));
+    int* want_y = malloc((n > 0 ? n : 1) * sizeof(int));
+    int* moves = malloc((n > 0 ? n : 1) * sizeof(int));  // it does move this play
+    if (!from || !want || !want_x || !want_y || !moves) exit(1);
+
+    for (int p = 0; p < n; p++) {
+        pacman_t* pac = &ref->pacmans[p];
+        if (!pac->alive && pac->lives > 0 && cell_at(ref, pac->start_x, pac->start_y)->content == ' ') {
+            pac->pos_x = pac->start_x;
+            pac->pos_y = pac->start_y;
+            pac->alive = 1;
+            pac->waiting = pac->passo;
+            cell_at(ref, pac->pos_x, pac->pos_y)->content = 'P';
+        }
+    }
+
+    // Every living pacman plans from the same board
+    for (int p = 0; p < n; p++) {
+        pacman_t* pac = &ref->pacmans[p];
+        from[p] = want[p] = -1;
+        moves[p] = 0;
+        if (!pac->alive) continue;
+        from[p] = pac->pos_y * ref->width + pac->pos_x;
+        command_t* command = (pac->n_moves == 0) ? input : &pac->moves[pac->current_move % pac->n_moves];
+        if (command && ref_plan(ref, pac, command, &want_x[p], &want_y[p]) == PLANNED_MOVE) {
+            want[p] = want_y[p] * ref->width + want_x[p];
+            moves[p] = 1;
+        }
+    }
+
+    // Same cell wanted: the lowest index goes
+    for (int p = 0; p < n; p++) {
+        for (int q = 0; q < p && moves[p]; q++) {
+            if (want[q] == want[p]) moves[p] = 0;
+        }
+    }
+
+    // Two pacmans never swap places
+    for (int p = 0; p < n; p++) {
+        if (!moves[p]) continue;
+        for (int q = 0; q < n; q++) {
+            if (q != p && from[q] == want[p] && moves[q] && want[q] == from[p]) {
+                moves[p] = moves[q] = 0;
+                break;
+            }
+        }
+    }
+
+    // Nobody walks into the cell of a pacman that stays, until nothing changes
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int p = 0; p < n; p++) {
+            if (!moves[p]) continue;
+            for (int q = 0; q < n; q++) {
+                if (q != p && from[q] >= 0 && from[q] == want[p] && !moves[q]) {
+                    moves[p] = 0;
+                    changed = 1;
+                    break;
+                }
+            }
+        }
+    }
+
+    for (int p = 0; p < n; p++) {
+        if (moves[p]) ref->cells[from[p]].content = ' ';
+    }
+    int result = VALID_MOVE;
+    for (int p = 0; p < n; p++) {
+        if (moves[p] && ref_enter(ref, p, want_x[p], want_y[p]) == REACHED_PORTAL)
+            result = REACHED_PORTAL;
+    }
+
+    free(from);
+    free(want);
+    free(want_x);
+    free(want_y);
+    free(moves);
+
+    if (result == REACHED_PORTAL) return REACHED_PORTAL;
+    for (int p = 0; p < n; p++) {
+        if (ref->pacmans[p].alive || ref->pacmans[p].lives > 0)
+            return VALID_MOVE;
+    }
+    return DEAD_PACMAN;
+}
+
+// Helper private function: a charged ghost runs until a wall, a ghost or a pacman, or the edge
+static void ref_charge(ref_board_t* ref, ref_ghost_t* ghost, int dx, int dy) {
+    ghost->charged = 0;
+    int x = ghost->pos_x, y = ghost->pos_y;
+    if (!inside(ref, x + dx, y + dy))
+        return;
+
+    while (inside(ref, x + dx, y + dy)) {
+        char content = cell_at(ref, x + dx, y + dy)->content;
+        if (content == 'W' || content == 'M')
+            break;
+        x += dx;
+        y += dy;
+        if (content == 'P') {
+            kill_pacman_on(ref, x, y);
+            break;
+        }
+    }
+    cell_at(ref, ghost->pos_x, ghost->pos_y)->content = ' ';
+    ghost->pos_x = x;
+    ghost->pos_y = y;
+    cell_at(ref, x, y)->content = 'M';
+}
+
+// Helper private function: runs the ghost's current command
+static void ref_act(ref_board_t* ref, ref_ghost_t* ghost) {
+    command_t* command = &ghost->moves[ghost->current_move % ghost->n_moves];
+    ghost->waiting = ghost->passo;
+
+    char direction = command->command;
+    if (direction == 'R')
+        direction = random_direction(ref);
+    if (direction == 'C') {
+        ghost->current_move++;
+        ghost->charged = 1;
+        return;
+    }
+    if (direction == 'T') {
+        if (command->turns_left == 1) {
+            ghost->current_move++;
+            command->turns_left = command->turns;
+        } else {
+            command->turns_left--;
+        }
+        return;
+    }
+    int dx, dy;
+    if (!step_of(direction, &dx, &dy))
+        return;
+
+    ghost->current_move++;
+    if (ghost->charged) {
+        ref_charge(ref, ghost, dx, dy);
+        return;
+    }
+
+    int x = ghost->pos_x + dx, y = ghost->pos_y + dy;
+    if (!inside(ref, x, y))
+        return;
+    char content = cell_at(ref, x, y)->content;
+    if (content == 'W' || content == 'M')
+        return;
+    if (content == 'P')
+        kill_pacman_on(ref, x, y);
+    cell_at(ref, ghost->pos_x, ghost->pos_y)->content = ' ';
+    ghost->pos_x = x;
+    ghost->pos_y = y;
+    cell_at(ref, x, y)->content = 'M';
+}
+
+void ref_move_ghosts(ref_board_t* ref) {
+    for (int i = 0; i < ref->n_ghosts; i++) {
+        ref_ghost_t* ghost = &ref->ghosts[i];
+        if (ghost->waiting > 0)
+            ghost->waiting--;
+        else
+            ref_act(ref, ghost);
+    }
+}
@@ -0,0 +1,54 @@
+#include "scores.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+Prints the best points kept by the score log (scores.h): whole games first, then
+every level by name, or a single level with -l. Reading the log brings its index
+up to date, so this also folds in what running games and servers appended.
+*/
+
+// Helper private function to print one line of the table
+static void print_entry(const char* name, const score_entry_t* entry, int k) {
+    printf("%-24s %8d  ", name, entry->count);
+    int kept = entry->count < SCORES_TOP ? entry->count : SCORES_TOP;
+    for (int i = 0; i < kept && i < k; i++)
+        printf(" %d", entry->top[i]);
+    printf("\n");
+}
+
+int main(int argc, char** argv) {
+    const char* level = NULL;
+    int k = SCORES_TOP;
+    int opt;
+    while ((opt = getopt(argc, argv, "k:l:")) != -1) {
+        switch (opt) {
+            case 'k':
+                k = atoi(optarg);
+                break;
+            case 'l':
+                level = optarg;
+                break;
+            default:
+                printf("Usage: %s [-k best] [-l level] [scores_file]\n", argv[0]);
+                return 1;
+        }
+    }
+    const char* path = optind < argc ? argv[optind] : SCORES_FILE;
+    if (access(path, F_OK) != 0 || scores_open(path) != 0) {
+        printf("Error: Could not open %s\n", path);
+        return 1;
+    }
+
+    printf("%-24s %8s   best\n", "level", "played");
+    for (int i = 0; scores_entry(i); i++) {
+        const score_entry_t* entry = scores_entry(i);
+        if (level && strcmp(entry->level, level) != 0) continue;
+        if (i == 0 && (level || entry->count == 0)) continue;
+        print_entry(i == 0 ? "(whole games)" : entry->level, entry, k);
+    }
+    scores_close();
+    return 0;
+}
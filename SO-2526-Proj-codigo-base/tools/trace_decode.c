@@ -0,0 +1,73 @@
+#include "board.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// Helper function to print a rebuilt board, walls/dots/portals as in the .lvl files
+static void print_state(trace_state_t* state) {
+    printf("=== TICK %u (%d x %d) ===\n", state->tick, state->height, state->width);
+
+    char* row = malloc(state->width + 1);
+    if (!row) return;
+    for (int y = 0; y < state->height; y++) {
+        for (int x = 0; x < state->width; x++) {
+            board_pos_t pos;
+            unpack_cell(state->cells[y * state->width + x], &pos);
+            char c = pos.content;
+            if (c == 'W') c = 'X';
+            else if (c == ' ' && pos.has_portal) c = '@';
+            else if (c == ' ' && pos.has_dot) c = 'o';
+            else if (c == '\0') c = ' ';
+            row[x] = c;
+        }
+        row[state->width] = '\0';
+        printf("%s\n", row);
+    }
+    free(row);
+
+    for (int a = 0; a < state->n_pacmans + state->n_ghosts; a++) {
+        trace_agent_t* agent = &state->agents[a];
+        if (a < state->n_pacmans)
+            printf("Pacman %d: (%d, %d) alive: %d points: %d lives: %d\n", a,
+                   agent->pos_y, agent->pos_x, agent->state, agent->points, agent->lives);
+        else
+            printf("Monster %d: (%d, %d) charged: %d\n", a - state->n_pacmans,
+                   agent->pos_y, agent->pos_x, agent->state);
+    }
+}
+
+// Rebuilds the full board at a given tick of a trace written with Pacmanist -t
+int main(int argc, char** argv) {
+    if (argc != 2 && argc != 3) {
+        printf("Usage: %s <trace_file> [tick]\n", argv[0]);
+        return 1;
+    }
+
+    FILE* file = fopen(argv[1], "rb");
+    if (!file || trace_read_header(file) != 0) {
+        printf("Error: %s is not a Pacmanist trace\n", argv[1]);
+        if (file) fclose(file);
+        return 1;
+    }
+
+    long target = (argc == 3) ? atol(argv[2]) : -1; // -1: last tick in the trace
+    trace_state_t state = {0};
+    int result, found = 0;
+
+    while ((result = trace_read_record(file, &state)) == 1) {
+        found = 1;
+        if (target >= 0 && state.tick >= (unsigned long)target)
+            break;
+    }
+
+    if (result < 0)
+        printf("Warning: trace is truncated or corrupted after tick %u\n", state.tick);
+    if (found)
+        print_state(&state);
+    else
+        printf("Error: trace has no frames\n");
+
+    trace_free_state(&state);
+    fclose(file);
+    return found ? 0 : 1;
+}